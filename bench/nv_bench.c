@@ -0,0 +1,733 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nv.h"
+#include "nv_blob.h"
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+#endif
+
+#define NV_BENCH_ARRAY_LEN   8
+#define NV_BENCH_STR_SIZE    32
+#define NV_BENCH_KEY_SIZE    32
+#define NV_BENCH_PATH_SIZE   256
+#define NV_BENCH_MAX_KEYS    16
+#define NV_BENCH_MAX_LEVELS  10
+#define NV_BENCH_PATH_BUDGET 200000    // key visits per path op series
+#define NV_BENCH_STORE_ITERS 100000
+
+typedef enum {
+    NV_BENCH_CSV = 0,
+    NV_BENCH_JSON,
+} nv_bench_format_t;
+
+typedef struct {
+    const char* name;
+    nv_data_type_t type;
+} nv_bench_type_t;
+
+static const nv_bench_type_t nv_bench_types[] = {
+    { "u8", NV_DATA_U8 },
+    { "s8", NV_DATA_S8 },
+    { "u16", NV_DATA_U16 },
+    { "s16", NV_DATA_S16 },
+    { "u32", NV_DATA_U32 },
+    { "s32", NV_DATA_S32 },
+    { "u64", NV_DATA_U64 },
+    { "s64", NV_DATA_S64 },
+    { "float", NV_DATA_FLOAT },
+    { "double", NV_DATA_DOUBLE },
+    { "str", NV_DATA_STR },
+    { "string_array", NV_DATA_STRING_ARRAY },
+    { "int_array", NV_DATA_INT_ARRAY },
+    { "float_array", NV_DATA_FLOAT_ARRAY },
+    { "double_array", NV_DATA_DOUBLE_ARRAY },
+    { "ip", NV_DATA_IP },
+    { "mac", NV_DATA_MAC },
+    { "packed_int_array", NV_DATA_PACKED_INT_ARRAY },
+    { "packed_float_array", NV_DATA_PACKED_FLOAT_ARRAY },
+    { "packed_double_array", NV_DATA_PACKED_DOUBLE_ARRAY },
+};
+
+typedef struct {
+    union {
+        uint8_t u8;
+        int8_t s8;
+        uint16_t u16;
+        int16_t s16;
+        uint32_t u32;
+        int32_t s32;
+        uint64_t u64;
+        int64_t s64;
+        float f;
+        double d;
+        char str[NV_BENCH_STR_SIZE];
+        int32_t ints[NV_BENCH_ARRAY_LEN];
+        float floats[NV_BENCH_ARRAY_LEN];
+        double doubles[NV_BENCH_ARRAY_LEN];
+        uint32_t addr[NV_BENCH_ARRAY_LEN];
+    };
+    char strings[NV_BENCH_ARRAY_LEN][NV_BENCH_STR_SIZE];
+    char* string_ptrs[NV_BENCH_ARRAY_LEN];
+} nv_bench_value_t;
+
+typedef struct {
+    nv_bench_format_t format;
+    const char* dir;
+    uint32_t keys[NV_BENCH_MAX_KEYS];
+    size_t key_count;
+    uint32_t levels[NV_BENCH_MAX_LEVELS];    ///< compression levels
+    size_t level_count;
+    nv_config_t config;        ///< build default config
+    uint32_t iterations;       ///< 0 for automatic
+    const char* types;         ///< comma list, NULL for all
+    bool path;                 ///< bench nv_get/nv_sync/nv_delete
+    bool store;                ///< bench nv_store_* on an open handle
+    bool first;                ///< no result row printed yet
+} nv_bench_t;
+
+typedef struct {
+    const char* api;
+    const char* op;
+    const char* type;
+    uint32_t keys;
+    long file_bytes;
+    uint32_t compress;
+    uint32_t iterations;
+    double ops_per_sec;
+    double p50_us;
+    double p99_us;
+    double cpu_us;    ///< mean thread cpu time, the rest of an op waits
+} nv_bench_result_t;
+
+static uint32_t nv_bench_seed = 2463534242u;
+
+static uint32_t nv_bench_random(void)
+{
+    /* xorshift32, the same key sequence on every run */
+    nv_bench_seed ^= nv_bench_seed << 13;
+    nv_bench_seed ^= nv_bench_seed >> 17;
+    nv_bench_seed ^= nv_bench_seed << 5;
+
+    return nv_bench_seed;
+}
+
+static uint64_t nv_bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t nv_bench_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static long nv_bench_file_size(const char* file)
+{
+    struct stat st;
+    if (stat(file, &st) != 0) {
+        return -1;
+    }
+
+    return st.st_size;
+}
+
+static int nv_bench_compare(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * nv_bench_fill, build a value of type derived from seed
+ * @param value value storage
+ * @param type  data type
+ * @param seed  value seed
+ * @return      data buffer length to pass as len
+ */
+static uint32_t nv_bench_fill(nv_bench_value_t* value, nv_data_type_t type,
+                              uint32_t seed)
+{
+    memset(value, 0, sizeof(nv_bench_value_t));
+
+    for (size_t i = 0; i < NV_BENCH_ARRAY_LEN; i++) {
+        value->string_ptrs[i] = value->strings[i];
+    }
+
+    switch (type) {
+    case NV_DATA_U8:
+        value->u8 = seed;
+        return sizeof(uint8_t);
+    case NV_DATA_S8:
+        value->s8 = -(int8_t)(seed & 0x7F);
+        return sizeof(int8_t);
+    case NV_DATA_U16:
+        value->u16 = seed;
+        return sizeof(uint16_t);
+    case NV_DATA_S16:
+        value->s16 = -(int16_t)(seed & 0x7FFF);
+        return sizeof(int16_t);
+    case NV_DATA_U32:
+        value->u32 = seed;
+        return sizeof(uint32_t);
+    case NV_DATA_S32:
+        value->s32 = -(int32_t)(seed & 0x7FFFFFFF);
+        return sizeof(int32_t);
+    case NV_DATA_U64:
+        value->u64 = (uint64_t)seed << 32 | seed;
+        return sizeof(uint64_t);
+    case NV_DATA_S64:
+        value->s64 = -(int64_t)((uint64_t)(seed & 0x7FFFFFFF) << 32 | seed);
+        return sizeof(int64_t);
+    case NV_DATA_FLOAT:
+        value->f = seed * 0.5f;
+        return sizeof(float);
+    case NV_DATA_DOUBLE:
+        value->d = seed * 0.25;
+        return sizeof(double);
+    case NV_DATA_STR:
+        snprintf(value->str, sizeof(value->str), "value-%" PRIu32, seed);
+        return strlen(value->str) + 1;
+    case NV_DATA_STRING_ARRAY:
+        for (size_t i = 0; i < NV_BENCH_ARRAY_LEN; i++) {
+            snprintf(value->strings[i], NV_BENCH_STR_SIZE, "s%" PRIu32 "-%zu",
+                     seed, i);
+        }
+        return NV_BENCH_ARRAY_LEN;
+    case NV_DATA_INT_ARRAY:
+    case NV_DATA_FLOAT_ARRAY:
+    case NV_DATA_DOUBLE_ARRAY:
+    case NV_DATA_PACKED_INT_ARRAY:
+    case NV_DATA_PACKED_FLOAT_ARRAY:
+    case NV_DATA_PACKED_DOUBLE_ARRAY:
+        for (size_t i = 0; i < NV_BENCH_ARRAY_LEN; i++) {
+            value->ints[i] = seed + i;
+            if (type == NV_DATA_FLOAT_ARRAY
+                || type == NV_DATA_PACKED_FLOAT_ARRAY) {
+                value->floats[i] = (seed + i) * 0.5f;
+            } else if (type == NV_DATA_DOUBLE_ARRAY
+                       || type == NV_DATA_PACKED_DOUBLE_ARRAY) {
+                value->doubles[i] = (seed + i) * 0.25;
+            }
+        }
+        return NV_BENCH_ARRAY_LEN;
+    case NV_DATA_IP:
+        value->addr[0] = 10;
+        value->addr[1] = 0;
+        value->addr[2] = (seed >> 8) & 0xFF;
+        value->addr[3] = seed & 0xFF;
+        return 4;
+    case NV_DATA_MAC:
+        for (size_t i = 0; i < 6; i++) {
+            value->addr[i] = (seed >> (i * 4)) & 0xFF;
+        }
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * nv_bench_data, the buffer nv_sync/nv_get expect for type
+ */
+static void* nv_bench_data(nv_bench_value_t* value, nv_data_type_t type)
+{
+    if (type == NV_DATA_STRING_ARRAY) {
+        return value->string_ptrs;
+    }
+
+    return value;
+}
+
+static void nv_bench_key(char* key, uint32_t index)
+{
+    snprintf(key, NV_BENCH_KEY_SIZE, "key%" PRIu32, index);
+}
+
+static void nv_bench_remove(const char* file)
+{
+    static const char* const suffixes[] = { ".wal", ".lock" };
+    char path[PATH_MAX];
+    nv_config_t config;
+
+    unlink(file);
+
+    for (size_t i = 0; i < ARRAY_SIZE(suffixes); i++) {
+        if (snprintf(path, sizeof(path), "%s%s", file, suffixes[i])
+            < (int)sizeof(path)) {
+            unlink(path);
+        }
+    }
+
+    /* the append sidecar and the generations left by compaction */
+    nv_config_init(&config);
+    config.durability = NV_DURABILITY_NONE;
+    nv_blob_prune(file, NULL, &config);
+}
+
+/**
+ * nv_bench_populate, write keys values of type in one transaction
+ * @return file size, -1 on failure
+ */
+static long nv_bench_populate(const char* file, const nv_bench_type_t* type,
+                              uint32_t keys)
+{
+    char key[NV_BENCH_KEY_SIZE];
+    nv_bench_value_t value;
+
+    nv_bench_remove(file);
+
+    nv_txn_t* txn = nv_txn_begin(file);
+    if (txn == NULL) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < keys; i++) {
+        nv_bench_key(key, i);
+        uint32_t len = nv_bench_fill(&value, type->type, i);
+        nv_txn_sync(txn, key, nv_bench_data(&value, type->type), len,
+                    type->type);
+    }
+
+    if (nv_txn_commit(txn) == false) {
+        nv_txn_abort(txn);
+        return -1;
+    }
+
+    return nv_bench_file_size(file);
+}
+
+static void nv_bench_print(nv_bench_t* bench, const nv_bench_result_t* result)
+{
+    if (bench->format == NV_BENCH_CSV) {
+        printf("%s,%s,%s,%" PRIu32 ",%ld,%" PRIu32 ",%" PRIu32
+               ",%.1f,%.3f,%.3f,%.3f\n",
+               result->api, result->op, result->type, result->keys,
+               result->file_bytes, result->compress, result->iterations,
+               result->ops_per_sec, result->p50_us, result->p99_us,
+               result->cpu_us);
+    } else {
+        printf("%s\n  {\"api\": \"%s\", \"op\": \"%s\", \"type\": \"%s\", "
+               "\"keys\": %" PRIu32 ", \"file_bytes\": %ld, "
+               "\"compress\": %" PRIu32 ", \"iterations\": %" PRIu32 ", "
+               "\"ops_per_sec\": %.1f, \"p50_us\": %.3f, \"p99_us\": %.3f, "
+               "\"cpu_us\": %.3f}",
+               bench->first ? "" : ",", result->api, result->op,
+               result->type, result->keys, result->file_bytes,
+               result->compress, result->iterations, result->ops_per_sec,
+               result->p50_us, result->p99_us, result->cpu_us);
+    }
+
+    bench->first = false;
+    fflush(stdout);
+}
+
+/**
+ * nv_bench_summarize, turn per-op latencies into a result row
+ */
+static void nv_bench_summarize(nv_bench_t* bench, nv_bench_result_t* result,
+                               uint64_t* lat, uint32_t count, uint64_t cpu)
+{
+    uint64_t total = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        total += lat[i];
+    }
+
+    qsort(lat, count, sizeof(uint64_t), nv_bench_compare);
+
+    result->iterations = count;
+    result->ops_per_sec = total ? count * 1e9 / total : 0;
+    result->p50_us = count ? lat[count / 2] / 1e3 : 0;
+    result->p99_us = count ? lat[(uint64_t)count * 99 / 100] / 1e3 : 0;
+    result->cpu_us = count ? cpu / 1e3 / count : 0;
+
+    nv_bench_print(bench, result);
+}
+
+typedef enum {
+    NV_BENCH_GET = 0,
+    NV_BENCH_SYNC,
+    NV_BENCH_DELETE,
+    NV_BENCH_FLUSH,    ///< store sync and whole file rewrite
+    NV_BENCH_OPEN,     ///< store open and close, file read and parse
+} nv_bench_op_t;
+
+static const char* const nv_bench_op_names[] = { "get", "sync", "delete",
+                                                 "flush", "open" };
+
+/**
+ * nv_bench_run, time iterations of op over random keys of a populated file
+ * @param store  open handle, NULL for the path api and open
+ * @param config config of the store and of open
+ */
+static void nv_bench_run(nv_bench_t* bench, const char* file,
+                         nv_store_t* store, const nv_config_t* config,
+                         const nv_bench_type_t* type, nv_bench_op_t op,
+                         uint32_t keys, uint32_t iterations, long file_bytes)
+{
+    char key[NV_BENCH_KEY_SIZE];
+    nv_bench_value_t value;
+    nv_bench_value_t out;
+    uint32_t count = 0;
+    uint64_t cpu = 0;
+
+    /* every delete needs its own key */
+    if (op == NV_BENCH_DELETE && iterations > keys) {
+        iterations = keys;
+    }
+
+    uint64_t* lat = calloc(iterations ? iterations : 1, sizeof(uint64_t));
+    if (lat == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t index = op == NV_BENCH_DELETE ? i : nv_bench_random() % keys;
+        nv_bench_key(key, index);
+
+        uint32_t len = nv_bench_fill(&value, type->type, index + 1);
+        nv_bench_fill(&out, type->type, 0);
+        void* data = nv_bench_data(&value, type->type);
+        char* buffer = nv_bench_data(&out, type->type);
+
+        uint64_t cpu_start = nv_bench_cpu_ns();
+        uint64_t start = nv_bench_now_ns();
+
+        if (op == NV_BENCH_OPEN) {
+            nv_close(nv_open_config(file, config));
+        } else if (op == NV_BENCH_FLUSH) {
+            nv_store_sync(store, key, data, len, type->type);
+            nv_store_flush(store);
+        } else if (op == NV_BENCH_GET) {
+            if (store) {
+                nv_store_get(store, key, buffer, len, type->type);
+            } else {
+                nv_get(file, key, buffer, len, type->type);
+            }
+        } else if (op == NV_BENCH_SYNC) {
+            if (store) {
+                nv_store_sync(store, key, data, len, type->type);
+            } else {
+                nv_sync(file, key, data, len, type->type);
+            }
+        } else {
+            if (store) {
+                nv_store_delete(store, key);
+            } else {
+                nv_delete(file, key);
+            }
+        }
+
+        lat[count++] = nv_bench_now_ns() - start;
+        cpu += nv_bench_cpu_ns() - cpu_start;
+    }
+
+    nv_bench_result_t result = {
+        .api = store || op == NV_BENCH_OPEN ? "store" : "path",
+        .op = nv_bench_op_names[op],
+        .type = type->name,
+        .keys = keys,
+        .file_bytes = file_bytes,
+        .compress = config->compress,
+    };
+    nv_bench_summarize(bench, &result, lat, count, cpu);
+
+    free(lat);
+}
+
+static bool nv_bench_type_selected(const nv_bench_t* bench,
+                                   const nv_bench_type_t* type)
+{
+    if (bench->types == NULL) {
+        return true;
+    }
+
+    size_t len = strlen(type->name);
+    for (const char* p = bench->types; p; p = strchr(p, ',')) {
+        p += *p == ',';
+        if (strncmp(p, type->name, len) == 0
+            && (p[len] == ',' || p[len] == '\0')) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * nv_bench_compress, time whole file rewrites and loads at each level, the
+ * wall time beyond cpu_us is the file I/O the smaller file saves
+ */
+static void nv_bench_compress(nv_bench_t* bench, const char* file,
+                              const nv_bench_type_t* type, uint32_t keys,
+                              uint32_t iterations)
+{
+    for (size_t i = 0; bench->store && i < bench->level_count; i++) {
+        /* every flush rewrites the file instead of appending a record */
+        nv_config_t config = bench->config;
+        config.compress = bench->levels[i];
+        config.wal = false;
+
+        nv_store_t* store = nv_bench_populate(file, type, keys) < 0
+                                ? NULL
+                                : nv_open_config(file, &config);
+        if (store == NULL) {
+            fprintf(stderr, "nv bench open %s fail\n", file);
+            return;
+        }
+
+        /* rewrite the populated file once at this level for its size */
+        nv_bench_value_t value;
+        char key[NV_BENCH_KEY_SIZE];
+        nv_bench_key(key, 0);
+        uint32_t len = nv_bench_fill(&value, type->type, 0);
+        nv_store_sync(store, key, nv_bench_data(&value, type->type), len,
+                      type->type);
+        nv_store_flush(store);
+
+        nv_bench_run(bench, file, store, &config, type, NV_BENCH_FLUSH, keys,
+                     iterations, nv_bench_file_size(file));
+        nv_close(store);
+
+        nv_bench_run(bench, file, NULL, &config, type, NV_BENCH_OPEN, keys,
+                     iterations, nv_bench_file_size(file));
+    }
+}
+
+static void nv_bench_type(nv_bench_t* bench, const char* file,
+                          const nv_bench_type_t* type, uint32_t keys)
+{
+    uint32_t iterations = bench->iterations;
+    if (iterations == 0) {
+        /* path calls touch the whole file, keep large files affordable */
+        iterations = NV_BENCH_PATH_BUDGET / keys;
+        iterations = iterations < 10 ? 10 : iterations > 1000 ? 1000
+                                                              : iterations;
+    }
+
+    for (nv_bench_op_t op = NV_BENCH_GET; bench->path && op <= NV_BENCH_DELETE;
+         op++) {
+        long file_bytes = nv_bench_populate(file, type, keys);
+        if (file_bytes < 0) {
+            fprintf(stderr, "nv bench populate %s fail\n", file);
+            return;
+        }
+
+        nv_bench_run(bench, file, NULL, &bench->config, type, op, keys,
+                     iterations, file_bytes);
+    }
+
+    uint32_t rewrites = iterations;
+    iterations = bench->iterations ? bench->iterations : NV_BENCH_STORE_ITERS;
+
+    for (nv_bench_op_t op = NV_BENCH_GET; bench->store && op <= NV_BENCH_DELETE;
+         op++) {
+        long file_bytes = nv_bench_populate(file, type, keys);
+        nv_store_t* store = file_bytes < 0 ? NULL : nv_open(file);
+        if (store == NULL) {
+            fprintf(stderr, "nv bench open %s fail\n", file);
+            return;
+        }
+
+        nv_bench_run(bench, file, store, &bench->config, type, op, keys,
+                     iterations, file_bytes);
+
+        /* the flush is not part of the in-memory op being measured */
+        nv_close(store);
+    }
+
+    nv_bench_compress(bench, file, type, keys, rewrites);
+}
+
+static bool nv_bench_parse_keys(nv_bench_t* bench, const char* list)
+{
+    bench->key_count = 0;
+
+    for (const char* p = list; *p;) {
+        char* end = NULL;
+        unsigned long keys = strtoul(p, &end, 10);
+        if (end == p || keys == 0 || keys > UINT32_MAX
+            || bench->key_count >= NV_BENCH_MAX_KEYS) {
+            return false;
+        }
+
+        bench->keys[bench->key_count++] = keys;
+        p = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            return false;
+        }
+    }
+
+    return bench->key_count > 0;
+}
+
+static bool nv_bench_parse_levels(nv_bench_t* bench, const char* list)
+{
+    bench->level_count = 0;
+
+    for (const char* p = list; *p;) {
+        char* end = NULL;
+        unsigned long level = strtoul(p, &end, 10);
+        if (end == p || level > 9 || bench->level_count >= NV_BENCH_MAX_LEVELS) {
+            return false;
+        }
+
+        bench->levels[bench->level_count++] = level;
+        p = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            return false;
+        }
+    }
+
+    return bench->level_count > 0;
+}
+
+static void nv_bench_usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -f, --format csv|json     result format, default csv\n"
+            "  -k, --keys N[,N...]       key counts, default "
+            "10,100,1000,10000,100000\n"
+            "  -n, --iterations N        ops per series, default automatic\n"
+            "  -t, --types T[,T...]      data types, default all\n"
+            "  -a, --api path|store|all  api to bench, default all\n"
+            "  -c, --compress L[,L...]   store flush and open compression "
+            "levels 0-9,\n"
+            "                            default the build default\n"
+            "  -d, --dir DIR             scratch directory, default .\n",
+            name);
+}
+
+int main(int argc, char* argv[])
+{
+    static const struct option options[] = {
+        { "format", required_argument, NULL, 'f' },
+        { "keys", required_argument, NULL, 'k' },
+        { "iterations", required_argument, NULL, 'n' },
+        { "types", required_argument, NULL, 't' },
+        { "api", required_argument, NULL, 'a' },
+        { "compress", required_argument, NULL, 'c' },
+        { "dir", required_argument, NULL, 'd' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    nv_bench_t bench = {
+        .format = NV_BENCH_CSV,
+        .dir = ".",
+        .keys = { 10, 100, 1000, 10000, 100000 },
+        .key_count = 5,
+        .path = true,
+        .store = true,
+        .first = true,
+    };
+
+    nv_config_init(&bench.config);
+    bench.levels[0] = bench.config.compress;
+    bench.level_count = 1;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:k:n:t:a:c:d:h", options, NULL))
+           != -1) {
+        switch (opt) {
+        case 'f':
+            if (strcmp(optarg, "csv") == 0) {
+                bench.format = NV_BENCH_CSV;
+            } else if (strcmp(optarg, "json") == 0) {
+                bench.format = NV_BENCH_JSON;
+            } else {
+                nv_bench_usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'k':
+            if (nv_bench_parse_keys(&bench, optarg) == false) {
+                nv_bench_usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'n':
+            bench.iterations = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            bench.types = optarg;
+            break;
+        case 'a':
+            bench.path = strcmp(optarg, "store") != 0;
+            bench.store = strcmp(optarg, "path") != 0;
+            break;
+        case 'c':
+            if (nv_bench_parse_levels(&bench, optarg) == false) {
+                nv_bench_usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'd':
+            bench.dir = optarg;
+            break;
+        default:
+            nv_bench_usage(argv[0]);
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+
+    char file[NV_BENCH_PATH_SIZE];
+    snprintf(file, sizeof(file), "%s/nv_bench.json", bench.dir);
+
+    if (bench.format == NV_BENCH_CSV) {
+        printf("api,op,type,keys,file_bytes,compress,iterations,ops_per_sec,"
+               "p50_us,p99_us,cpu_us\n");
+    } else {
+        printf("[");
+    }
+
+    for (size_t k = 0; k < bench.key_count; k++) {
+        for (size_t i = 0; i < ARRAY_SIZE(nv_bench_types); i++) {
+            if (nv_bench_type_selected(&bench, &nv_bench_types[i])) {
+                nv_bench_type(&bench, file, &nv_bench_types[i], bench.keys[k]);
+            }
+        }
+    }
+
+    if (bench.format == NV_BENCH_JSON) {
+        printf("\n]\n");
+    }
+
+    nv_bench_remove(file);
+    return 0;
+}
@@ -18,376 +18,5470 @@
 #include "nv.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/file.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "cJSON.h"
+#include "cJSON_Utils.h"
+#include "nv_arena.h"
+#include "nv_binary.h"
+#include "nv_blob.h"
+#include "nv_durable.h"
+#include "nv_index.h"
+#include "nv_keys.h"
+#include "nv_lz.h"
+#include "nv_packed.h"
+#include "nv_rcu.h"
+#include "nv_scan.h"
+#include "nv_stats.h"
+#include "nv_wal.h"
 
 #ifndef UNUSED
 #define UNUSED(x) ((void)(x))
 #endif /* UNUSED */
 
-#ifndef CONFIG_NV_DATA_BUFFER_SIZE
-#define CONFIG_NV_DATA_BUFFER_SIZE 512    // TODO, 1024 Bytes enough?
-#endif /* CONFIG_NV_DATA_BUFFER_SIZE */
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+#endif /* ARRAY_SIZE */
+
+#define NV_JSON_MAX_SAFE_INT 9007199254740992ULL    // 2^53, exact in double
+
+#define NV_ADDR_STR_SIZE 72    // 6 * "-2147483648" plus separators
+
+#define NV_RANGE_APPEND UINT32_MAX    // splice offset of the array end
+
+#ifndef CONFIG_NV_WAL
+#define CONFIG_NV_WAL 0
+#endif /* CONFIG_NV_WAL */
+
+#ifndef CONFIG_NV_WAL_COMPACT_SIZE
+#define CONFIG_NV_WAL_COMPACT_SIZE 16384
+#endif /* CONFIG_NV_WAL_COMPACT_SIZE */
+
+#ifndef CONFIG_NV_DURABILITY
+#define CONFIG_NV_DURABILITY NV_DURABILITY_FULL
+#endif /* CONFIG_NV_DURABILITY */
+
+#ifndef CONFIG_NV_GROUP_COMMIT_US
+#define CONFIG_NV_GROUP_COMMIT_US 2000
+#endif /* CONFIG_NV_GROUP_COMMIT_US */
+
+#ifndef CONFIG_NV_THREAD_SAFE
+#define CONFIG_NV_THREAD_SAFE 0
+#endif
+
+#ifndef CONFIG_NV_SHARED
+#define CONFIG_NV_SHARED 0
+#endif
+
+#ifndef CONFIG_NV_ARENA
+#define CONFIG_NV_ARENA 0
+#endif
+
+#ifndef CONFIG_NV_REGISTRY
+#define CONFIG_NV_REGISTRY 0
+#endif
+
+#ifndef CONFIG_NV_REGISTRY_BUDGET
+#define CONFIG_NV_REGISTRY_BUDGET 8388608
+#endif
+
+#ifndef CONFIG_NV_FLUSH_INTERVAL_MS
+#define CONFIG_NV_FLUSH_INTERVAL_MS 1000
+#endif
+
+#ifndef CONFIG_NV_FLUSH_DIRTY_SIZE
+#define CONFIG_NV_FLUSH_DIRTY_SIZE 65536
+#endif
+
+/* path API calls are served by stores kept parsed in the process registry */
+#define NV_PATH_REGISTRY (CONFIG_NV_SHARED || CONFIG_NV_REGISTRY)
+
+#define NV_PRINT_BUFFER_SIZE 4096
+#define NV_PRINT_SLACK       5    // cJSON_PrintPreallocated may overshoot
+
+#define NV_LOCK_SUFFIX ".lock"
+
+#ifndef CONFIG_NV_FORMAT
+#define CONFIG_NV_FORMAT NV_FORMAT_AUTO
+#endif /* CONFIG_NV_FORMAT */
+
+#ifndef CONFIG_NV_COMPRESS
+#define CONFIG_NV_COMPRESS 0
+#endif /* CONFIG_NV_COMPRESS */
+
+#ifndef CONFIG_NV_RETIRED_VERSIONS
+#define CONFIG_NV_RETIRED_VERSIONS 8
+#endif /* CONFIG_NV_RETIRED_VERSIONS */
+
+typedef struct {
+    const char* name;
+    bool (*match)(const char* data, size_t len);
+    cJSON* (*decode)(const char* data, size_t len);
+    char* (*encode)(const cJSON* json, size_t* len);
+    void (*release)(void* data);    ///< free what encode returned
+} nv_backend_t;
+
+static bool nv_json_match(const char* data, size_t len);
+static cJSON* nv_json_decode(const char* data, size_t len);
+static char* nv_json_encode(const cJSON* json, size_t* len);
+static void nv_json_release(void* data);
+
+static const nv_backend_t nv_backends[] = {
+    [NV_FORMAT_JSON] = { "json", nv_json_match, nv_json_decode,
+                         nv_json_encode, nv_json_release },
+    [NV_FORMAT_BINARY] = { "binary", nv_binary_match, nv_binary_decode,
+                           nv_binary_encode, cJSON_free },
+};
+
+/* print buffer of this thread, reused by every json encode */
+static _Thread_local char* nv_print_buffer;
+static _Thread_local size_t nv_print_size;
+static pthread_once_t nv_print_once = PTHREAD_ONCE_INIT;
+static pthread_key_t nv_print_key;
+
+/**
+ * nv_write to file
+ * @param file nv file path
+ * @param data data buffer
+ * @return     boolean
+ */
+bool nv_write(const char* file, void* data)
+{
+    nv_config_t config;
+    nv_config_init(&config);
+
+    return nv_durable_write(file, data, strlen((const char*)data), &config);
+}
+
+typedef struct {
+    char* data;     ///< file content, not nul terminated
+    size_t len;     ///< file content length
+    bool mapped;    ///< data is a mmap view, else heap memory
+} nv_view_t;
+
+/**
+ * nv_view_open, map whole file read-only, fall back to a heap copy
+ * @param file nv file path
+ * @param view file content view
+ * @return     boolean
+ */
+static bool nv_view_open(const char* file, nv_view_t* view)
+{
+    memset(view, 0, sizeof(nv_view_t));
+
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        nv_log("nv read open %s fail, errno %d %s\n", file, errno,
+               strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+        view->data = data;
+        view->len = st.st_size;
+        view->mapped = true;
+        close(fd);
+        return true;
+    }
+
+    nv_log("nv mmap %s fail, errno %d %s\n", file, errno, strerror(errno));
+
+    view->data = malloc(st.st_size);
+    if (view->data == NULL) {
+        close(fd);
+        return false;
+    }
+
+    while (view->len < (size_t)st.st_size) {
+        ssize_t ret = read(fd, view->data + view->len, st.st_size - view->len);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        view->len += ret;
+    }
+    close(fd);
+
+    return true;
+}
+
+/**
+ * nv_view_close
+ * @param view file content view
+ */
+static void nv_view_close(nv_view_t* view)
+{
+    if (view->mapped) {
+        munmap(view->data, view->len);
+    } else {
+        free(view->data);
+    }
+
+    memset(view, 0, sizeof(nv_view_t));
+}
+
+/**
+ * nv_view_inflate, replace a compressed container by its original bytes
+ * @param view file content view, kept if not compressed
+ * @return     boolean, false if the container is invalid
+ */
+static bool nv_view_inflate(nv_view_t* view)
+{
+    if (nv_lz_match(view->data, view->len) == false) {
+        return true;
+    }
+
+    size_t len = 0;
+    uint64_t start = nv_stats_begin();
+    char* data = nv_lz_decompress(view->data, view->len, &len);
+    nv_stats_end(NV_STATS_COMPRESS, start);
+    nv_view_close(view);
+
+    if (data == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    view->data = data;
+    view->len = len;
+    return true;
+}
+
+/**
+ * nv_read from file
+ * @param file nv file path
+ * @param data data buffer, nul terminated
+ * @param size data buffer size, more than the file content
+ * @return     boolean, false if the content does not fit
+ */
+bool nv_read(const char* file, void* data, size_t size)
+{
+    nv_view_t view;
+    if (nv_view_open(file, &view) == false) {
+        return false;
+    }
+
+    /* a compressed file reads as the json text it holds */
+    bool ret = nv_view_inflate(&view);
+    if (ret == false) {
+        nv_log("nv read %s invalid compressed data\n", file);
+    } else if (view.len >= size) {
+        nv_log("nv read %s needs %zu bytes, buffer %zu\n", file,
+               view.len + 1, size);
+        ret = false;
+    } else {
+        memcpy(data, view.data, view.len);
+        ((char*)data)[view.len] = '\0';
+    }
+
+    nv_view_close(&view);
+    return ret;
+}
+
+/**
+ * nv_json_match, json is the fallback format, it matches any content
+ */
+static bool nv_json_match(const char* data, size_t len)
+{
+    UNUSED(data);
+    UNUSED(len);
+
+    return true;
+}
+
+static cJSON* nv_json_decode(const char* data, size_t len)
+{
+    /* well formed objects skip the byte at a time parser */
+    cJSON* json = nv_scan_parse(data, len);
+
+    return json ? json : cJSON_ParseWithLength(data, len);
+}
+
+static void nv_print_exit(void* buffer)
+{
+    free(buffer);
+}
+
+static void nv_print_init(void)
+{
+    pthread_key_create(&nv_print_key, nv_print_exit);
+}
+
+/**
+ * nv_json_encode, print into the reused per-thread buffer, grown on demand
+ */
+static char* nv_json_encode(const cJSON* json, size_t* len)
+{
+    for (;;) {
+        if (nv_print_buffer
+            && cJSON_PrintPreallocated((cJSON*)json, nv_print_buffer,
+                                       nv_print_size, true)) {
+            *len = strlen(nv_print_buffer);
+            return nv_print_buffer;
+        }
+
+        size_t size = nv_print_size ? nv_print_size * 2 : NV_PRINT_BUFFER_SIZE;
+        char* buffer = realloc(nv_print_buffer, size + NV_PRINT_SLACK);
+        if (buffer == NULL) {
+            return NULL;
+        }
+
+        nv_print_buffer = buffer;
+        nv_print_size = size;
+
+        pthread_once(&nv_print_once, nv_print_init);
+        pthread_setspecific(nv_print_key, buffer);
+    }
+}
+
+/**
+ * nv_json_release, the print buffer stays with the thread
+ */
+static void nv_json_release(void* data)
+{
+    UNUSED(data);
+}
+
+/**
+ * nv_backend_detect, pick backend by file content magic
+ * @param data file content
+ * @param len  file content length
+ * @return     file format
+ */
+static nv_format_t nv_backend_detect(const char* data, size_t len)
+{
+    for (size_t i = ARRAY_SIZE(nv_backends) - 1; i > NV_FORMAT_JSON; i--) {
+        if (nv_backends[i].match(data, len)) {
+            return i;
+        }
+    }
+
+    return NV_FORMAT_JSON;
+}
+
+/*
+ * Identity of the nv file and its log as seen by stat, every write replaces
+ * the file by rename (new inode) or appends to the log (new size), so an
+ * equal stamp means the parsed tree is still current.
+ */
+typedef struct {
+    dev_t dev;                    ///< nv file device, 0 if not exist
+    ino_t ino;                    ///< nv file inode
+    off_t size;                   ///< nv file size
+    struct timespec mtime;        ///< nv file modification time
+    ino_t wal_ino;                ///< log inode, 0 if not exist
+    off_t wal_size;               ///< log size
+    struct timespec wal_mtime;    ///< log modification time
+} nv_stamp_t;
+
+typedef struct nv_registry_entry nv_registry_entry_t;
+
+struct nv_watch {
+    nv_watch_t* next;
+    char* key;            ///< watched key, or prefix without the '*'
+    bool prefix;          ///< key was given with a trailing '*'
+    nv_watch_cb_t cb;     ///< change callback
+    void* arg;            ///< callback argument
+};
+
+typedef struct nv_patch {
+    struct nv_patch* next;
+    nv_watch_t* watch;    ///< identity only, the watch may be gone
+    nv_watch_cb_t cb;     ///< callback copied from the watch
+    void* arg;            ///< argument copied from the watch
+    char text[];          ///< RFC 6902 patch
+} nv_patch_t;
+
+struct nv_item {
+    const char* file;     ///< nv file path, locates the blob sidecar
+    const cJSON* json;    ///< visited member
+};
+
+/*
+ * the top level members of a version only reference their values, values
+ * that a write leaves unchanged are shared with the next version. a value a
+ * write replaces or deletes is freed with the last version that has it,
+ * versions are freed oldest first once no reader or snapshot sees them.
+ */
+typedef struct nv_version {
+    cJSON* json;          ///< published tree, never modified
+    nv_index_t index;     ///< key index of the tree
+    nv_stamp_t stamp;     ///< file stamp the tree was read or written at
+    _Atomic(nv_keys_t*) keys;    ///< ordered keys, built by the first scan
+    atomic_uint pins;            ///< snapshots of this version
+    cJSON* garbage;              ///< values the next version dropped
+    uint64_t seq;                ///< publish order
+    struct nv_version* next;     ///< next retired version
+} nv_version_t;
+
+struct nv_snapshot {
+    nv_store_t* store;        ///< store the view was taken of
+    nv_version_t* version;    ///< pinned version
+    cJSON* json;              ///< tree of the view
+};
+
+struct nv_store {
+    char* file;            ///< nv file path
+    char* wal_file;        ///< append-only log path
+    cJSON* json;           ///< resident parsed tree
+    bool dirty;            ///< tree differs from the file
+    bool wal_exist;        ///< log file must be folded or dropped on save
+    bool wal_lost;         ///< a record was not queued, rewrite on flush
+    nv_config_t config;    ///< store config
+    nv_format_t format;    ///< on-disk format, kept unless config asks else
+    nv_wal_buf_t wal;      ///< pending log records
+    nv_index_t index;      ///< key index, built on the second lookup
+    uint32_t lookups;      ///< lookups done before the index is built
+    nv_keys_t keys;        ///< ordered keys, built on the first scan
+
+    /* registry, least recently used stores are closed beyond its budget */
+    atomic_size_t footprint;       ///< estimated heap bytes of json
+    nv_registry_entry_t* entry;    ///< NULL if not opened by a registry
+
+    /*
+     * flusher, keys updated since the last write, applied on top of a reload
+     * when another writer changed the file so its keys are kept
+     */
+    cJSON* unwritten;        ///< keys of the updates not written yet
+    bool unwritten_lost;     ///< a key was not recorded, write the tree
+
+    /*
+     * thread safe mode, json aliases the published version between writes,
+     * a writer copies it, updates the copy and publishes it as a new version
+     */
+    pthread_mutex_t lock;               ///< serializes writers and flush
+    nv_rcu_t* rcu;                      ///< reader tracking
+    _Atomic(nv_version_t*) version;    ///< version seen by readers
+    nv_version_t* retired;              ///< oldest superseded version
+    nv_version_t* retired_tail;         ///< newest superseded version
+    size_t retired_count;               ///< superseded versions kept
+    uint64_t published;                 ///< seq of the current version
+    uint64_t grace;                     ///< versions before it are unseen
+    pthread_mutex_t grace_lock;         ///< serializes grace periods
+    cJSON* dropped;                     ///< values the write replaced
+    size_t wal_mark;                    ///< pending log bytes before the write
+    bool dirty_mark;                    ///< dirty before the write
+
+    /*
+     * shared mode, writers hold an flock on "<file>.lock" across reload,
+     * update and write-through, readers reload when the file stamp changed
+     */
+    int lock_fd;          ///< lock file, -1 if not shared
+    nv_stamp_t stamp;     ///< file stamp of json
+    bool txn;             ///< transaction holds the file lock until commit
+
+    /*
+     * watch, patches are staged by a write under the writer lock, queued
+     * when it is committed and delivered once the writer lock is released
+     */
+    pthread_mutex_t watch_lock;         ///< guards the lists below
+    _Atomic(nv_watch_t*) watches;       ///< subscriptions
+    nv_patch_t* staged;                 ///< patches of the write in progress
+    _Atomic(nv_patch_t*) pending;       ///< committed, not delivered yet
+    bool delivering;                    ///< a thread runs the callbacks
+    int watch_fd;                       ///< inotify descriptor, -1 if none
+
+#if CONFIG_NV_STATS
+    nv_stats_data_t stats;    ///< counters of this store
+#endif
+};
+
+struct nv_registry_entry {
+    nv_registry_entry_t* prev;    ///< more recently used
+    nv_registry_entry_t* next;    ///< less recently used
+    char* file;                   ///< nv file path
+    nv_store_t* store;            ///< open store, NULL while parsed
+    uint32_t refs;                ///< nv_registry_open without close
+};
+
+struct nv_registry {
+    pthread_mutex_t lock;         ///< guards the list and the references
+    pthread_cond_t cond;          ///< wakes openers of a parsed path
+    nv_config_t config;           ///< config of every store opened
+    size_t budget;                ///< estimated tree bytes kept
+    bool deferred;                ///< dirty stores written by the flusher
+    nv_registry_entry_t* head;    ///< most recently used
+    nv_registry_entry_t* tail;    ///< least recently used
+};
+
+static pthread_mutex_t nv_path_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_once_t nv_path_once = PTHREAD_ONCE_INIT;
+static nv_registry_t* nv_path_registry;
+
+/*
+ * write-behind of nv_sync_async, updates go to private stores of the
+ * flusher registry under data_lock, the flusher thread encodes a dirty
+ * store under data_lock and writes it outside, so updaters never wait for
+ * the disk. write_lock orders the file writes of one store.
+ */
+static struct {
+    pthread_mutex_t lock;           ///< guards the generations below
+    pthread_cond_t cond;            ///< wakes the flusher thread
+    pthread_cond_t done;            ///< wakes nv_flush_wait
+    pthread_mutex_t data_lock;      ///< guards the trees of the stores
+    pthread_mutex_t write_lock;     ///< serializes store file writes
+    pthread_once_t once;
+    _Atomic(nv_registry_t*) registry;    ///< NULL until the thread runs
+    atomic_size_t dirty;                 ///< bytes updated since last flush
+    uint64_t requested;                  ///< flush generation requested
+    uint64_t completed;                  ///< flush generation written
+    bool ret;                            ///< result of the last flush
+} nv_flusher = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .data_lock = PTHREAD_MUTEX_INITIALIZER,
+    .write_lock = PTHREAD_MUTEX_INITIALIZER,
+    .once = PTHREAD_ONCE_INIT,
+    .ret = true,
+};
+
+struct nv_txn {
+    nv_store_t* store;    ///< private store the batch is applied to
+    nv_arena_t arena;     ///< tree memory, released at once on commit
+};
+
+/**
+ * nv_path_suffix
+ * @param file   nv file path
+ * @param suffix path suffix
+ * @return       allocated path, NULL on failure
+ */
+static char* nv_path_suffix(const char* file, const char* suffix)
+{
+    size_t len = strlen(file) + strlen(suffix) + 1;
+
+    char* path = malloc(len);
+    if (path) {
+        snprintf(path, len, "%s%s", file, suffix);
+    }
+
+    return path;
+}
+
+/**
+ * nv_load, read and decode nv file, then replay its log
+ * @param file      nv file path
+ * @param wal_file  log file path
+ * @param wal_exist log file exist
+ * @param format    detected file format
+ * @return          tree, NULL if neither file exist or file invalid
+ */
+static cJSON* nv_load(const char* file, const char* wal_file, bool* wal_exist,
+                      nv_format_t* format)
+{
+    cJSON* json = NULL;
+
+    *wal_exist = access(wal_file, F_OK) == 0;
+    *format = NV_FORMAT_JSON;
+
+    if (access(file, F_OK) == 0) {
+        nv_view_t view;
+        uint64_t start = nv_stats_begin();
+        if (nv_view_open(file, &view) == false) {
+            nv_log("nv load, nv read %s fail, error %d %s\n", file, errno,
+                   strerror(errno));
+            return NULL;
+        }
+        nv_stats_end(NV_STATS_READ, start);
+        nv_stats_add(NV_STATS_BYTES_READ, view.len);
+
+        if (nv_view_inflate(&view) == false) {
+            nv_log("nv load %s decompress fail\n", file);
+            return NULL;
+        }
+
+        start = nv_stats_begin();
+        *format = nv_backend_detect(view.data, view.len);
+        json = nv_backends[*format].decode(view.data, view.len);
+        nv_stats_end(NV_STATS_PARSE, start);
+        nv_view_close(&view);
+
+        if (json == NULL) {
+            nv_log("nv load %s decode %s fail\n", file,
+                   nv_backends[*format].name);
+            return NULL;
+        }
+    } else if (*wal_exist) {
+        json = cJSON_CreateObject();
+    }
+
+    if (json && *wal_exist) {
+        nv_wal_replay(wal_file, json);
+    }
+
+    return json;
+}
+
+/**
+ * nv_file_write, write encoded tree to nv file, compressed if the config
+ * sets a level and it gets smaller
+ * @param file   nv file path
+ * @param data   encoded tree
+ * @param len    encoded length
+ * @param config write durability and compression level
+ * @return       boolean
+ */
+static bool nv_file_write(const char* file, const char* data, size_t len,
+                          const nv_config_t* config)
+{
+    if (config->compress == 0) {
+        return nv_durable_write(file, data, len, config);
+    }
+
+    size_t size = 0;
+    uint64_t start = nv_stats_begin();
+    char* packed = nv_lz_compress(data, len, config->compress, &size);
+    nv_stats_end(NV_STATS_COMPRESS, start);
+    if (packed == NULL) {
+        nv_log("nv %s compress fail\n", file);
+        return false;
+    }
+
+    bool ret = size < len ? nv_durable_write(file, packed, size, config)
+                          : nv_durable_write(file, data, len, config);
+    free(packed);
+
+    return ret;
+}
+
+/**
+ * nv_save, encode and write tree to nv file
+ * @param file   nv file path
+ * @param json   tree
+ * @param format file format
+ * @param config write durability
+ * @return       boolean
+ */
+static bool nv_save(const char* file, const cJSON* json, nv_format_t format,
+                    const nv_config_t* config)
+{
+    size_t len = 0;
+    uint64_t start = nv_stats_begin();
+    char* data = nv_backends[format].encode(json, &len);
+    nv_stats_end(NV_STATS_SERIALIZE, start);
+    if (data == NULL) {
+        nv_log("nv save %s encode %s fail\n", file, nv_backends[format].name);
+        return false;
+    }
+
+    bool ret = nv_file_write(file, data, len, config);
+    if (ret == false) {
+        nv_log("nv write %s fail, errno %d %s\n", file, errno, strerror(errno));
+    }
+    nv_backends[format].release(data);
+
+    return ret;
+}
+
+/**
+ * nv_json_create_u64, numbers beyond 2^53 are kept as exact raw text
+ * @param value number
+ * @return      item
+ */
+static cJSON* nv_json_create_u64(uint64_t value)
+{
+    char str[24];
+
+    if (value <= NV_JSON_MAX_SAFE_INT) {
+        return cJSON_CreateNumber((double)value);
+    }
+
+    snprintf(str, sizeof(str), "%" PRIu64, value);
+    return cJSON_CreateRaw(str);
+}
+
+/**
+ * nv_json_create_s64, numbers beyond +-2^53 are kept as exact raw text
+ * @param value number
+ * @return      item
+ */
+static cJSON* nv_json_create_s64(int64_t value)
+{
+    char str[24];
+
+    if (value <= (int64_t)NV_JSON_MAX_SAFE_INT
+        && value >= -(int64_t)NV_JSON_MAX_SAFE_INT) {
+        return cJSON_CreateNumber((double)value);
+    }
+
+    snprintf(str, sizeof(str), "%" PRId64, value);
+    return cJSON_CreateRaw(str);
+}
+
+/**
+ * nv_json_create_packed, packed array object of the elements
+ * @param value data buffer
+ * @param len   number of elements
+ * @param type  packed array data type
+ * @return      item, NULL on failure
+ */
+static cJSON* nv_json_create_packed(const void* value, uint32_t len,
+                                    nv_data_type_t type)
+{
+    nv_packed_info_t info;
+    if (nv_packed_info(type, &info) == false) {
+        return NULL;
+    }
+
+    char* data = nv_packed_encode(value, len, info.size);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    cJSON* item = cJSON_CreateObject();
+    if (cJSON_AddStringToObject(item, NV_PACKED_KEY, info.tag) == NULL
+        || cJSON_AddStringToObject(item, NV_PACKED_DATA, data) == NULL) {
+        cJSON_Delete(item);
+        item = NULL;
+    }
+    free(data);
+
+    return item;
+}
+
+/**
+ * nv_json_footprint, estimated heap bytes of item and its children
+ * @param item item
+ * @return     bytes
+ */
+static size_t nv_json_footprint(const cJSON* item)
+{
+    size_t size = sizeof(cJSON);
+
+    if (item->string && (item->type & cJSON_StringIsConst) == 0) {
+        size += strlen(item->string) + 1;
+    }
+
+    if (item->valuestring) {
+        size += strlen(item->valuestring) + 1;
+    }
+
+    for (const cJSON* child = item->child; child; child = child->next) {
+        size += nv_json_footprint(child);
+    }
+
+    return size;
+}
+
+/**
+ * nv_json_find
+ * @param json  tree
+ * @param index key index, linear search if not built
+ * @param key   nv key
+ * @return      object member, NULL if not exist
+ */
+static cJSON* nv_json_find(const cJSON* json, const nv_index_t* index,
+                           const char* key)
+{
+    if (index->slots) {
+        return nv_index_find(index, key);
+    }
+
+    return cJSON_GetObjectItem(json, key);
+}
+
+/**
+ * nv_json_assign, move src value into dst keeping dst key and position
+ * @param dst existing object member
+ * @param src detached new value, freed
+ */
+static void nv_json_assign(cJSON* dst, cJSON* src)
+{
+    if ((dst->type & cJSON_IsReference) == 0) {
+        cJSON_Delete(dst->child);
+        cJSON_free(dst->valuestring);
+    }
+
+    dst->type = (src->type & ~cJSON_StringIsConst)
+                | (dst->type & cJSON_StringIsConst);
+    dst->child = src->child;
+    dst->valuestring = src->valuestring;
+    dst->valueint = src->valueint;
+    dst->valuedouble = src->valuedouble;
+
+    src->child = NULL;
+    src->valuestring = NULL;
+    cJSON_Delete(src);
+}
+
+/**
+ * nv_json_set, update or add key in tree
+ * @param json     tree
+ * @param index    key index, kept in sync if built
+ * @param key_item existing member of key, NULL to add
+ * @param key      nv key
+ * @param value    data buffer
+ * @param len      data buffer length
+ * @param type     data type
+ * @return         member holding the value, NULL on failure
+ */
+static cJSON* nv_json_set(cJSON* json, nv_index_t* index, cJSON* key_item,
+                          const char* key, void* value, uint32_t len,
+                          nv_data_type_t type)
+{
+    char nv_buffer[NV_ADDR_STR_SIZE] = { 0 };
+    cJSON* item = NULL;
+
+    switch (type) {
+    case NV_DATA_U8:
+        item = cJSON_CreateNumber(*(uint8_t*)value);
+        break;
+    case NV_DATA_S8:
+        item = cJSON_CreateNumber(*(int8_t*)value);
+        break;
+    case NV_DATA_U16:
+        item = cJSON_CreateNumber(*(uint16_t*)value);
+        break;
+    case NV_DATA_S16:
+        item = cJSON_CreateNumber(*(int16_t*)value);
+        break;
+    case NV_DATA_U32:
+        item = cJSON_CreateNumber(*(uint32_t*)value);
+        break;
+    case NV_DATA_S32:
+        item = cJSON_CreateNumber(*(int32_t*)value);
+        break;
+    case NV_DATA_U64:
+        item = nv_json_create_u64(*(uint64_t*)value);
+        break;
+    case NV_DATA_S64:
+        item = nv_json_create_s64(*(int64_t*)value);
+        break;
+    case NV_DATA_FLOAT:
+        item = cJSON_CreateNumber(*(float*)value);
+        break;
+    case NV_DATA_DOUBLE:
+        item = cJSON_CreateNumber(*(double*)value);
+        break;
+    case NV_DATA_STR:
+        item = cJSON_CreateString(value);
+        break;
+    case NV_DATA_STRING_ARRAY:
+        item = cJSON_CreateStringArray((const char**)value, len);
+        break;
+    case NV_DATA_INT_ARRAY:
+        item = cJSON_CreateIntArray((const int*)value, len);
+        break;
+    case NV_DATA_FLOAT_ARRAY:
+        item = cJSON_CreateFloatArray((const float*)value, len);
+        break;
+    case NV_DATA_DOUBLE_ARRAY:
+        item = cJSON_CreateDoubleArray((const double*)value, len);
+        break;
+    case NV_DATA_IP:
+        snprintf(nv_buffer, sizeof(nv_buffer), "%d.%d.%d.%d",
+                 *((uint32_t*)value), *((uint32_t*)value + 1),
+                 *((uint32_t*)value + 2), *((uint32_t*)value + 3));
+        item = cJSON_CreateString(nv_buffer);
+        break;
+    case NV_DATA_MAC:
+        snprintf(nv_buffer, sizeof(nv_buffer), "%d-%d-%d-%d-%d-%d",
+                 *((uint32_t*)value), *((uint32_t*)value + 1),
+                 *((uint32_t*)value + 2), *((uint32_t*)value + 3),
+                 *((uint32_t*)value + 4), *((uint32_t*)value + 5));
+        item = cJSON_CreateString(nv_buffer);
+        break;
+    case NV_DATA_PACKED_INT_ARRAY:
+    case NV_DATA_PACKED_FLOAT_ARRAY:
+    case NV_DATA_PACKED_DOUBLE_ARRAY:
+        item = nv_json_create_packed(value, len, type);
+        break;
+    case NV_DATA_BLOB:
+        /* nv_store_set already appended the bytes, value is the reference */
+        item = nv_blob_item((const nv_blob_ref_t*)value);
+        break;
+    default:
+        nv_log("unknown %d type\n", type);
+        return NULL;
+    }
+
+    if (item == NULL) {
+        nv_log("cJSON create key %s type %d fail\n", key, type);
+        return NULL;
+    }
+
+    /* updating in place keeps the member pointer, so the index stays valid */
+    if (key_item) {
+        nv_json_assign(key_item, item);
+        return key_item;
+    }
+
+    if (cJSON_AddItemToObject(json, key, item) == false) {
+        nv_log("cJSON_AddItemToObject key %s fail\n", key);
+        cJSON_Delete(item);
+        return NULL;
+    }
+
+    if (nv_index_insert(index, item) == false) {
+        /* a stale index would miss the key, fall back to linear search */
+        nv_index_free(index);
+    }
+
+    return item;
+}
+
+/**
+ * nv_json_is_array, data type holds an array of elements
+ * @param type data type
+ * @return     boolean
+ */
+static bool nv_json_is_array(nv_data_type_t type)
+{
+    return type == NV_DATA_STRING_ARRAY || type == NV_DATA_INT_ARRAY
+           || type == NV_DATA_FLOAT_ARRAY || type == NV_DATA_DOUBLE_ARRAY;
+}
+
+/**
+ * nv_json_element_get, copy one array element into the typed buffer
+ * @param element array element
+ * @param value   data buffer of the array type
+ * @param i       buffer element
+ * @param type    array data type
+ */
+static void nv_json_element_get(const cJSON* element, char* value, size_t i,
+                                nv_data_type_t type)
+{
+    if (type == NV_DATA_STRING_ARRAY) {
+        if (element->valuestring) {
+            memcpy(((char**)value)[i], element->valuestring,
+                   strlen(element->valuestring) + 1);
+        }
+    } else if (type == NV_DATA_INT_ARRAY) {
+        *((int32_t*)value + i) = element->valueint;
+    } else if (type == NV_DATA_FLOAT_ARRAY) {
+        *((float*)value + i) = element->valuedouble;
+    } else {
+        *((double*)value + i) = element->valuedouble;
+    }
+}
+
+/**
+ * nv_json_element_create, new array element from the typed buffer
+ * @param value data buffer of the array type
+ * @param i     buffer element
+ * @param type  array data type
+ * @return      element, NULL on failure
+ */
+static cJSON* nv_json_element_create(const void* value, size_t i,
+                                     nv_data_type_t type)
+{
+    if (type == NV_DATA_STRING_ARRAY) {
+        return cJSON_CreateString(((char* const*)value)[i]);
+    } else if (type == NV_DATA_INT_ARRAY) {
+        return cJSON_CreateNumber(*((const int32_t*)value + i));
+    } else if (type == NV_DATA_FLOAT_ARRAY) {
+        return cJSON_CreateNumber(*((const float*)value + i));
+    }
+
+    return cJSON_CreateNumber(*((const double*)value + i));
+}
+
+/**
+ * nv_json_get_packed, decode a packed array object into the typed buffer
+ * @param key_item object member
+ * @param value    data buffer
+ * @param len      number of buffer elements
+ * @param type     numeric array data type, packed or not
+ * @return         boolean
+ */
+static bool nv_json_get_packed(const cJSON* key_item, char* value,
+                               uint32_t len, nv_data_type_t type)
+{
+    nv_packed_info_t info;
+    const cJSON* tag = cJSON_GetObjectItemCaseSensitive(key_item,
+                                                        NV_PACKED_KEY);
+    const cJSON* data = cJSON_GetObjectItemCaseSensitive(key_item,
+                                                         NV_PACKED_DATA);
+    if (nv_packed_info(type, &info) == false || cJSON_IsString(tag) == false
+        || cJSON_IsString(data) == false
+        || strcmp(tag->valuestring, info.tag) != 0) {
+        nv_log("nv %s is not a packed %d array\n", key_item->string, type);
+        return false;
+    }
+
+    /* at most len elements, straight into the caller buffer */
+    return nv_packed_decode(data->valuestring, strlen(data->valuestring),
+                            value, len, info.size);
+}
+
+/**
+ * nv_json_unpacked, plain array data type of a packed one
+ * @param type data type
+ * @return     plain array data type, type itself if not packed
+ */
+static nv_data_type_t nv_json_unpacked(nv_data_type_t type)
+{
+    switch (type) {
+    case NV_DATA_PACKED_INT_ARRAY:
+        return NV_DATA_INT_ARRAY;
+    case NV_DATA_PACKED_FLOAT_ARRAY:
+        return NV_DATA_FLOAT_ARRAY;
+    case NV_DATA_PACKED_DOUBLE_ARRAY:
+        return NV_DATA_DOUBLE_ARRAY;
+    default:
+        return type;
+    }
+}
+
+/**
+ * nv_json_range_check, ranged access of type fits the stored array, a packed
+ * layout keeps the whole array in one encoded string and fails with ENOTSUP,
+ * a stored array of other elements fails with EINVAL
+ * @param key      nv key
+ * @param key_item object member, NULL if key not exist
+ * @param type     array data type
+ * @return         boolean
+ */
+static bool nv_json_range_check(const char* key, const cJSON* key_item,
+                                nv_data_type_t type)
+{
+    UNUSED(key);
+
+    if (nv_json_unpacked(type) != type
+        || (cJSON_IsObject(key_item)
+            && cJSON_GetObjectItemCaseSensitive(key_item, NV_PACKED_KEY))) {
+        nv_log("nv key %s packed array has no ranged access\n", key);
+        errno = ENOTSUP;
+        return false;
+    }
+
+    if (nv_json_is_array(type) == false) {
+        nv_log("nv key %s type %d is not an array\n", key, type);
+        errno = EINVAL;
+        return false;
+    }
+
+    if (key_item == NULL) {
+        return true;
+    }
+
+    if (cJSON_IsArray(key_item) == false) {
+        nv_log("nv key %s is not an array\n", key);
+        errno = EINVAL;
+        return false;
+    }
+
+    /* elements are written by one array type, the first tells which */
+    const cJSON* element = key_item->child;
+    if (element
+        && (type == NV_DATA_STRING_ARRAY ? cJSON_IsString(element)
+                                         : cJSON_IsNumber(element))
+               == false) {
+        nv_log("nv key %s elements are not of type %d\n", key, type);
+        errno = EINVAL;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * nv_field_decode_<type>, decoders of the schema fields, one per data type so
+ * a struct load calls the conversion of each member without a type switch
+ * @param file  nv file path the blob references are relative to
+ * @param item  object member
+ * @param value data buffer
+ * @param len   data buffer length
+ * @return      boolean
+ */
+#define NV_FIELD_DECODE_NUMBER(type, ctype, member)                       \
+    bool nv_field_decode_##type(const char* file, const cJSON* item,     \
+                                void* value, uint32_t len)               \
+    {                                                                     \
+        UNUSED(file);                                                     \
+        UNUSED(len);                                                      \
+        *(ctype*)value = item->member;                                    \
+        return true;                                                      \
+    }
+
+NV_FIELD_DECODE_NUMBER(NV_DATA_U8, uint8_t, valueint)
+NV_FIELD_DECODE_NUMBER(NV_DATA_S8, int8_t, valueint)
+NV_FIELD_DECODE_NUMBER(NV_DATA_U16, uint16_t, valueint)
+NV_FIELD_DECODE_NUMBER(NV_DATA_S16, int16_t, valueint)
+NV_FIELD_DECODE_NUMBER(NV_DATA_U32, uint32_t, valueint)
+NV_FIELD_DECODE_NUMBER(NV_DATA_S32, int32_t, valueint)
+NV_FIELD_DECODE_NUMBER(NV_DATA_FLOAT, float, valuedouble)
+NV_FIELD_DECODE_NUMBER(NV_DATA_DOUBLE, double, valuedouble)
+
+bool nv_field_decode_NV_DATA_U64(const char* file, const cJSON* item,
+                                 void* value, uint32_t len)
+{
+    UNUSED(file);
+    UNUSED(len);
+
+    if (cJSON_IsRaw(item)) {
+        *(uint64_t*)value = strtoull(item->valuestring, NULL, 10);
+    } else {
+        *(uint64_t*)value = item->valuedouble;
+    }
+    return true;
+}
+
+bool nv_field_decode_NV_DATA_S64(const char* file, const cJSON* item,
+                                 void* value, uint32_t len)
+{
+    UNUSED(file);
+    UNUSED(len);
+
+    if (cJSON_IsRaw(item)) {
+        *(int64_t*)value = strtoll(item->valuestring, NULL, 10);
+    } else {
+        *(int64_t*)value = item->valuedouble;
+    }
+    return true;
+}
+
+bool nv_field_decode_NV_DATA_STR(const char* file, const cJSON* item,
+                                 void* value, uint32_t len)
+{
+    UNUSED(file);
+
+    if (item->valuestring == NULL) {
+        return false;
+    }
+
+    size_t size = strlen(item->valuestring) + 1;
+    if (size > len) {
+        nv_log("nv string %s needs %zu bytes, buffer %u\n", item->string,
+               size, len);
+        return false;
+    }
+    memcpy(value, item->valuestring, size);
+    return true;
+}
+
+/**
+ * nv_json_get, copy member value out of tree
+ * @param file     nv file path the blob references are relative to, NULL
+ *                 if blobs can not be read
+ * @param key_item object member
+ * @param value    data buffer
+ * @param len      data buffer length
+ * @param type     data type
+ * @return         boolean
+ */
+static bool nv_json_get(const char* file, const cJSON* key_item,
+                        char* value, uint32_t len, nv_data_type_t type)
+{
+    switch (type) {
+    case NV_DATA_U8:
+        return nv_field_decode_NV_DATA_U8(file, key_item, value, len);
+    case NV_DATA_S8:
+        return nv_field_decode_NV_DATA_S8(file, key_item, value, len);
+    case NV_DATA_U16:
+        return nv_field_decode_NV_DATA_U16(file, key_item, value, len);
+    case NV_DATA_S16:
+        return nv_field_decode_NV_DATA_S16(file, key_item, value, len);
+    case NV_DATA_U32:
+        return nv_field_decode_NV_DATA_U32(file, key_item, value, len);
+    case NV_DATA_S32:
+        return nv_field_decode_NV_DATA_S32(file, key_item, value, len);
+    case NV_DATA_U64:
+        return nv_field_decode_NV_DATA_U64(file, key_item, value, len);
+    case NV_DATA_S64:
+        return nv_field_decode_NV_DATA_S64(file, key_item, value, len);
+    case NV_DATA_FLOAT:
+        return nv_field_decode_NV_DATA_FLOAT(file, key_item, value, len);
+    case NV_DATA_DOUBLE:
+        return nv_field_decode_NV_DATA_DOUBLE(file, key_item, value, len);
+    case NV_DATA_STR:
+        return nv_field_decode_NV_DATA_STR(file, key_item, value, len);
+    case NV_DATA_STRING_ARRAY:
+    case NV_DATA_INT_ARRAY:
+    case NV_DATA_FLOAT_ARRAY:
+    case NV_DATA_DOUBLE_ARRAY:
+    case NV_DATA_PACKED_INT_ARRAY:
+    case NV_DATA_PACKED_FLOAT_ARRAY:
+    case NV_DATA_PACKED_DOUBLE_ARRAY: {
+        /* either layout reads into the same buffer, whichever was stored */
+        if (cJSON_IsObject(key_item)) {
+            return nv_json_get_packed(key_item, value, len, type);
+        }
+
+        /* at most len elements, nv_get_range reads the others */
+        size_t i = 0;
+        type = nv_json_unpacked(type);
+        for (const cJSON* element = key_item->child; element && i < len;
+             element = element->next) {
+            nv_json_element_get(element, value, i++, type);
+        }
+        break;
+    }
+    case NV_DATA_IP:
+    case NV_DATA_MAC: {
+        int* data = (int*)value;
+        if (key_item->valuestring == NULL) {
+            return false;
+        }
+
+        if (len < (type == NV_DATA_IP ? 4 : 6)) {
+            nv_log("nv address buffer %u too short\n", len);
+            return false;
+        }
+
+        if (type == NV_DATA_IP) {
+            sscanf(key_item->valuestring, "%d.%d.%d.%d", &data[0], &data[1],
+                   &data[2], &data[3]);
+        } else {
+
+            sscanf(key_item->valuestring, "%d-%d-%d-%d-%d-%d", &data[0],
+                   &data[1], &data[2], &data[3], &data[4], &data[5]);
+        }
+        break;
+    }
+    case NV_DATA_BLOB: {
+        nv_blob_ref_t ref;
+        if (file == NULL || nv_blob_parse(key_item, &ref) == false) {
+            return false;
+        }
+
+        return nv_blob_read(file, &ref, value, len);
+    }
+    default:
+        nv_log("unknown %d type\n", type);
+        return false;
+    }
+
+    return true;
+}
+
+/* the array, address and blob decoders share the conversions of nv_get */
+#define NV_FIELD_DECODE(type)                                             \
+    bool nv_field_decode_##type(const char* file, const cJSON* item,     \
+                                void* value, uint32_t len)               \
+    {                                                                     \
+        return nv_json_get(file, item, value, len, type);                 \
+    }
+
+NV_FIELD_DECODE(NV_DATA_STRING_ARRAY)
+NV_FIELD_DECODE(NV_DATA_INT_ARRAY)
+NV_FIELD_DECODE(NV_DATA_FLOAT_ARRAY)
+NV_FIELD_DECODE(NV_DATA_DOUBLE_ARRAY)
+NV_FIELD_DECODE(NV_DATA_IP)
+NV_FIELD_DECODE(NV_DATA_MAC)
+NV_FIELD_DECODE(NV_DATA_PACKED_INT_ARRAY)
+NV_FIELD_DECODE(NV_DATA_PACKED_FLOAT_ARRAY)
+NV_FIELD_DECODE(NV_DATA_PACKED_DOUBLE_ARRAY)
+NV_FIELD_DECODE(NV_DATA_BLOB)
+
+/**
+ * nv_store_find
+ * @param store store handle
+ * @param key   nv key
+ * @return      object member, NULL if not exist
+ */
+static cJSON* nv_store_find(nv_store_t* store, const char* key)
+{
+    /* one-shot path calls look up a single key, hashing every member for it
+     * would cost more than the linear scan it saves */
+    if (store->index.slots == NULL && store->lookups++ > 0
+        && nv_index_build(&store->index, store->json) == false) {
+        nv_log("nv index build fail, use linear search\n");
+    }
+
+    uint64_t start = nv_stats_begin();
+    cJSON* key_item = nv_json_find(store->json, &store->index, key);
+    nv_stats_end(NV_STATS_LOOKUP, start);
+
+    return key_item;
+}
+
+/**
+ * nv_config_init
+ * @param config config to fill with defaults
+ */
+void nv_config_init(nv_config_t* config)
+{
+    memset(config, 0, sizeof(nv_config_t));
+
+    config->wal = CONFIG_NV_WAL;
+    config->wal_compact_size = CONFIG_NV_WAL_COMPACT_SIZE;
+    config->format = CONFIG_NV_FORMAT;
+    config->durability = CONFIG_NV_DURABILITY;
+    config->group_commit_us = CONFIG_NV_GROUP_COMMIT_US;
+    config->thread_safe = CONFIG_NV_THREAD_SAFE;
+    config->shared = CONFIG_NV_SHARED;
+    config->compress = CONFIG_NV_COMPRESS;
+}
+
+/**
+ * nv_version_free
+ * @param version published version, NULL ignored
+ */
+static void nv_version_free(nv_version_t* version)
+{
+    if (version == NULL) {
+        return;
+    }
+
+    nv_keys_t* keys = atomic_load(&version->keys);
+    if (keys) {
+        nv_keys_free(keys);
+        free(keys);
+    }
+
+    cJSON_Delete(version->json);
+    cJSON_Delete(version->garbage);
+    nv_index_free(&version->index);
+    free(version);
+}
+
+/**
+ * nv_json_has_value, member owns a string or children apart from its node
+ * @param item object member
+ * @return     boolean
+ */
+static bool nv_json_has_value(const cJSON* item)
+{
+    return item->type & (cJSON_String | cJSON_Raw | cJSON_Array | cJSON_Object);
+}
+
+/**
+ * nv_json_share, mark the keys and values of every member as referenced,
+ * freeing the tree then frees the member nodes only
+ * @param json  tree
+ * @param share reference or own the keys and values again
+ */
+static void nv_json_share(cJSON* json, bool share)
+{
+    for (cJSON* item = json->child; item; item = item->next) {
+        if (share == false) {
+            item->type &= ~(cJSON_IsReference | cJSON_StringIsConst);
+            continue;
+        }
+
+        item->type |= cJSON_StringIsConst;
+        if (nv_json_has_value(item)) {
+            item->type |= cJSON_IsReference;
+        }
+    }
+}
+
+/**
+ * nv_json_shallow, new tree whose members reference the keys and values of
+ * json
+ * @param json published tree
+ * @return     tree, NULL on failure
+ */
+static cJSON* nv_json_shallow(const cJSON* json)
+{
+    cJSON* copy = cJSON_CreateObject();
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    for (const cJSON* item = json->child; item; item = item->next) {
+        cJSON* member = cJSON_CreateNull();
+        if (member == NULL) {
+            cJSON_Delete(copy);
+            return NULL;
+        }
+
+        member->type = item->type;
+        member->child = item->child;
+        member->valuestring = item->valuestring;
+        member->valueint = item->valueint;
+        member->valuedouble = item->valuedouble;
+        member->string = item->string;
+        cJSON_AddItemToArray(copy, member);
+    }
+
+    return copy;
+}
+
+static bool nv_store_flush_locked(nv_store_t* store);
+static bool nv_store_put(nv_store_t* store, const char* key, void* value,
+                         uint32_t len, nv_data_type_t type);
+
+/**
+ * nv_stat_mtime, modification time of a stat result, seconds only where
+ * the platform has no nanosecond field
+ * @param st stat result
+ * @return   modification time
+ */
+static struct timespec nv_stat_mtime(const struct stat* st)
+{
+#if defined(__APPLE__)
+    return st->st_mtimespec;
+#elif defined(__linux__) \
+    || (defined(_POSIX_VERSION) && _POSIX_VERSION >= 200809L)
+    return st->st_mtim;
+#else
+    struct timespec mtime = { st->st_mtime, 0 };
+    return mtime;
+#endif
+}
+
+/**
+ * nv_stamp_read
+ * @param store store handle
+ * @param stamp stamp of the nv file and its log now
+ */
+static void nv_stamp_read(const nv_store_t* store, nv_stamp_t* stamp)
+{
+    struct stat st;
+
+    memset(stamp, 0, sizeof(nv_stamp_t));
+
+    if (stat(store->file, &st) == 0) {
+        stamp->dev = st.st_dev;
+        stamp->ino = st.st_ino;
+        stamp->size = st.st_size;
+        stamp->mtime = nv_stat_mtime(&st);
+    }
+
+    if (stat(store->wal_file, &st) == 0) {
+        stamp->wal_ino = st.st_ino;
+        stamp->wal_size = st.st_size;
+        stamp->wal_mtime = nv_stat_mtime(&st);
+    }
+}
+
+/**
+ * nv_stamp_equal
+ * @param a stamp
+ * @param b stamp
+ * @return  boolean
+ */
+static bool nv_stamp_equal(const nv_stamp_t* a, const nv_stamp_t* b)
+{
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size
+           && a->mtime.tv_sec == b->mtime.tv_sec
+           && a->mtime.tv_nsec == b->mtime.tv_nsec && a->wal_ino == b->wal_ino
+           && a->wal_size == b->wal_size
+           && a->wal_mtime.tv_sec == b->wal_mtime.tv_sec
+           && a->wal_mtime.tv_nsec == b->wal_mtime.tv_nsec;
+}
+
+/**
+ * nv_stamp_invalidate, make the next check reload from file
+ * @param stamp stamp
+ */
+static void nv_stamp_invalidate(nv_stamp_t* stamp)
+{
+    stamp->size = -1;
+}
+
+/**
+ * nv_store_reclaim, free the superseded versions no reader sees and no
+ * snapshot pins, oldest first, a value shared by versions is freed with the
+ * newest of them
+ * @param store store handle in thread safe mode, writer lock held
+ */
+static void nv_store_reclaim(nv_store_t* store)
+{
+    while (store->retired && store->retired->seq < store->grace
+           && atomic_load(&store->retired->pins) == 0) {
+        nv_version_t* version = store->retired;
+        store->retired = version->next;
+        store->retired_count--;
+        nv_version_free(version);
+    }
+
+    if (store->retired == NULL) {
+        store->retired_tail = NULL;
+    }
+}
+
+/**
+ * nv_store_retire, take over the value of a member of the writable tree
+ * before the write replaces or deletes it, and its key if the write deletes
+ * it, published versions still reference them
+ * @param store store handle, writer lock held
+ * @param item  member of the writable tree
+ * @param drop  the member is deleted
+ * @return      boolean
+ */
+static bool nv_store_retire(nv_store_t* store, cJSON* item, bool drop)
+{
+    bool value = item->type & cJSON_IsReference;
+    bool key = drop && (item->type & cJSON_StringIsConst);
+    if (value == false && key == false) {
+        return true;
+    }
+
+    cJSON* holder = cJSON_CreateNull();
+    if (holder == NULL) {
+        nv_log("nv retire %s fail\n", item->string);
+        return false;
+    }
+
+    if (value) {
+        holder->type = item->type & ~(cJSON_IsReference | cJSON_StringIsConst);
+        holder->child = item->child;
+        holder->valuestring = item->valuestring;
+    }
+
+    if (key) {
+        holder->string = item->string;
+    }
+
+    holder->next = store->dropped;
+    store->dropped = holder;
+    return true;
+}
+
+/**
+ * nv_store_unretire, give the values taken over since until back to the
+ * published versions
+ * @param store store handle, writer lock held
+ * @param until value taken over first that is kept, NULL for all
+ */
+static void nv_store_unretire(nv_store_t* store, cJSON* until)
+{
+    while (store->dropped != until) {
+        cJSON* holder = store->dropped;
+        store->dropped = holder->next;
+        holder->next = NULL;
+        holder->type |= cJSON_IsReference | cJSON_StringIsConst;
+        cJSON_Delete(holder);
+    }
+}
+
+/**
+ * nv_store_publish, make json and index the version readers see
+ * @param store store handle in thread safe mode, writer lock held
+ * @return      boolean
+ */
+static bool nv_store_publish(nv_store_t* store)
+{
+    nv_version_t* version = malloc(sizeof(nv_version_t));
+    if (version == NULL) {
+        nv_log("nv publish %s fail\n", store->file);
+        return false;
+    }
+
+    nv_json_share(store->json, true);
+
+    version->json = store->json;
+    version->index = store->index;
+    version->stamp = store->stamp;
+    atomic_init(&version->keys, NULL);
+    atomic_init(&version->pins, 0);
+    version->garbage = NULL;
+    version->seq = ++store->published;
+    version->next = NULL;
+    memset(&store->index, 0, sizeof(nv_index_t));
+
+    nv_version_t* old = atomic_load(&store->version);
+    atomic_store(&store->version, version);
+
+    /* the values the write dropped go with the last version having them */
+    if (old) {
+        old->garbage = store->dropped;
+        store->dropped = NULL;
+
+        if (store->retired_tail) {
+            store->retired_tail->next = old;
+        } else {
+            store->retired = old;
+        }
+        store->retired_tail = old;
+        store->retired_count++;
+
+        /* freed after a later grace period, see nv_store_collect */
+        nv_store_reclaim(store);
+    }
+
+    return true;
+}
+
+/**
+ * nv_store_publish_init, hand the loaded tree over to the first version
+ * @param store store handle in thread safe mode
+ * @return      boolean
+ */
+static bool nv_store_publish_init(nv_store_t* store)
+{
+    store->rcu = nv_rcu_create();
+    if (store->rcu == NULL) {
+        return false;
+    }
+
+    if (nv_index_build(&store->index, store->json) == false) {
+        nv_rcu_destroy(store->rcu);
+        return false;
+    }
+
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_mutex_init(&store->grace_lock, NULL);
+    atomic_init(&store->version, NULL);
+
+    if (nv_store_publish(store) == false) {
+        pthread_mutex_destroy(&store->grace_lock);
+        pthread_mutex_destroy(&store->lock);
+        nv_index_free(&store->index);
+        nv_rcu_destroy(store->rcu);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * nv_store_lock, serialize writers and flush in thread safe mode
+ * @param store store handle
+ */
+static void nv_store_lock(nv_store_t* store)
+{
+    if (store->config.thread_safe) {
+        pthread_mutex_lock(&store->lock);
+    }
+}
+
+/**
+ * nv_store_collect, wait for the readers of the superseded versions outside
+ * the writer lock once CONFIG_NV_RETIRED_VERSIONS are kept, and free them,
+ * one writer waits while the others go on publishing
+ * @param store store handle in thread safe mode
+ */
+static void nv_store_collect(nv_store_t* store)
+{
+    if (pthread_mutex_trylock(&store->grace_lock) != 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    uint64_t published = store->published;
+    bool full = store->retired_count >= CONFIG_NV_RETIRED_VERSIONS;
+    pthread_mutex_unlock(&store->lock);
+
+    /* the versions before the current one were unpublished before the grace
+     * period started, readers that still see them finish within it */
+    if (full) {
+        nv_rcu_synchronize(store->rcu);
+
+        pthread_mutex_lock(&store->lock);
+        store->grace = published;
+        nv_store_reclaim(store);
+        pthread_mutex_unlock(&store->lock);
+    }
+
+    pthread_mutex_unlock(&store->grace_lock);
+}
+
+/**
+ * nv_store_unlock
+ * @param store store handle
+ */
+static void nv_store_unlock(nv_store_t* store)
+{
+    if (store->config.thread_safe) {
+        pthread_mutex_unlock(&store->lock);
+        nv_store_collect(store);
+    }
+}
+
+/**
+ * nv_patch_free_list
+ * @param patch first patch of the list
+ */
+static void nv_patch_free_list(nv_patch_t* patch)
+{
+    while (patch) {
+        nv_patch_t* next = patch->next;
+        free(patch);
+        patch = next;
+    }
+}
+
+/**
+ * nv_watch_match
+ * @param watch subscription
+ * @param key   changed key
+ * @return      boolean
+ */
+static bool nv_watch_match(const nv_watch_t* watch, const char* key)
+{
+    if (watch->prefix) {
+        return nv_keys_prefix(key, watch->key);
+    }
+
+    return nv_keys_compare(key, watch->key) == 0;
+}
+
+/**
+ * nv_watch_wanted, some subscription matches key
+ * @param store store handle
+ * @param key   nv key
+ * @return      boolean
+ */
+static bool nv_watch_wanted(nv_store_t* store, const char* key)
+{
+    bool ret = false;
+
+    if (atomic_load(&store->watches) == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&store->watch_lock);
+
+    for (nv_watch_t* watch = atomic_load(&store->watches); watch;
+         watch = watch->next) {
+        if (nv_watch_match(watch, key)) {
+            ret = true;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&store->watch_lock);
+
+    return ret;
+}
+
+/**
+ * nv_watch_stage, append a patch for watch to the staged list
+ * @param store store handle, watch lock held
+ * @param watch subscription
+ * @param from  wrapper object of the old members
+ * @param to    wrapper object of the new members
+ */
+static void nv_watch_stage(nv_store_t* store, nv_watch_t* watch, cJSON* from,
+                           cJSON* to)
+{
+    /* the wrappers hold copies, the generator may sort them */
+    cJSON* patches = cJSONUtils_GeneratePatchesCaseSensitive(from, to);
+    char* text = patches ? cJSON_PrintUnformatted(patches) : NULL;
+    cJSON_Delete(patches);
+
+    if (text == NULL) {
+        nv_log("nv watch %s patch fail\n", store->file);
+        return;
+    }
+
+    size_t len = strlen(text) + 1;
+    nv_patch_t* patch = malloc(sizeof(nv_patch_t) + len);
+    if (patch) {
+        patch->next = NULL;
+        patch->watch = watch;
+        patch->cb = watch->cb;
+        patch->arg = watch->arg;
+        memcpy(patch->text, text, len);
+
+        nv_patch_t** tail = &store->staged;
+        while (*tail) {
+            tail = &(*tail)->next;
+        }
+        *tail = patch;
+    }
+
+    cJSON_free(text);
+}
+
+/**
+ * nv_watch_change, stage patches of one member changed by a local write
+ * @param store store handle, writer lock held
+ * @param from  copy of the member before, NULL if added, freed
+ * @param to    member after, NULL if deleted
+ */
+static void nv_watch_change(nv_store_t* store, cJSON* from, const cJSON* to)
+{
+    if (from && to && cJSON_Compare(from, to, true)) {
+        cJSON_Delete(from);
+        return;
+    }
+
+    cJSON* from_wrap = cJSON_CreateObject();
+    cJSON* to_wrap = cJSON_CreateObject();
+    cJSON* to_copy = to ? cJSON_Duplicate(to, true) : NULL;
+
+    if (from_wrap == NULL || to_wrap == NULL || (to && to_copy == NULL)) {
+        nv_log("nv watch %s change fail\n", store->file);
+        cJSON_Delete(from);
+        cJSON_Delete(to_copy);
+        goto out;
+    }
+
+    if (from) {
+        cJSON_AddItemToObject(from_wrap, from->string, from);
+    }
+
+    if (to_copy) {
+        cJSON_AddItemToObject(to_wrap, to->string, to_copy);
+    }
+
+    /* adding renames the member, take the key afterwards */
+    const char* key = to ? to->string : from->string;
+
+    pthread_mutex_lock(&store->watch_lock);
+
+    for (nv_watch_t* watch = atomic_load(&store->watches); watch;
+         watch = watch->next) {
+        if (nv_watch_match(watch, key)) {
+            nv_watch_stage(store, watch, from_wrap, to_wrap);
+        }
+    }
+
+    pthread_mutex_unlock(&store->watch_lock);
+
+out:
+    cJSON_Delete(from_wrap);
+    cJSON_Delete(to_wrap);
+}
+
+/**
+ * nv_watch_diff, stage patches of the watched members a reload changed
+ * @param store store handle, writer lock held
+ * @param from  tree before
+ * @param to    tree after
+ */
+static void nv_watch_diff(nv_store_t* store, const cJSON* from,
+                          const cJSON* to)
+{
+    nv_index_t from_index = { 0 };
+    nv_index_t to_index = { 0 };
+
+    if (atomic_load(&store->watches) == NULL) {
+        return;
+    }
+
+    if (nv_index_build(&from_index, from) == false
+        || nv_index_build(&to_index, to) == false) {
+        nv_log("nv watch %s diff fail\n", store->file);
+        goto out;
+    }
+
+    pthread_mutex_lock(&store->watch_lock);
+
+    for (nv_watch_t* watch = atomic_load(&store->watches); watch;
+         watch = watch->next) {
+        cJSON* from_wrap = cJSON_CreateObject();
+        cJSON* to_wrap = cJSON_CreateObject();
+        if (from_wrap == NULL || to_wrap == NULL) {
+            cJSON_Delete(from_wrap);
+            cJSON_Delete(to_wrap);
+            break;
+        }
+
+        /* shadowed members of a duplicate key are skipped, as for nv_get */
+        for (cJSON* item = from->child; item; item = item->next) {
+            if (item->string == NULL || nv_watch_match(watch, item->string)
+                    == false
+                || nv_index_find(&from_index, item->string) != item) {
+                continue;
+            }
+
+            cJSON* other = nv_index_find(&to_index, item->string);
+            if (other && cJSON_Compare(item, other, true)) {
+                continue;
+            }
+
+            cJSON_AddItemToObject(from_wrap, item->string,
+                                  cJSON_Duplicate(item, true));
+            if (other) {
+                cJSON_AddItemToObject(to_wrap, other->string,
+                                      cJSON_Duplicate(other, true));
+            }
+        }
+
+        for (cJSON* item = to->child; item; item = item->next) {
+            if (item->string && nv_watch_match(watch, item->string)
+                && nv_index_find(&to_index, item->string) == item
+                && nv_index_find(&from_index, item->string) == NULL) {
+                cJSON_AddItemToObject(to_wrap, item->string,
+                                      cJSON_Duplicate(item, true));
+            }
+        }
+
+        if (from_wrap->child || to_wrap->child) {
+            nv_watch_stage(store, watch, from_wrap, to_wrap);
+        }
+
+        cJSON_Delete(from_wrap);
+        cJSON_Delete(to_wrap);
+    }
+
+    pthread_mutex_unlock(&store->watch_lock);
+
+out:
+    nv_index_free(&from_index);
+    nv_index_free(&to_index);
+}
+
+/**
+ * nv_watch_commit, queue the staged patches for delivery or drop them
+ * @param store  store handle, writer lock held
+ * @param commit the write took effect
+ */
+static void nv_watch_commit(nv_store_t* store, bool commit)
+{
+    if (store->staged == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&store->watch_lock);
+
+    nv_patch_t* pending = atomic_load(&store->pending);
+    nv_patch_t** tail = &pending;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+
+    /* a watch cancelled while the write was staged gets nothing */
+    nv_patch_t* patch = store->staged;
+    while (patch) {
+        nv_patch_t* next = patch->next;
+        nv_watch_t* watch = atomic_load(&store->watches);
+        while (watch && watch != patch->watch) {
+            watch = watch->next;
+        }
+
+        if (commit && watch) {
+            patch->next = NULL;
+            *tail = patch;
+            tail = &patch->next;
+        } else {
+            free(patch);
+        }
+        patch = next;
+    }
+    atomic_store(&store->pending, pending);
+
+    store->staged = NULL;
+
+    pthread_mutex_unlock(&store->watch_lock);
+}
+
+/**
+ * nv_watch_deliver, run callbacks of queued patches in order
+ * @param store store handle, no store lock held
+ */
+static void nv_watch_deliver(nv_store_t* store)
+{
+    if (atomic_load(&store->pending) == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&store->watch_lock);
+
+    /* one thread delivers at a time, patches keep the order of changes */
+    if (store->delivering) {
+        pthread_mutex_unlock(&store->watch_lock);
+        return;
+    }
+    store->delivering = true;
+
+    nv_patch_t* patch;
+    while ((patch = atomic_load(&store->pending)) != NULL) {
+        atomic_store(&store->pending, patch->next);
+        pthread_mutex_unlock(&store->watch_lock);
+
+        patch->cb(store, patch->text, patch->arg);
+        free(patch);
+
+        pthread_mutex_lock(&store->watch_lock);
+    }
+
+    store->delivering = false;
+    pthread_mutex_unlock(&store->watch_lock);
+}
+
+/**
+ * nv_watch_free, release subscriptions and undelivered patches on close
+ * @param store store handle
+ */
+static void nv_watch_free(nv_store_t* store)
+{
+    nv_watch_t* watch = atomic_load(&store->watches);
+    while (watch) {
+        nv_watch_t* next = watch->next;
+        free(watch->key);
+        free(watch);
+        watch = next;
+    }
+
+    nv_patch_free_list(store->staged);
+    nv_patch_free_list(atomic_load(&store->pending));
+
+    if (store->watch_fd >= 0) {
+        close(store->watch_fd);
+    }
+
+    pthread_mutex_destroy(&store->watch_lock);
+}
+
+/**
+ * nv_store_refresh_locked, reload the tree if another writer changed the file
+ * local changes that failed to write through are dropped with the old tree
+ * @param store store handle in shared mode, writer lock held
+ * @return      boolean
+ */
+static bool nv_store_refresh_locked(nv_store_t* store)
+{
+    nv_stamp_t stamp;
+
+    /* stamp before load, a change in between only causes one more reload */
+    nv_stamp_read(store, &stamp);
+    if (nv_stamp_equal(&stamp, &store->stamp)) {
+        nv_stats_add(NV_STATS_CACHE_HITS, 1);
+        return true;
+    }
+
+    nv_stats_add(NV_STATS_CACHE_MISSES, 1);
+
+    bool wal_exist = false;
+    nv_format_t format = NV_FORMAT_JSON;
+    cJSON* json = nv_load(store->file, store->wal_file, &wal_exist, &format);
+    if (json == NULL) {
+        json = cJSON_CreateObject();
+        if (json == NULL) {
+            nv_log("cJSON_CreateObject fail\n");
+            return false;
+        }
+    }
+
+    nv_log("nv %s changed, reload\n", store->file);
+
+    nv_watch_diff(store, store->json, json);
+
+    cJSON* old = store->json;
+    nv_stamp_t old_stamp = store->stamp;
+
+    /* nothing of the old tree is shared with the new one */
+    bool retired = true;
+    if (store->config.thread_safe) {
+        for (cJSON* item = old->child; item && retired; item = item->next) {
+            retired = nv_store_retire(store, item, true);
+        }
+    }
+
+    store->json = json;
+    store->stamp = stamp;
+
+    if (store->config.thread_safe) {
+        if (retired == false || nv_index_build(&store->index, json) == false
+            || nv_store_publish(store) == false) {
+            nv_store_unretire(store, NULL);
+            nv_index_free(&store->index);
+            cJSON_Delete(json);
+            store->json = old;
+            store->stamp = old_stamp;
+            nv_watch_commit(store, false);
+            return false;
+        }
+    } else {
+        cJSON_Delete(old);
+        nv_index_free(&store->index);
+        nv_keys_free(&store->keys);
+        store->lookups = 0;
+    }
+
+    store->wal_exist = wal_exist;
+    store->format = format;
+    store->dirty = false;
+    store->wal.len = 0;
+    atomic_store(&store->footprint, nv_json_footprint(json));
+
+    nv_watch_commit(store, true);
+    return true;
+}
+
+/**
+ * nv_store_revalidate, cheap stat check before a read in shared mode
+ * @param store store handle
+ */
+static void nv_store_revalidate(nv_store_t* store)
+{
+    nv_stamp_t stamp;
+
+    nv_stamp_read(store, &stamp);
+
+    if (store->config.thread_safe) {
+        uint32_t token = nv_rcu_read_lock(store->rcu);
+        nv_version_t* version = atomic_load(&store->version);
+        bool current = nv_stamp_equal(&stamp, &version->stamp);
+        nv_rcu_read_unlock(store->rcu, token);
+
+        if (current) {
+            nv_stats_add(NV_STATS_CACHE_HITS, 1);
+            return;
+        }
+    } else if (nv_stamp_equal(&stamp, &store->stamp)) {
+        nv_stats_add(NV_STATS_CACHE_HITS, 1);
+        return;
+    }
+
+    nv_store_lock(store);
+    if (nv_store_refresh_locked(store) == false) {
+        nv_log("nv reload %s fail, keep cached tree\n", store->file);
+    }
+    nv_store_unlock(store);
+}
+
+/**
+ * nv_store_file_lock, take the inter-process write lock and catch up
+ * @param store store handle, writer lock held
+ * @return      boolean
+ */
+static bool nv_store_file_lock(nv_store_t* store)
+{
+    if (store->config.shared == false || store->txn) {
+        return true;
+    }
+
+    if (flock(store->lock_fd, LOCK_EX) != 0) {
+        nv_log("nv flock %s fail, errno %d %s\n", store->file, errno,
+               strerror(errno));
+        return false;
+    }
+
+    if (nv_store_refresh_locked(store) == false) {
+        flock(store->lock_fd, LOCK_UN);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * nv_store_file_unlock
+ * @param store   store handle, writer lock held
+ * @param written file was written under the lock
+ */
+static void nv_store_file_unlock(nv_store_t* store, bool written)
+{
+    if (store->config.shared == false || store->txn) {
+        return;
+    }
+
+    if (written) {
+        nv_stamp_read(store, &store->stamp);
+    } else {
+        nv_stamp_invalidate(&store->stamp);
+    }
+
+    flock(store->lock_fd, LOCK_UN);
+}
+
+/**
+ * nv_store_write_begin, take the writer locks and copy the published tree,
+ * the copy shares the values and only owns the members the write changes
+ * @param store store handle
+ * @return      boolean
+ */
+static bool nv_store_write_begin(nv_store_t* store)
+{
+    nv_store_lock(store);
+
+    if (nv_store_file_lock(store) == false) {
+        nv_store_unlock(store);
+        return false;
+    }
+
+    if (store->config.thread_safe == false) {
+        return true;
+    }
+
+    /* a dropped copy takes the records it queued with it */
+    store->wal_mark = store->wal.len;
+    store->dirty_mark = store->dirty;
+
+    /* an update in place keeps the index of the published version */
+    nv_version_t* version = atomic_load(&store->version);
+    cJSON* json = nv_json_shallow(store->json);
+    if (json == NULL
+        || nv_index_clone(&store->index, &version->index, json) == false) {
+        nv_log("nv copy %s for write fail\n", store->file);
+        cJSON_Delete(json);
+        nv_store_file_unlock(store, false);
+        nv_store_unlock(store);
+        return false;
+    }
+
+    store->json = json;
+    return true;
+}
+
+/**
+ * nv_store_write_end, write through and publish or drop the copy, release
+ * the writer locks
+ * @param store  store handle
+ * @param commit publish the update
+ * @return       boolean, true if published
+ */
+static bool nv_store_write_end(nv_store_t* store, bool commit)
+{
+    bool write_through = store->config.shared && store->txn == false;
+    bool written = false;
+
+    /* other processes only see what is on disk before the lock drops */
+    if (commit && write_through) {
+        commit = nv_store_flush_locked(store);
+        written = commit;
+    }
+
+    nv_store_file_unlock(store, commit);
+
+    if (store->config.thread_safe) {
+        if (commit && nv_store_publish(store) == false) {
+            nv_stamp_invalidate(&store->stamp);
+            commit = false;
+        }
+
+        if (commit == false) {
+            nv_store_unretire(store, NULL);
+            cJSON_Delete(store->json);
+            nv_index_free(&store->index);
+            store->json = atomic_load(&store->version)->json;
+            atomic_store(&store->footprint, nv_json_footprint(store->json));
+
+            /* records already on disk are reloaded along with the file */
+            if (written == false) {
+                store->wal.len = store->wal_mark;
+                store->dirty = store->dirty_mark;
+            }
+        }
+    }
+
+    nv_watch_commit(store, commit);
+    nv_store_unlock(store);
+    return commit;
+}
+
+/**
+ * nv_store_load
+ * @param file   nv file path
+ * @param config store config, NULL for a private single thread store
+ * @param create start with an empty tree if file not exist or invalid
+ * @return       store handle, NULL on failure
+ */
+static nv_store_t* nv_store_load(const char* file, const nv_config_t* config,
+                                 bool create)
+{
+    nv_store_t* store = calloc(1, sizeof(nv_store_t));
+    if (store == NULL) {
+        return NULL;
+    }
+
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    if (config) {
+        store->config = *config;
+    } else {
+        nv_config_init(&store->config);
+        store->config.thread_safe = false;
+    }
+
+    store->lock_fd = -1;
+    store->file = strdup(file);
+    store->wal_file = nv_path_suffix(file, NV_WAL_SUFFIX);
+    if (store->file == NULL || store->wal_file == NULL) {
+        goto fail;
+    }
+
+    /* a reader of a missing file must not leave a lock file behind */
+    if (create == false && access(file, F_OK) != 0
+        && access(store->wal_file, F_OK) != 0) {
+        goto fail;
+    }
+
+    if (store->config.shared) {
+        char* lock_file = nv_path_suffix(file, NV_LOCK_SUFFIX);
+        if (lock_file) {
+            store->lock_fd = open(lock_file, O_RDWR | O_CREAT | O_CLOEXEC,
+                                  0644);
+        }
+
+        if (store->lock_fd < 0) {
+            nv_log("nv open lock %s fail, errno %d %s\n",
+                   lock_file ? lock_file : file, errno, strerror(errno));
+            free(lock_file);
+            goto fail;
+        }
+
+        free(lock_file);
+    }
+
+    /* stamp before load, a change in between only causes one more reload */
+    nv_stamp_read(store, &store->stamp);
+
+    store->json = nv_load(store->file, store->wal_file, &store->wal_exist,
+                          &store->format);
+    if (store->json == NULL) {
+        if (create == false) {
+            goto fail;
+        }
+
+        store->json = cJSON_CreateObject();
+        if (store->json == NULL) {
+            nv_log("cJSON_CreateObject fail\n");
+            goto fail;
+        }
+    }
+
+    atomic_init(&store->footprint, nv_json_footprint(store->json));
+
+    if (store->config.thread_safe && nv_store_publish_init(store) == false) {
+        nv_log("nv %s thread safe init fail\n", file);
+        cJSON_Delete(store->json);
+        goto fail;
+    }
+
+    pthread_mutex_init(&store->watch_lock, NULL);
+    atomic_init(&store->watches, NULL);
+    atomic_init(&store->pending, NULL);
+    store->watch_fd = -1;
+
+    nv_stats_leave(previous);
+    return store;
+
+fail:
+    nv_stats_leave(previous);
+
+    if (store->lock_fd >= 0) {
+        close(store->lock_fd);
+    }
+
+    free(store->wal_file);
+    free(store->file);
+    free(store);
+    return NULL;
+}
+
+/**
+ * nv_open
+ * @param file nv file path
+ * @return     store handle, NULL on failure
+ */
+nv_store_t* nv_open(const char* file)
+{
+    return nv_open_config(file, NULL);
+}
+
+/**
+ * nv_open_config
+ * @param file   nv file path
+ * @param config store config, NULL for defaults
+ * @return       store handle, NULL on failure
+ */
+nv_store_t* nv_open_config(const char* file, const nv_config_t* config)
+{
+    nv_config_t defaults;
+    if (config == NULL) {
+        nv_config_init(&defaults);
+        config = &defaults;
+    }
+
+    nv_store_t* store = nv_store_load(file, config, true);
+    if (store) {
+        nv_log("nv open, file %s wal %d thread safe %d\n", file,
+               store->config.wal, store->config.thread_safe);
+    }
+
+    return store;
+}
+
+/**
+ * nv_wal_drop, unlink a log already folded into the nv file, the entry is
+ * synced away before newer content can be written, a log coming back after
+ * a crash would replay older values over it
+ * @param wal_file log path
+ * @param config   durability
+ * @return         boolean
+ */
+static bool nv_wal_drop(const char* wal_file, const nv_config_t* config)
+{
+    if (unlink(wal_file) != 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+
+        nv_log("nv wal unlink %s fail, errno %d %s\n", wal_file, errno,
+               strerror(errno));
+        return false;
+    }
+
+    return nv_durable_fsync_dir(wal_file, config);
+}
+
+/**
+ * nv_store_stamp_written, a store not shared takes its own write as the file
+ * it loaded, so only other writers make a watch reload it
+ * @param store store handle, writer lock held
+ */
+static void nv_store_stamp_written(nv_store_t* store)
+{
+    if (store->config.shared == false) {
+        nv_stamp_read(store, &store->stamp);
+    }
+}
+
+/**
+ * nv_store_compact_locked, fold the log into the nv file and drop it
+ * @param store store handle, writer lock held
+ * @return      boolean
+ */
+static bool nv_store_compact_locked(nv_store_t* store)
+{
+    nv_format_t format = store->config.format;
+    if (format == NV_FORMAT_AUTO) {
+        format = store->format;
+    }
+
+    if (nv_save(store->file, store->json, format, &store->config) == false) {
+        return false;
+    }
+
+    store->format = format;
+
+    /* pending records are part of the tree just written */
+    store->wal.len = 0;
+
+    /* records are idempotent, a crash before unlink only replays them again */
+    if (store->wal_exist
+        && nv_wal_drop(store->wal_file, &store->config) == false) {
+        return false;
+    }
+
+    store->wal_exist = false;
+    store->wal_lost = false;
+    store->dirty = false;
+    nv_store_stamp_written(store);
+    return true;
+}
+
+/**
+ * nv_store_flush_locked
+ * @param store store handle, writer lock held
+ * @return      boolean
+ */
+static bool nv_store_flush_locked(nv_store_t* store)
+{
+    if (store->dirty == false) {
+        return true;
+    }
+
+    /* a tree change without its record only reaches the file whole */
+    if (store->config.wal == false || store->wal_lost) {
+        return nv_store_compact_locked(store);
+    }
+
+    size_t size = 0;
+    if (nv_wal_append(store->wal_file, &store->wal, &store->config, &size)
+        == false) {
+        return false;
+    }
+
+    store->wal_exist = true;
+    store->dirty = false;
+    nv_store_stamp_written(store);
+
+    if (size >= store->config.wal_compact_size) {
+        nv_log("nv wal %s size %zu, compact\n", store->wal_file, size);
+        return nv_store_compact_locked(store);
+    }
+
+    return true;
+}
+
+/**
+ * nv_json_blob_find, blob reference of a member kept in a sidecar of file
+ * @param file nv file path
+ * @param item tree member
+ * @param ref  blob reference
+ * @return     boolean
+ */
+static bool nv_json_blob_find(const char* file, const cJSON* item,
+                              nv_blob_ref_t* ref)
+{
+    char append[NV_BLOB_NAME_SIZE];
+    const char* slash = strrchr(file, '/');
+    const cJSON* name = cJSON_GetObjectItemCaseSensitive(item, "blob");
+
+    if (item->string == NULL || cJSON_IsString(name) == false) {
+        return false;
+    }
+
+    snprintf(append, sizeof(append), "%s%s", slash ? slash + 1 : file,
+             NV_BLOB_SUFFIX);
+    if (strcmp(name->valuestring, append) != 0
+        && nv_blob_generation(file, name->valuestring) == 0) {
+        return false;
+    }
+
+    return nv_blob_parse(item, ref);
+}
+
+/**
+ * nv_store_blob_compact, copy the live blobs into a sidecar of the next
+ * generation and point the writable tree at it
+ * @param store store handle, inside a write
+ * @param keep  new sidecar name, NV_BLOB_NAME_SIZE bytes, empty if no blob
+ *              is live
+ * @return      boolean
+ */
+static bool nv_store_blob_compact(nv_store_t* store, char* keep)
+{
+    uint32_t generation = 0;
+    size_t count = 0;
+    nv_blob_ref_t ref;
+
+    keep[0] = '\0';
+
+    /* shadowed members of a duplicate key are never read, nor kept */
+    for (cJSON* item = store->json->child; item; item = item->next) {
+        if (nv_json_blob_find(store->file, item, &ref)
+            && nv_store_find(store, item->string) == item) {
+            uint32_t used = nv_blob_generation(store->file, ref.name);
+            generation = used > generation ? used : generation;
+            count++;
+        }
+    }
+
+    if (count == 0) {
+        return true;
+    }
+
+    nv_blob_sidecar_t sidecar;
+    if (nv_blob_sidecar_open(store->file, generation + 1, &sidecar) == false) {
+        return false;
+    }
+
+    /* the reference changes in place, the member and its key stay */
+    bool ret = true;
+    for (cJSON* item = store->json->child; item && ret; item = item->next) {
+        if (nv_json_blob_find(store->file, item, &ref)
+            && nv_store_find(store, item->string) == item) {
+            ret = nv_blob_sidecar_copy(store->file, &sidecar, &ref)
+                  && nv_store_put(store, item->string, &ref, 0,
+                                  NV_DATA_BLOB);
+        }
+    }
+
+    ret = nv_blob_sidecar_close(&sidecar, &store->config) && ret;
+    if (ret) {
+        snprintf(keep, NV_BLOB_NAME_SIZE, "%s", sidecar.name);
+    }
+
+    return ret;
+}
+
+/**
+ * nv_store_compact, fold the log into the nv file and drop it, the live
+ * blobs move to a new sidecar and the old sidecars are unlinked
+ * @param store store handle
+ * @return      boolean
+ */
+bool nv_store_compact(nv_store_t* store)
+{
+    char keep[NV_BLOB_NAME_SIZE];
+
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    bool ret = nv_store_write_begin(store);
+    if (ret) {
+        ret = nv_store_blob_compact(store, keep)
+              && nv_store_compact_locked(store);
+
+        /* the nv file on disk now points at the new sidecar only, the old
+         * ones go while the writer lock still keeps appends out */
+        if (ret) {
+            nv_blob_prune(store->file, keep[0] ? keep : NULL, &store->config);
+        }
+
+        ret = nv_store_write_end(store, ret);
+    }
+
+    nv_watch_deliver(store);
+    nv_stats_leave(previous);
+
+    return ret;
+}
+
+/**
+ * nv_store_flush
+ * @param store store handle
+ * @return      boolean
+ */
+bool nv_store_flush(nv_store_t* store)
+{
+    bool ret = true;
+
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+    nv_store_lock(store);
+
+    /* shared stores write through, only a failed write is left dirty */
+    if (store->dirty) {
+        ret = nv_store_file_lock(store);
+        if (ret) {
+            ret = nv_store_flush_locked(store);
+            nv_store_file_unlock(store, ret);
+        }
+    }
+
+    nv_store_unlock(store);
+    nv_watch_deliver(store);
+    nv_stats_leave(previous);
+
+    return ret;
+}
+
+/**
+ * nv_close
+ * @param store store handle
+ * @return      boolean, false if dirty data flush fail
+ */
+bool nv_close(nv_store_t* store)
+{
+    if (store == NULL) {
+        return false;
+    }
+
+    bool ret = nv_store_flush(store);
+
+    if (store->config.thread_safe) {
+        nv_version_t* version = atomic_load(&store->version);
+        while (store->retired) {
+            nv_version_t* next = store->retired->next;
+            nv_version_free(store->retired);
+            store->retired = next;
+        }
+
+        /* the last version owns every value still referenced */
+        nv_json_share(version->json, false);
+        nv_version_free(version);
+        nv_rcu_destroy(store->rcu);
+        pthread_mutex_destroy(&store->grace_lock);
+        pthread_mutex_destroy(&store->lock);
+    } else {
+        cJSON_Delete(store->json);
+        nv_index_free(&store->index);
+        nv_keys_free(&store->keys);
+    }
+
+    if (store->lock_fd >= 0) {
+        close(store->lock_fd);
+    }
+
+    nv_watch_free(store);
+    nv_wal_free(&store->wal);
+    cJSON_Delete(store->unwritten);
+    free(store->wal_file);
+    free(store->file);
+    free(store);
+
+    return ret;
+}
+
+/**
+ * nv_store_wal_lost, the tree changed but its log record was not queued
+ * @param store store handle
+ * @param key   nv key
+ */
+static void nv_store_wal_lost(nv_store_t* store, const char* key)
+{
+    nv_log("nv wal record %s fail, rewrite on flush\n", key);
+    UNUSED(key);
+
+    store->wal_lost = true;
+}
+
+/**
+ * nv_store_put, update value of the writable tree, a blob value is its
+ * sidecar reference
+ * @param store store handle
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+static bool nv_store_put(nv_store_t* store, const char* key, void* value,
+                         uint32_t len, nv_data_type_t type)
+{
+    cJSON* key_item = nv_store_find(store, key);
+    if (key_item == NULL) {
+        nv_log("nv key %s not exist, add\n", key);
+    }
+
+    size_t footprint = key_item ? nv_json_footprint(key_item) : 0;
+    bool add = key_item == NULL;
+
+    /* the item is updated in place, keep the old value for the patch */
+    cJSON* from = NULL;
+    bool watched = nv_watch_wanted(store, key);
+    if (watched && key_item) {
+        from = cJSON_Duplicate(key_item, true);
+    }
+
+    cJSON* dropped = store->dropped;
+    if (key_item && nv_store_retire(store, key_item, false) == false) {
+        cJSON_Delete(from);
+        return false;
+    }
+
+    key_item = nv_json_set(store->json, &store->index, key_item, key, value,
+                           len, type);
+    if (key_item == NULL) {
+        nv_store_unretire(store, dropped);
+        cJSON_Delete(from);
+        return false;
+    }
+
+    if (watched) {
+        nv_watch_change(store, from, key_item);
+    }
+
+    if (add && nv_keys_insert(&store->keys, key_item) == false) {
+        nv_keys_free(&store->keys);
+    }
+
+    atomic_fetch_add(&store->footprint,
+                     nv_json_footprint(key_item) - footprint);
+
+    if (store->config.wal
+        && nv_wal_record(&store->wal, key, key_item) == false) {
+        nv_store_wal_lost(store, key);
+    }
+
+    store->dirty = true;
+    return true;
+}
+
+/**
+ * nv_store_set, update value of the writable tree
+ * @param store store handle
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+static bool nv_store_set(nv_store_t* store, const char* key, void* value,
+                         uint32_t len, nv_data_type_t type)
+{
+    /* the bytes go to the sidecar first, the tree only keeps a reference */
+    nv_blob_ref_t ref;
+    if (type == NV_DATA_BLOB) {
+        if (nv_blob_write(store->file, value, len, &store->config, &ref)
+            == false) {
+            return false;
+        }
+        value = &ref;
+    }
+
+    return nv_store_put(store, key, value, len, type);
+}
+
+/**
+ * nv_store_remove, delete key of the writable tree
+ * @param store store handle
+ * @param key   nv key
+ * @return      boolean, false if key not exist
+ */
+static bool nv_store_remove(nv_store_t* store, const char* key)
+{
+    cJSON* key_item = nv_store_find(store, key);
+    if (key_item == NULL || nv_store_retire(store, key_item, true) == false) {
+        return false;
+    }
+
+    cJSON_DetachItemViaPointer(store->json, key_item);
+    nv_index_remove(&store->index, key_item);
+    nv_keys_remove(&store->keys, key_item);
+    atomic_fetch_sub(&store->footprint, nv_json_footprint(key_item));
+
+    if (nv_watch_wanted(store, key)) {
+        nv_watch_change(store, key_item, NULL);
+    } else {
+        cJSON_Delete(key_item);
+    }
+
+    if (store->config.wal && nv_wal_record(&store->wal, key, NULL) == false) {
+        nv_store_wal_lost(store, key);
+    }
+
+    store->dirty = true;
+    return true;
+}
+
+/**
+ * nv_store_splice, replace or append array elements of the writable tree
+ * @param store  store handle
+ * @param key    nv key
+ * @param offset first element to replace, NV_RANGE_APPEND for the end
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   array data type
+ * @param length array length after the update, may be NULL
+ * @return       boolean
+ */
+static bool nv_store_splice(nv_store_t* store, const char* key,
+                            uint32_t offset, void* value, uint32_t count,
+                            nv_data_type_t type, uint32_t* length)
+{
+    cJSON* key_item = nv_store_find(store, key);
+    if (nv_json_range_check(key, key_item, type) == false) {
+        return false;
+    }
+
+    if (key_item == NULL) {
+        if (offset != 0 && offset != NV_RANGE_APPEND) {
+            nv_log("nv key %s not exist, offset %u\n", key, offset);
+            return false;
+        }
+
+        if (nv_store_set(store, key, value, count, type) == false) {
+            return false;
+        }
+
+        if (length) {
+            *length = count;
+        }
+        return true;
+    }
+
+    /* published versions share the array, the write changes a copy of it */
+    if (key_item->type & cJSON_IsReference) {
+        cJSON* copy = cJSON_Duplicate(key_item, true);
+        if (copy == NULL || nv_store_retire(store, key_item, false) == false) {
+            nv_log("nv key %s copy fail\n", key);
+            cJSON_Delete(copy);
+            return false;
+        }
+        nv_json_assign(key_item, copy);
+    }
+
+    /* walk to offset once, the elements before it are not touched */
+    uint32_t size = 0;
+    cJSON* element = key_item->child;
+    while (element && size < offset) {
+        element = element->next;
+        size++;
+    }
+
+    if (offset != NV_RANGE_APPEND && size < offset) {
+        nv_log("nv key %s offset %u beyond length %u\n", key, offset, size);
+        return false;
+    }
+    offset = size;
+
+    cJSON* from = NULL;
+    bool watched = nv_watch_wanted(store, key);
+    if (watched) {
+        from = cJSON_Duplicate(key_item, true);
+    }
+
+    cJSON* first = NULL;
+    size_t footprint = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        cJSON* item = nv_json_element_create(value, i, type);
+        if (item == NULL) {
+            nv_log("nv key %s element %u create fail\n", key, offset + i);
+            cJSON_Delete(from);
+            return false;
+        }
+
+        footprint += nv_json_footprint(item);
+        if (element) {
+            cJSON* next = element->next;
+            footprint -= nv_json_footprint(element);
+            cJSON_ReplaceItemViaPointer(key_item, element, item);
+            element = next;
+        } else {
+            cJSON_AddItemToArray(key_item, item);
+        }
+
+        if (first == NULL) {
+            first = item;
+        }
+    }
+
+    atomic_fetch_add(&store->footprint, footprint);
+
+    if (length) {
+        for (size = offset + count; element; element = element->next) {
+            size++;
+        }
+        *length = size;
+    }
+
+    if (watched) {
+        nv_watch_change(store, from, key_item);
+    }
+
+    if (store->config.wal
+        && nv_wal_record_range(&store->wal, key, offset, first, count)
+               == false) {
+        nv_store_wal_lost(store, key);
+    }
+
+    store->dirty = true;
+    return true;
+}
+
+/**
+ * nv_store_sync, update value in memory, flushed by nv_store_flush or nv_close
+ * @param store store handle
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_store_sync(nv_store_t* store, const char* key, void* value,
+                   uint32_t len, nv_data_type_t type)
+{
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    bool ret = nv_store_write_begin(store);
+    if (ret) {
+        ret = nv_store_write_end(store,
+                                 nv_store_set(store, key, value, len, type));
+    }
+
+    nv_watch_deliver(store);
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_store_get
+ * @param store store handle
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_store_get(nv_store_t* store, const char* key, char* value,
+                  uint32_t len, nv_data_type_t type)
+{
+    bool ret = false;
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    if (store->config.shared) {
+        nv_store_revalidate(store);
+        nv_watch_deliver(store);
+    }
+
+    if (store->config.thread_safe) {
+        uint32_t token = nv_rcu_read_lock(store->rcu);
+
+        nv_version_t* version = atomic_load(&store->version);
+        uint64_t start = nv_stats_begin();
+        cJSON* key_item = nv_index_find(&version->index, key);
+        nv_stats_end(NV_STATS_LOOKUP, start);
+        ret = key_item
+              && nv_json_get(store->file, key_item, value, len, type);
+
+        nv_rcu_read_unlock(store->rcu, token);
+    } else {
+        cJSON* key_item = nv_store_find(store, key);
+        ret = key_item
+              && nv_json_get(store->file, key_item, value, len, type);
+    }
+
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_store_delete
+ * @param store store handle
+ * @param key   nv key
+ * @return      boolean, false if key not exist
+ */
+bool nv_store_delete(nv_store_t* store, const char* key)
+{
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    bool ret = nv_store_write_begin(store);
+    if (ret) {
+        ret = nv_store_write_end(store, nv_store_remove(store, key));
+    }
+
+    nv_watch_deliver(store);
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_json_get_range, copy array elements from offset
+ * @param key_item object member
+ * @param offset   first element
+ * @param value    data buffer of the array type
+ * @param count    buffer elements
+ * @param type     array data type
+ * @param length   array length, may be NULL
+ * @return         boolean, false if not an array or offset beyond its end
+ */
+static bool nv_json_get_range(const cJSON* key_item, uint32_t offset,
+                              char* value, uint32_t count,
+                              nv_data_type_t type, uint32_t* length)
+{
+    if (nv_json_range_check(key_item->string, key_item, type) == false) {
+        return false;
+    }
+
+    uint32_t size = 0;
+    const cJSON* element = key_item->child;
+    while (element && size < offset) {
+        element = element->next;
+        size++;
+    }
+
+    if (size < offset) {
+        return false;
+    }
+
+    for (uint32_t i = 0; element && i < count; i++) {
+        nv_json_element_get(element, value, i, type);
+        element = element->next;
+        size++;
+    }
+
+    if (length) {
+        for (; element; element = element->next) {
+            size++;
+        }
+        *length = size;
+    }
+
+    return true;
+}
+
+/**
+ * nv_store_get_range, read array elements from offset
+ * @param store  store handle
+ * @param key    nv key
+ * @param offset first element
+ * @param value  data buffer of the array type
+ * @param count  buffer elements, fewer are read at the end of the array
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length, may be NULL
+ * @return       boolean
+ */
+bool nv_store_get_range(nv_store_t* store, const char* key, uint32_t offset,
+                        void* value, uint32_t count, nv_data_type_t type,
+                        uint32_t* length)
+{
+    bool ret = false;
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    if (store->config.shared) {
+        nv_store_revalidate(store);
+        nv_watch_deliver(store);
+    }
+
+    if (store->config.thread_safe) {
+        uint32_t token = nv_rcu_read_lock(store->rcu);
+
+        nv_version_t* version = atomic_load(&store->version);
+        cJSON* key_item = nv_index_find(&version->index, key);
+        ret = key_item
+              && nv_json_get_range(key_item, offset, value, count, type,
+                                   length);
+
+        nv_rcu_read_unlock(store->rcu, token);
+    } else {
+        cJSON* key_item = nv_store_find(store, key);
+        ret = key_item
+              && nv_json_get_range(key_item, offset, value, count, type,
+                                   length);
+    }
+
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_store_splice_sync, replace or append array elements as one write
+ * @param store  store handle
+ * @param key    nv key
+ * @param offset first element, NV_RANGE_APPEND for the end
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   array data type
+ * @param length array length after the update, may be NULL
+ * @return       boolean
+ */
+static bool nv_store_splice_sync(nv_store_t* store, const char* key,
+                                 uint32_t offset, void* value, uint32_t count,
+                                 nv_data_type_t type, uint32_t* length)
+{
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    bool ret = nv_store_write_begin(store);
+    if (ret) {
+        ret = nv_store_write_end(store,
+                                 nv_store_splice(store, key, offset, value,
+                                                 count, type, length));
+    }
+
+    nv_watch_deliver(store);
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_store_set_range, replace array elements from offset, the elements
+ * past the end are appended, the others are not touched
+ * @param store  store handle
+ * @param key    nv key, created if offset is 0
+ * @param offset first element, at most the array length
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length after the update, may be NULL
+ * @return       boolean
+ */
+bool nv_store_set_range(nv_store_t* store, const char* key, uint32_t offset,
+                        void* value, uint32_t count, nv_data_type_t type,
+                        uint32_t* length)
+{
+    if (offset == NV_RANGE_APPEND) {
+        return false;
+    }
+
+    return nv_store_splice_sync(store, key, offset, value, count, type,
+                                length);
+}
+
+/**
+ * nv_store_append, add elements at the end of an array
+ * @param store  store handle
+ * @param key    nv key, created if not exist
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length after the update, may be NULL
+ * @return       boolean
+ */
+bool nv_store_append(nv_store_t* store, const char* key, void* value,
+                     uint32_t count, nv_data_type_t type, uint32_t* length)
+{
+    return nv_store_splice_sync(store, key, NV_RANGE_APPEND, value, count,
+                                type, length);
+}
+
+/**
+ * nv_store_get_blob, map a NV_DATA_BLOB value read-only without copying it,
+ * the mapping stays valid after later updates and nv_close
+ * @param store store handle
+ * @param key   nv key
+ * @param blob  mapping, release by nv_blob_release
+ * @return      boolean
+ */
+bool nv_store_get_blob(nv_store_t* store, const char* key, nv_blob_t* blob)
+{
+    nv_blob_ref_t ref;
+    bool ret = false;
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    memset(blob, 0, sizeof(nv_blob_t));
+
+    if (store->config.shared) {
+        nv_store_revalidate(store);
+        nv_watch_deliver(store);
+    }
+
+    /* only the reference is read under the lock, the sidecar is append
+     * only so it stays valid once the lock is gone */
+    if (store->config.thread_safe) {
+        uint32_t token = nv_rcu_read_lock(store->rcu);
+
+        nv_version_t* version = atomic_load(&store->version);
+        cJSON* key_item = nv_index_find(&version->index, key);
+        ret = key_item && nv_blob_parse(key_item, &ref);
+
+        nv_rcu_read_unlock(store->rcu, token);
+    } else {
+        cJSON* key_item = nv_store_find(store, key);
+        ret = key_item && nv_blob_parse(key_item, &ref);
+    }
+
+    ret = ret && nv_blob_map(store->file, &ref, blob);
+
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_snapshot, consistent read-only view of the store at this moment
+ * @param store store handle
+ * @return      snapshot, release by nv_snapshot_release before nv_close
+ */
+nv_snapshot_t* nv_snapshot(nv_store_t* store)
+{
+    nv_snapshot_t* snapshot = calloc(1, sizeof(nv_snapshot_t));
+    if (snapshot == NULL) {
+        nv_log("nv snapshot %s fail\n", store->file);
+        return NULL;
+    }
+
+    snapshot->store = store;
+
+    if (store->config.shared) {
+        nv_store_revalidate(store);
+        nv_watch_deliver(store);
+    }
+
+    /* versions are published from the first snapshot on, the owner thread
+     * is the only user of a store not opened thread safe */
+    if (store->config.thread_safe == false) {
+        nv_keys_free(&store->keys);
+        if (nv_store_publish_init(store) == false) {
+            nv_log("nv snapshot %s publish fail\n", store->file);
+            free(snapshot);
+            return NULL;
+        }
+        store->config.thread_safe = true;
+    }
+
+    /* the pin is taken before the read lock drops, so a writer that
+     * superseded the version sees it before reclaiming */
+    uint32_t token = nv_rcu_read_lock(store->rcu);
+
+    snapshot->version = atomic_load(&store->version);
+    atomic_fetch_add(&snapshot->version->pins, 1);
+    snapshot->json = snapshot->version->json;
+
+    nv_rcu_read_unlock(store->rcu, token);
+    return snapshot;
+}
+
+/**
+ * nv_snapshot_get, read a value as it was when the snapshot was taken
+ * @param snapshot snapshot handle
+ * @param key      nv key
+ * @param value    data buffer
+ * @param len      data buffer length
+ * @param type     data type
+ * @return         boolean
+ */
+bool nv_snapshot_get(const nv_snapshot_t* snapshot, const char* key,
+                     char* value, uint32_t len, nv_data_type_t type)
+{
+    cJSON* key_item = nv_index_find(&snapshot->version->index, key);
+
+    return key_item
+           && nv_json_get(snapshot->store->file, key_item, value, len, type);
+}
+
+/**
+ * nv_snapshot_release, drop the view, the versions only it kept are freed
+ * @param snapshot snapshot handle, NULL ignored
+ */
+void nv_snapshot_release(nv_snapshot_t* snapshot)
+{
+    if (snapshot == NULL) {
+        return;
+    }
+
+    nv_store_t* store = snapshot->store;
+    atomic_fetch_sub(&snapshot->version->pins, 1);
+
+    nv_store_lock(store);
+    nv_store_reclaim(store);
+    nv_store_unlock(store);
+
+    free(snapshot);
+}
+
+/**
+ * nv_checkpoint_blobs, tree of a checkpoint with its blobs copied into a
+ * sidecar of its own, references resolve next to the checkpoint file
+ * @param store store handle
+ * @param json  tree of the snapshot, not changed
+ * @param path  checkpoint file path
+ * @param keep  new sidecar name, NV_BLOB_NAME_SIZE bytes, empty if no blob
+ * @return      tree to save, json itself if it holds no blob, NULL on failure
+ */
+static cJSON* nv_checkpoint_blobs(nv_store_t* store, cJSON* json,
+                                  const char* path, char* keep)
+{
+    nv_blob_ref_t ref;
+
+    keep[0] = '\0';
+
+    const cJSON* item = json->child;
+    while (item && nv_json_blob_find(store->file, item, &ref) == false) {
+        item = item->next;
+    }
+
+    if (item == NULL) {
+        return json;
+    }
+
+    /* the members of the copy only borrow the values of the snapshot */
+    cJSON* copy = nv_json_shallow(json);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    for (cJSON* member = copy->child; member; member = member->next) {
+        member->type |= cJSON_IsReference;
+    }
+
+    /* a new generation, the sidecar of a previous checkpoint stays valid
+     * until the new file replaces it */
+    nv_blob_sidecar_t sidecar;
+    if (nv_blob_sidecar_open(path, nv_blob_latest(path) + 1, &sidecar)
+        == false) {
+        cJSON_Delete(copy);
+        return NULL;
+    }
+
+    bool ret = true;
+    for (cJSON* member = copy->child; member && ret; member = member->next) {
+        if (nv_json_blob_find(store->file, member, &ref) == false) {
+            continue;
+        }
+
+        cJSON* blob = NULL;
+        ret = nv_blob_sidecar_copy(store->file, &sidecar, &ref)
+              && (blob = nv_blob_item(&ref)) != NULL;
+        if (ret) {
+            blob->string = member->string;
+            blob->type |= member->type & cJSON_StringIsConst;
+            member->string = NULL;
+            cJSON_ReplaceItemViaPointer(copy, member, blob);
+            member = blob;
+        }
+    }
+
+    ret = nv_blob_sidecar_close(&sidecar, &store->config) && ret;
+    if (ret == false) {
+        cJSON_Delete(copy);
+        return NULL;
+    }
+
+    snprintf(keep, NV_BLOB_NAME_SIZE, "%s", sidecar.name);
+    return copy;
+}
+
+/**
+ * nv_checkpoint, write a snapshot of the store to another file
+ * @param store store handle
+ * @param path  destination nv file path
+ * @return      boolean
+ */
+bool nv_checkpoint(nv_store_t* store, const char* path)
+{
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    nv_snapshot_t* snapshot = nv_snapshot(store);
+    if (snapshot == NULL) {
+        nv_stats_leave(previous);
+        return false;
+    }
+
+    /* compaction may change the format of the file, read it locked */
+    nv_store_lock(store);
+    nv_format_t format = store->config.format;
+    if (format == NV_FORMAT_AUTO) {
+        format = store->format;
+    }
+    nv_store_unlock(store);
+
+    /* encoding and writing only read the pinned version, no lock held */
+    char keep[NV_BLOB_NAME_SIZE];
+    cJSON* json = nv_checkpoint_blobs(store, snapshot->json, path, keep);
+    bool ret = json && nv_save(path, json, format, &store->config);
+
+    /* sidecars of a checkpoint written to path before */
+    if (ret) {
+        nv_blob_prune(path, keep[0] ? keep : NULL, &store->config);
+    }
+
+    if (json != snapshot->json) {
+        cJSON_Delete(json);
+    }
+
+    nv_snapshot_release(snapshot);
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_entry_get, decode the value of one entry
+ * @param key_item key item, NULL if not exist
+ * @param entry    key descriptor, status set
+ * @return         boolean, true if NV_STATUS_OK
+ */
+static bool nv_entry_get(const char* file, const cJSON* key_item,
+                         nv_entry_t* entry)
+{
+    if (key_item == NULL) {
+        entry->status = NV_STATUS_NOT_FOUND;
+    } else if (nv_json_get(file, key_item, entry->value, entry->len,
+                           entry->type)) {
+        entry->status = NV_STATUS_OK;
+    } else {
+        entry->status = NV_STATUS_INVALID;
+    }
+
+    return entry->status == NV_STATUS_OK;
+}
+
+/**
+ * nv_store_get_many, read many keys from one version of the tree
+ * @param store   store handle
+ * @param entries key descriptors, status set per entry
+ * @param count   number of entries
+ * @return        boolean, true if every entry is NV_STATUS_OK
+ */
+bool nv_store_get_many(nv_store_t* store, nv_entry_t* entries, size_t count)
+{
+    bool ret = true;
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    if (store->config.shared) {
+        nv_store_revalidate(store);
+        nv_watch_deliver(store);
+    }
+
+    if (store->config.thread_safe) {
+        uint32_t token = nv_rcu_read_lock(store->rcu);
+
+        nv_version_t* version = atomic_load(&store->version);
+        for (size_t i = 0; i < count; i++) {
+            uint64_t start = nv_stats_begin();
+            cJSON* key_item = nv_index_find(&version->index, entries[i].key);
+            nv_stats_end(NV_STATS_LOOKUP, start);
+            ret &= nv_entry_get(store->file, key_item, &entries[i]);
+        }
+
+        nv_rcu_read_unlock(store->rcu, token);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            cJSON* key_item = nv_store_find(store, entries[i].key);
+            ret &= nv_entry_get(store->file, key_item, &entries[i]);
+        }
+    }
+
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_store_sync_many, update many keys as one write
+ * @param store   store handle
+ * @param entries key descriptors, status set per entry
+ * @param count   number of entries
+ * @return        boolean, true if every entry is NV_STATUS_OK
+ */
+bool nv_store_sync_many(nv_store_t* store, nv_entry_t* entries, size_t count)
+{
+    bool ret = true;
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    for (size_t i = 0; i < count; i++) {
+        entries[i].status = NV_STATUS_FAIL;
+    }
+
+    if (nv_store_write_begin(store)) {
+        /* the entries that were set are published, the failed ones not */
+        bool commit = false;
+        for (size_t i = 0; i < count; i++) {
+            if (nv_store_set(store, entries[i].key, entries[i].value,
+                             entries[i].len, entries[i].type)) {
+                entries[i].status = NV_STATUS_OK;
+                commit = true;
+            }
+        }
+
+        if (nv_store_write_end(store, commit) == false) {
+            for (size_t i = 0; i < count; i++) {
+                entries[i].status = NV_STATUS_FAIL;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ret &= entries[i].status == NV_STATUS_OK;
+    }
+
+    nv_watch_deliver(store);
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_version_keys, ordered keys of a published version, built once
+ * @param version published version, read lock held
+ * @return        ordered keys, NULL on failure
+ */
+static const nv_keys_t* nv_version_keys(nv_version_t* version)
+{
+    nv_keys_t* keys = atomic_load(&version->keys);
+    if (keys) {
+        return keys;
+    }
+
+    keys = calloc(1, sizeof(nv_keys_t));
+    if (keys == NULL || nv_keys_build(keys, version->json) == false) {
+        free(keys);
+        return NULL;
+    }
+
+    /* concurrent readers may build it too, the first one is kept */
+    nv_keys_t* expected = NULL;
+    if (atomic_compare_exchange_strong(&version->keys, &expected, keys)
+        == false) {
+        nv_keys_free(keys);
+        free(keys);
+        return expected;
+    }
+
+    return keys;
+}
+
+/**
+ * nv_keys_visit, visit the prefix range of ordered keys from the cursor on
+ * @param file   nv file path, for blob values
+ * @param keys   ordered keys
+ * @param prefix key prefix
+ * @param cursor resume point, NULL for none
+ * @param visit  callback
+ * @param arg    callback argument
+ * @return       boolean
+ */
+static bool nv_keys_visit(const char* file, const nv_keys_t* keys,
+                          const char* prefix, nv_cursor_t* cursor,
+                          nv_visit_cb_t visit, void* arg)
+{
+    size_t i = nv_keys_lower_bound(keys, prefix);
+    if (cursor && cursor->key) {
+        size_t next = nv_keys_upper_bound(keys, cursor->key);
+        i = next > i ? next : i;
+    }
+
+    const char* last = NULL;
+    for (; i < keys->count; i++) {
+        const cJSON* item = keys->items[i];
+        if (nv_keys_prefix(item->string, prefix) == false) {
+            break;
+        }
+
+        /* a later member with the same key is shadowed, as for nv_get */
+        if (last && nv_keys_compare(last, item->string) == 0) {
+            continue;
+        }
+        last = item->string;
+
+        const nv_item_t visited = { .file = file, .json = item };
+        if (visit(item->string, &visited, arg) == false) {
+            if (cursor == NULL) {
+                return true;
+            }
+
+            char* key = strdup(item->string);
+            if (key == NULL) {
+                return false;
+            }
+
+            free(cursor->key);
+            cursor->key = key;
+            return true;
+        }
+    }
+
+    if (cursor) {
+        cursor->done = true;
+    }
+
+    return true;
+}
+
+/**
+ * nv_scan_prefix, visit the keys starting with prefix in key order
+ * @param store  store handle
+ * @param prefix key prefix
+ * @param cursor resume point, zero initialized to start, NULL for none
+ * @param visit  callback
+ * @param arg    callback argument
+ * @return       boolean, false on failure
+ */
+bool nv_scan_prefix(nv_store_t* store, const char* prefix,
+                    nv_cursor_t* cursor, nv_visit_cb_t visit, void* arg)
+{
+    bool ret = false;
+
+    if (cursor && cursor->done) {
+        return true;
+    }
+
+    if (store->config.shared) {
+        nv_store_revalidate(store);
+        nv_watch_deliver(store);
+    }
+
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    if (store->config.thread_safe) {
+        uint32_t token = nv_rcu_read_lock(store->rcu);
+
+        const nv_keys_t* keys = nv_version_keys(atomic_load(&store->version));
+        ret = keys
+              && nv_keys_visit(store->file, keys, prefix, cursor, visit,
+                               arg);
+
+        nv_rcu_read_unlock(store->rcu, token);
+    } else if (store->keys.items
+               || nv_keys_build(&store->keys, store->json)) {
+        ret = nv_keys_visit(store->file, &store->keys, prefix, cursor, visit,
+                            arg);
+    }
+
+    nv_stats_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_foreach, visit every key in case-insensitive key order
+ * @param store  store handle
+ * @param cursor resume point, zero initialized to start, NULL for none
+ * @param visit  callback
+ * @param arg    callback argument
+ * @return       boolean, false on failure
+ */
+bool nv_foreach(nv_store_t* store, nv_cursor_t* cursor, nv_visit_cb_t visit,
+                void* arg)
+{
+    return nv_scan_prefix(store, "", cursor, visit, arg);
+}
+
+/**
+ * nv_cursor_free, release the resume point and start over
+ * @param cursor cursor
+ */
+void nv_cursor_free(nv_cursor_t* cursor)
+{
+    free(cursor->key);
+    memset(cursor, 0, sizeof(nv_cursor_t));
+}
+
+/**
+ * nv_item_get, read the value of a visited key
+ * @param item  value passed to nv_visit_cb_t
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_item_get(const nv_item_t* item, char* value, uint32_t len,
+                 nv_data_type_t type)
+{
+    return nv_json_get(item->file, item->json, value, len, type);
+}
+
+/**
+ * nv_watch, subscribe to changes of a key
+ * @param store store handle
+ * @param key   nv key, "prefix*" for a prefix, "*" for every key
+ * @param cb    callback
+ * @param arg   callback argument
+ * @return      watch handle, NULL on failure
+ */
+nv_watch_t* nv_watch(nv_store_t* store, const char* key, nv_watch_cb_t cb,
+                     void* arg)
+{
+    if (store == NULL || key == NULL || cb == NULL) {
+        return NULL;
+    }
+
+    nv_watch_t* watch = calloc(1, sizeof(nv_watch_t));
+    if (watch == NULL) {
+        return NULL;
+    }
+
+    size_t len = strlen(key);
+    watch->prefix = len && key[len - 1] == '*';
+    watch->key = strndup(key, watch->prefix ? len - 1 : len);
+    watch->cb = cb;
+    watch->arg = arg;
+    if (watch->key == NULL) {
+        free(watch);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&store->watch_lock);
+    watch->next = atomic_load(&store->watches);
+    atomic_store(&store->watches, watch);
+    pthread_mutex_unlock(&store->watch_lock);
+
+    return watch;
+}
+
+/**
+ * nv_unwatch, cancel a subscription, undelivered patches of it are dropped
+ * @param store store handle
+ * @param watch watch handle
+ */
+void nv_unwatch(nv_store_t* store, nv_watch_t* watch)
+{
+    if (store == NULL || watch == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&store->watch_lock);
+
+    nv_watch_t* head = atomic_load(&store->watches);
+    for (nv_watch_t** link = &head; *link; link = &(*link)->next) {
+        if (*link == watch) {
+            *link = watch->next;
+            break;
+        }
+    }
+    atomic_store(&store->watches, head);
+
+    /* staged patches belong to a writer holding the store lock, they are
+     * dropped when queued as the watch is no longer listed */
+    nv_patch_t* pending = atomic_load(&store->pending);
+    for (nv_patch_t** link = &pending; *link;) {
+        nv_patch_t* patch = *link;
+        if (patch->watch == watch) {
+            *link = patch->next;
+            free(patch);
+        } else {
+            link = &patch->next;
+        }
+    }
+    atomic_store(&store->pending, pending);
+
+    pthread_mutex_unlock(&store->watch_lock);
+
+    free(watch->key);
+    free(watch);
+}
+
+/**
+ * nv_watch_fd, descriptor readable when the nv file changed on disk
+ * @param store store handle
+ * @return      file descriptor, -1 if not supported
+ */
+int nv_watch_fd(nv_store_t* store)
+{
+#ifdef __linux__
+    pthread_mutex_lock(&store->watch_lock);
+
+    if (store->watch_fd < 0) {
+        /* the file is replaced by rename, watch its directory */
+        char* dir = strdup(store->file);
+        char* slash = dir ? strrchr(dir, '/') : NULL;
+        const char* path = slash ? dir : ".";
+        if (slash) {
+            slash[slash == dir ? 1 : 0] = '\0';
+        }
+
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && dir
+            && inotify_add_watch(fd, path,
+                                 IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE
+                                     | IN_DELETE | IN_MODIFY)
+                   >= 0) {
+            store->watch_fd = fd;
+        } else {
+            nv_log("nv watch %s inotify fail, errno %d %s\n", store->file,
+                   errno, strerror(errno));
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        free(dir);
+    }
+
+    int fd = store->watch_fd;
+    pthread_mutex_unlock(&store->watch_lock);
+
+    return fd;
+#else
+    (void)store;
+    return -1;
+#endif
+}
+
+/**
+ * nv_watch_dispatch, consume file change events, reload a store another
+ * writer changed and deliver the patches of the watched keys
+ * @param store store handle
+ * @return      boolean, false on failure
+ */
+bool nv_watch_dispatch(nv_store_t* store)
+{
+    if (store->watch_fd >= 0) {
+        char events[4096];
+        while (read(store->watch_fd, events, sizeof(events)) > 0) {
+        }
+    }
+
+    if (store->config.shared) {
+        nv_store_revalidate(store);
+    } else if (atomic_load(&store->watches)) {
+        /* updates not written yet would go with the old tree, the next
+         * flush of this store replaces the file anyway */
+        nv_store_lock(store);
+        if (store->dirty == false
+            && nv_store_refresh_locked(store) == false) {
+            nv_log("nv reload %s fail, keep cached tree\n", store->file);
+        }
+        nv_store_unlock(store);
+    }
+
+    nv_watch_deliver(store);
+    return true;
+}
+
+/**
+ * nv_scope_enter, allocate transient trees of one call from an arena
+ * @param arena arena, NULL for the per-thread arena, reset when its
+ *              outermost scope leaves
+ * @return      previous arena for nv_scope_leave
+ */
+static nv_arena_t* nv_scope_enter(nv_arena_t* arena)
+{
+    return CONFIG_NV_ARENA ? nv_arena_enter(arena) : NULL;
+}
+
+/**
+ * nv_scope_leave
+ * @param previous return value of nv_scope_enter
+ */
+static void nv_scope_leave(nv_arena_t* previous)
+{
+    if (CONFIG_NV_ARENA) {
+        nv_arena_leave(previous);
+    }
+}
+
+/**
+ * nv_txn_begin, read and parse nv file once for a batch of updates
+ * @param file nv file path
+ * @return     transaction handle, NULL on failure
+ */
+nv_txn_t* nv_txn_begin(const char* file)
+{
+    nv_txn_t* txn = calloc(1, sizeof(nv_txn_t));
+    if (txn == NULL) {
+        return NULL;
+    }
+
+    nv_arena_t* previous = nv_scope_enter(&txn->arena);
+
+    txn->store = nv_store_load(file, NULL, true);
+
+    /* shared mode holds the file lock from here until commit or abort */
+    if (txn->store && txn->store->config.shared) {
+        if (nv_store_file_lock(txn->store)) {
+            txn->store->txn = true;
+        } else {
+            nv_close(txn->store);
+            txn->store = NULL;
+        }
+    }
+
+    nv_scope_leave(previous);
+
+    if (txn->store == NULL) {
+        nv_arena_free(&txn->arena);
+        free(txn);
+        return NULL;
+    }
+
+    return txn;
+}
+
+/**
+ * nv_txn_sync, update value in the transaction
+ * @param txn   transaction handle
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_txn_sync(nv_txn_t* txn, const char* key, void* value, uint32_t len,
+                 nv_data_type_t type)
+{
+    nv_arena_t* previous = nv_scope_enter(&txn->arena);
+    bool ret = nv_store_sync(txn->store, key, value, len, type);
+    nv_scope_leave(previous);
+
+    return ret;
+}
+
+/**
+ * nv_txn_delete, delete key in the transaction
+ * @param txn transaction handle
+ * @param key nv key
+ * @return    boolean, false if key not exist
+ */
+bool nv_txn_delete(nv_txn_t* txn, const char* key)
+{
+    nv_arena_t* previous = nv_scope_enter(&txn->arena);
+    bool ret = nv_store_delete(txn->store, key);
+    nv_scope_leave(previous);
+
+    return ret;
+}
+
+/**
+ * nv_txn_commit, write the whole batch to file once and release it
+ * @param txn transaction handle
+ * @return    boolean, on failure the transaction stays open for another
+ *            commit or nv_txn_abort
+ */
+bool nv_txn_commit(nv_txn_t* txn)
+{
+    if (txn == NULL) {
+        return false;
+    }
+
+    nv_arena_t* previous = nv_scope_enter(&txn->arena);
+
+    /* the batch is kept on failure, the caller retries or aborts */
+    if (nv_store_flush(txn->store) == false) {
+        nv_log("nv txn commit %s fail\n", txn->store->file);
+        nv_scope_leave(previous);
+        return false;
+    }
+
+    nv_close(txn->store);
+
+    nv_scope_leave(previous);
+    nv_arena_free(&txn->arena);
+    free(txn);
+
+    return true;
+}
+
+/**
+ * nv_txn_abort, discard the batch and release it
+ * @param txn transaction handle
+ */
+void nv_txn_abort(nv_txn_t* txn)
+{
+    if (txn == NULL) {
+        return;
+    }
+
+    nv_arena_t* previous = nv_scope_enter(&txn->arena);
+
+    txn->store->dirty = false;
+    nv_close(txn->store);
+
+    nv_scope_leave(previous);
+    nv_arena_free(&txn->arena);
+    free(txn);
+}
+
+/**
+ * nv_registry_create
+ * @param config store config of every opened store, NULL for defaults
+ * @param budget estimated tree bytes kept open
+ * @return       registry handle, NULL on failure
+ */
+nv_registry_t* nv_registry_create(const nv_config_t* config, size_t budget)
+{
+    nv_registry_t* registry = calloc(1, sizeof(nv_registry_t));
+    if (registry == NULL) {
+        return NULL;
+    }
+
+    if (config) {
+        registry->config = *config;
+    } else {
+        nv_config_init(&registry->config);
+    }
+
+    registry->budget = budget;
+    pthread_mutex_init(&registry->lock, NULL);
+    pthread_cond_init(&registry->cond, NULL);
+
+    return registry;
+}
+
+/**
+ * nv_registry_unlink
+ * @param registry registry handle, lock held
+ * @param entry    linked entry
+ */
+static void nv_registry_unlink(nv_registry_t* registry,
+                               nv_registry_entry_t* entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        registry->head = entry->next;
+    }
+
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        registry->tail = entry->prev;
+    }
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/**
+ * nv_registry_push, link entry as most recently used
+ * @param registry registry handle, lock held
+ * @param entry    unlinked entry
+ */
+static void nv_registry_push(nv_registry_t* registry,
+                             nv_registry_entry_t* entry)
+{
+    entry->next = registry->head;
+    if (registry->head) {
+        registry->head->prev = entry;
+    } else {
+        registry->tail = entry;
+    }
+
+    registry->head = entry;
+}
+
+/**
+ * nv_registry_trim, close least recently used idle stores beyond budget
+ * @param registry registry handle, lock held, released while flushing
+ */
+static void nv_registry_trim(nv_registry_t* registry)
+{
+    bool requested = false;
+
+    for (;;) {
+        size_t total = 0;
+
+        for (nv_registry_entry_t* entry = registry->head; entry;
+             entry = entry->next) {
+            if (entry->store) {
+                total += atomic_load(&entry->store->footprint);
+            }
+        }
+
+        if (total <= registry->budget) {
+            break;
+        }
+
+        /* dirty stores of the flusher are left to its thread, so
+         * nv_sync_async never waits for the disk */
+        nv_registry_entry_t* entry = registry->tail;
+        while (entry
+               && (entry->refs || entry->store == NULL
+                   || (registry->deferred && entry->store->dirty))) {
+            if (entry->refs == 0 && entry->store && requested == false) {
+                nv_flush();
+                requested = true;
+            }
+
+            entry = entry->prev;
+        }
+
+        if (entry == NULL) {
+            break;
+        }
+
+        nv_store_t* store = entry->store;
+
+        if (store->dirty) {
+            /* the reference keeps the entry linked, a reopen of the path
+             * gets this store instead of parsing the file before the dirty
+             * data reached it */
+            entry->refs++;
+            pthread_mutex_unlock(&registry->lock);
+
+            bool ret = nv_store_flush(store);
+
+            pthread_mutex_lock(&registry->lock);
+            entry->refs--;
+
+            if (ret == false) {
+                nv_log("nv registry flush %s fail, kept open\n", store->file);
+                break;
+            }
+
+            /* opened or updated again while flushed, look again */
+            continue;
+        }
+
+        nv_log("nv registry evict %s\n", store->file);
+
+        nv_registry_unlink(registry, entry);
+        pthread_mutex_unlock(&registry->lock);
+
+        nv_close(store);
+        free(entry->file);
+        free(entry);
+
+        pthread_mutex_lock(&registry->lock);
+    }
+}
+
+/**
+ * nv_registry_acquire, take a reference on the store of the path
+ * @param registry registry handle
+ * @param file     nv file path
+ * @param open     open the store if not in the registry
+ * @param create   start with an empty tree if the file not exist
+ * @return         store handle, NULL if not open or on failure
+ */
+static nv_store_t* nv_registry_acquire(nv_registry_t* registry,
+                                       const char* file, bool open,
+                                       bool create)
+{
+    nv_registry_entry_t* entry = NULL;
+
+    pthread_mutex_lock(&registry->lock);
+
+    for (entry = registry->head; entry;) {
+        if (strcmp(entry->file, file) != 0) {
+            entry = entry->next;
+        } else if (entry->store == NULL) {
+            /* another opener parses the file, the list may change */
+            pthread_cond_wait(&registry->cond, &registry->lock);
+            entry = registry->head;
+        } else {
+            break;
+        }
+    }
+
+    if (entry) {
+        nv_registry_unlink(registry, entry);
+        nv_registry_push(registry, entry);
+        entry->refs++;
+    } else if (open == false) {
+        pthread_mutex_unlock(&registry->lock);
+        return NULL;
+    } else {
+        entry = calloc(1, sizeof(nv_registry_entry_t));
+        if (entry) {
+            entry->file = strdup(file);
+        }
+
+        if (entry == NULL || entry->file == NULL) {
+            nv_log("nv registry open %s fail\n", file);
+            pthread_mutex_unlock(&registry->lock);
+            free(entry);
+            return NULL;
+        }
+
+        /* the file is parsed outside the lock, the placeholder holds back
+         * other openers of the path only */
+        entry->refs = 1;
+        nv_registry_push(registry, entry);
+        pthread_mutex_unlock(&registry->lock);
+
+        nv_store_t* store = nv_store_load(file, &registry->config, create);
+
+        pthread_mutex_lock(&registry->lock);
+        pthread_cond_broadcast(&registry->cond);
+
+        if (store == NULL) {
+            nv_log("nv registry open %s fail\n", file);
+            nv_registry_unlink(registry, entry);
+            pthread_mutex_unlock(&registry->lock);
+            free(entry->file);
+            free(entry);
+            return NULL;
+        }
+
+        entry->store = store;
+        store->entry = entry;
+    }
+
+    nv_registry_trim(registry);
+
+    pthread_mutex_unlock(&registry->lock);
+
+    return entry->store;
+}
+
+/**
+ * nv_registry_open, store of the path, parsed on first use
+ * @param registry registry handle
+ * @param file     nv file path
+ * @return         store handle, NULL on failure
+ */
+nv_store_t* nv_registry_open(nv_registry_t* registry, const char* file)
+{
+    return nv_registry_acquire(registry, file, true, true);
+}
+
+/**
+ * nv_registry_close, drop a reference taken by nv_registry_open
+ * @param registry registry handle
+ * @param store    store handle
+ */
+void nv_registry_close(nv_registry_t* registry, nv_store_t* store)
+{
+    pthread_mutex_lock(&registry->lock);
+
+    store->entry->refs--;
+
+    /* the store may have grown while it was used */
+    nv_registry_trim(registry);
+
+    pthread_mutex_unlock(&registry->lock);
+}
+
+/**
+ * nv_registry_flush, flush every dirty store
+ * @param registry registry handle
+ * @return         boolean, false if any flush fail
+ */
+bool nv_registry_flush(nv_registry_t* registry)
+{
+    size_t count = 0;
+    bool ret = true;
+
+    /* referenced stores are not evicted while flushed outside the lock, so
+     * opening other files never waits for the disk */
+    pthread_mutex_lock(&registry->lock);
+
+    for (nv_registry_entry_t* entry = registry->head; entry;
+         entry = entry->next) {
+        count++;
+    }
+
+    if (count == 0) {
+        pthread_mutex_unlock(&registry->lock);
+        return true;
+    }
+
+    nv_store_t** stores = malloc(count * sizeof(nv_store_t*));
+    if (stores == NULL) {
+        pthread_mutex_unlock(&registry->lock);
+        return false;
+    }
+
+    count = 0;
+    for (nv_registry_entry_t* entry = registry->head; entry;
+         entry = entry->next) {
+        if (entry->store && entry->store->dirty) {
+            entry->refs++;
+            stores[count++] = entry->store;
+        }
+    }
+
+    pthread_mutex_unlock(&registry->lock);
+
+    for (size_t i = 0; i < count; i++) {
+        if (nv_store_flush(stores[i]) == false) {
+            ret = false;
+        }
+
+        nv_registry_close(registry, stores[i]);
+    }
+
+    free(stores);
+    return ret;
+}
+
+/**
+ * nv_registry_destroy, flush and close every store
+ * @param registry registry handle
+ * @return         boolean, false if any flush fail
+ */
+bool nv_registry_destroy(nv_registry_t* registry)
+{
+    bool ret = true;
+
+    if (registry == NULL) {
+        return false;
+    }
+
+    nv_registry_entry_t* entry = registry->head;
+    while (entry) {
+        nv_registry_entry_t* next = entry->next;
+
+        if (entry->refs) {
+            nv_log("nv registry %s still open\n", entry->store->file);
+        }
+
+        if (nv_close(entry->store) == false) {
+            ret = false;
+        }
+        free(entry->file);
+        free(entry);
+
+        entry = next;
+    }
+
+    pthread_cond_destroy(&registry->cond);
+    pthread_mutex_destroy(&registry->lock);
+    free(registry);
+
+    return ret;
+}
+
+static void nv_path_init(void)
+{
+    nv_config_t config;
+    nv_config_init(&config);
+
+    /* other handles and processes may write the file between two calls */
+    config.thread_safe = true;
+    config.shared = true;
+
+    nv_path_registry = nv_registry_create(&config, CONFIG_NV_REGISTRY_BUDGET);
+}
+
+/**
+ * nv_path_open, process registry store of the path for the path API
+ * @param file   nv file path
+ * @param create start with an empty tree if the file not exist, readers
+ *               pass false so a missing file is neither created nor cached
+ * @return       store handle, release by nv_path_close, NULL on failure
+ */
+static nv_store_t* nv_path_open(const char* file, bool create)
+{
+    pthread_once(&nv_path_once, nv_path_init);
+
+    return nv_path_registry
+               ? nv_registry_acquire(nv_path_registry, file, true, create)
+               : NULL;
+}
+
+static void nv_path_close(nv_store_t* store)
+{
+    nv_registry_close(nv_path_registry, store);
+}
+
+/**
+ * nv_flusher_mark, record a key updated in a flusher store
+ * @param store store of the flusher registry, data lock held
+ * @param key   nv key
+ */
+static void nv_flusher_mark(nv_store_t* store, const char* key)
+{
+    if (store->unwritten == NULL) {
+        store->unwritten = cJSON_CreateObject();
+    }
+
+    if (store->unwritten
+        && (cJSON_GetObjectItemCaseSensitive(store->unwritten, key)
+            || cJSON_AddNullToObject(store->unwritten, key))) {
+        return;
+    }
+
+    nv_log("nv record %s of %s fail, write the cached tree\n", key,
+           store->file);
+    store->unwritten_lost = true;
+}
+
+/**
+ * nv_flusher_refresh, reload a flusher store another writer changed and
+ * apply the updates not written yet on top
+ * @param store store of the flusher registry, data lock held
+ * @return      boolean
+ */
+static bool nv_flusher_refresh(nv_store_t* store)
+{
+    nv_stamp_t stamp;
+
+    nv_stamp_read(store, &stamp);
+    if (nv_stamp_equal(&stamp, &store->stamp) || store->unwritten_lost) {
+        return true;
+    }
+
+    bool wal_exist = false;
+    nv_format_t format = NV_FORMAT_JSON;
+    cJSON* json = nv_load(store->file, store->wal_file, &wal_exist, &format);
+    if (json == NULL) {
+        json = cJSON_CreateObject();
+        if (json == NULL) {
+            nv_log("cJSON_CreateObject fail\n");
+            return false;
+        }
+    }
+
+    nv_log("nv %s changed, reload\n", store->file);
+
+    for (cJSON* key = store->unwritten ? store->unwritten->child : NULL; key;
+         key = key->next) {
+        cJSON* item = cJSON_GetObjectItemCaseSensitive(store->json,
+                                                       key->string);
+
+        /* a deleted key stays deleted */
+        cJSON_DeleteItemFromObjectCaseSensitive(json, key->string);
+        if (item == NULL) {
+            continue;
+        }
+
+        /* copied, the cached tree stays whole if the merge fails */
+        item = cJSON_Duplicate(item, true);
+        if (item == NULL
+            || cJSON_AddItemToObject(json, key->string, item) == false) {
+            nv_log("nv keep %s of %s fail\n", key->string, store->file);
+            cJSON_Delete(item);
+            cJSON_Delete(json);
+            return false;
+        }
+    }
+
+    cJSON_Delete(store->json);
+    nv_index_free(&store->index);
+    nv_keys_free(&store->keys);
+
+    store->json = json;
+    store->lookups = 0;
+    store->stamp = stamp;
+    store->wal_exist = wal_exist;
+    store->format = format;
+    atomic_store(&store->footprint, nv_json_footprint(json));
+    return true;
+}
+
+/**
+ * nv_flusher_write, encode a dirty store under the data lock, write it outside
+ * @param store store of the flusher registry, referenced
+ * @return      boolean
+ */
+static bool nv_flusher_write(nv_store_t* store)
+{
+    pthread_mutex_lock(&nv_flusher.write_lock);
+    pthread_mutex_lock(&nv_flusher.data_lock);
+
+    if (store->dirty == false) {
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+        pthread_mutex_unlock(&nv_flusher.write_lock);
+        return true;
+    }
+
+    /* another writer's keys are kept, only the updated ones are replaced */
+    if (nv_flusher_refresh(store) == false) {
+        nv_log("nv reload %s fail, retry later\n", store->file);
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+        pthread_mutex_unlock(&nv_flusher.write_lock);
+        return false;
+    }
+
+    nv_format_t format = store->config.format;
+    if (format == NV_FORMAT_AUTO) {
+        format = store->format;
+    }
+
+    /* json encodes into the print buffer of this thread, no copy needed */
+    size_t len = 0;
+    uint64_t start = nv_stats_begin();
+    char* data = nv_backends[format].encode(store->json, &len);
+    nv_stats_end(NV_STATS_SERIALIZE, start);
+
+    bool wal_exist = store->wal_exist;
+    store->dirty = data == NULL;
+
+    /* updates made while the file is written are recorded anew */
+    cJSON* unwritten = data ? store->unwritten : NULL;
+    bool unwritten_lost = data && store->unwritten_lost;
+    if (data) {
+        store->unwritten = NULL;
+        store->unwritten_lost = false;
+    }
+
+    pthread_mutex_unlock(&nv_flusher.data_lock);
+
+    bool ret = data && nv_file_write(store->file, data, len, &store->config);
+    if (data) {
+        nv_backends[format].release(data);
+    }
+
+    if (ret && wal_exist) {
+        ret = nv_wal_drop(store->wal_file, &store->config);
+    }
+
+    pthread_mutex_lock(&nv_flusher.data_lock);
+    if (ret) {
+        /* a writer right after the rename is missed until its next write */
+        nv_stamp_read(store, &store->stamp);
+        store->format = format;
+        store->wal_exist = false;
+    } else {
+        nv_log("nv flush %s fail, retry later\n", store->file);
+        store->dirty = true;
+        store->unwritten_lost |= unwritten_lost;
+
+        for (cJSON* key = unwritten ? unwritten->child : NULL; key;
+             key = key->next) {
+            nv_flusher_mark(store, key->string);
+        }
+    }
+    pthread_mutex_unlock(&nv_flusher.data_lock);
+
+    cJSON_Delete(unwritten);
+
+    pthread_mutex_unlock(&nv_flusher.write_lock);
+
+    return ret;
+}
+
+/**
+ * nv_flusher_write_all, write every dirty store of the flusher registry
+ * @return boolean, false if any write fail
+ */
+static bool nv_flusher_write_all(void)
+{
+    nv_registry_t* registry = atomic_load(&nv_flusher.registry);
+    size_t count = 0;
+    bool ret = true;
+
+    /* referenced stores are not evicted while written outside the lock */
+    pthread_mutex_lock(&registry->lock);
+
+    for (nv_registry_entry_t* entry = registry->head; entry;
+         entry = entry->next) {
+        count++;
+    }
+
+    if (count == 0) {
+        pthread_mutex_unlock(&registry->lock);
+        return true;
+    }
+
+    nv_store_t** stores = malloc(count * sizeof(nv_store_t*));
+    if (stores == NULL) {
+        pthread_mutex_unlock(&registry->lock);
+        return false;
+    }
+
+    count = 0;
+    for (nv_registry_entry_t* entry = registry->head; entry;
+         entry = entry->next) {
+        if (entry->store) {
+            entry->refs++;
+            stores[count++] = entry->store;
+        }
+    }
+
+    pthread_mutex_unlock(&registry->lock);
+
+    for (size_t i = 0; i < count; i++) {
+        if (nv_flusher_write(stores[i]) == false) {
+            ret = false;
+        }
+
+        nv_registry_close(registry, stores[i]);
+    }
+
+    free(stores);
+    return ret;
+}
+
+static void* nv_flusher_worker(void* arg)
+{
+    UNUSED(arg);
+
+    pthread_mutex_lock(&nv_flusher.lock);
+
+    for (;;) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += CONFIG_NV_FLUSH_INTERVAL_MS / 1000;
+        deadline.tv_nsec += (CONFIG_NV_FLUSH_INTERVAL_MS % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (nv_flusher.requested == nv_flusher.completed
+               && atomic_load(&nv_flusher.dirty) < CONFIG_NV_FLUSH_DIRTY_SIZE
+               && pthread_cond_timedwait(&nv_flusher.cond, &nv_flusher.lock,
+                                         &deadline)
+                      != ETIMEDOUT) {
+        }
+
+        /* updates made before a request are in the trees written below */
+        uint64_t generation = nv_flusher.requested;
+        pthread_mutex_unlock(&nv_flusher.lock);
+
+        bool ret = true;
+        if (atomic_exchange(&nv_flusher.dirty, 0) > 0
+            || generation != nv_flusher.completed) {
+            ret = nv_flusher_write_all();
+        }
+
+        pthread_mutex_lock(&nv_flusher.lock);
+        nv_flusher.completed = generation;
+        nv_flusher.ret = ret;
+        pthread_cond_broadcast(&nv_flusher.done);
+    }
+
+    return NULL;
+}
+
+static void nv_flusher_exit(void)
+{
+    if (nv_flusher_write_all() == false) {
+        nv_log("nv flush at exit fail\n");
+    }
+}
+
+static void nv_flusher_start(void)
+{
+    pthread_t thread;
+    nv_config_t config;
+
+    nv_config_init(&config);
+
+    /* the whole tree is written per flush, repeated updates of a key
+     * collapse into the last value instead of one log record each */
+    config.wal = false;
+    config.thread_safe = false;
+    config.shared = false;
+
+    nv_registry_t* registry = nv_registry_create(&config,
+                                                 CONFIG_NV_REGISTRY_BUDGET);
+    if (registry == NULL) {
+        return;
+    }
+
+    registry->deferred = true;
+
+    if (pthread_create(&thread, NULL, nv_flusher_worker, NULL) != 0) {
+        nv_log("nv flusher thread create fail\n");
+        nv_registry_destroy(registry);
+        return;
+    }
+
+    pthread_detach(thread);
+    atomic_store(&nv_flusher.registry, registry);
+    atexit(nv_flusher_exit);
+}
+
+/**
+ * nv_flusher_size, bytes an update adds to the dirty threshold
+ */
+static size_t nv_flusher_size(const char* key, uint32_t len,
+                              nv_data_type_t type)
+{
+    switch (type) {
+    case NV_DATA_STRING_ARRAY:
+    case NV_DATA_INT_ARRAY:
+    case NV_DATA_FLOAT_ARRAY:
+    case NV_DATA_DOUBLE_ARRAY:
+    case NV_DATA_IP:
+    case NV_DATA_MAC:
+    case NV_DATA_PACKED_INT_ARRAY:
+    case NV_DATA_PACKED_FLOAT_ARRAY:
+    case NV_DATA_PACKED_DOUBLE_ARRAY:
+        return strlen(key) + len * sizeof(double);
+    case NV_DATA_BLOB:
+        /* the bytes went to the sidecar, the file only gets the reference */
+        return strlen(key) + sizeof(nv_blob_ref_t);
+    default:
+        return strlen(key) + len;
+    }
+}
+
+/**
+ * nv_flusher_find, flusher store of the path, if updates went async, caught
+ * up with other writers of the file
+ * @param file nv file path
+ * @return     store handle, release by nv_registry_close, NULL if none
+ */
+static nv_store_t* nv_flusher_find(const char* file)
+{
+    nv_registry_t* registry = atomic_load(&nv_flusher.registry);
+    nv_store_t* store =
+        registry ? nv_registry_acquire(registry, file, false, false) : NULL;
+
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        if (nv_flusher_refresh(store) == false) {
+            nv_log("nv reload %s fail, keep cached tree\n", file);
+        }
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+    }
+
+    return store;
+}
+
+/**
+ * nv_sync_file, write value to the file now
+ * @param file  nv file path
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+static bool nv_sync_file(const char* file, char* key, void* value,
+                         uint32_t len, nv_data_type_t type)
+{
+    /* pending async updates of the file are written along */
+    nv_store_t* store = nv_flusher_find(file);
+    bool ret = false;
+
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        ret = nv_store_sync(store, key, value, len, type);
+        nv_flusher_mark(store, key);
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+
+        if (nv_flusher_write(store) == false) {
+            ret = false;
+        }
+
+        nv_registry_close(atomic_load(&nv_flusher.registry), store);
+        return ret;
+    }
+
+    if (NV_PATH_REGISTRY) {
+        store = nv_path_open(file, true);
+        if (store) {
+            ret = nv_store_sync(store, key, value, len, type);
+            nv_path_close(store);
+        }
+        return ret;
+    }
+
+    /* the file is replaced atomically, only writers race on the update */
+    pthread_mutex_lock(&nv_path_lock);
+    nv_arena_t* previous = nv_scope_enter(NULL);
+
+    store = nv_store_load(file, NULL, true);
+    if (store) {
+        ret = nv_store_sync(store, key, value, len, type);
+        if (nv_close(store) == false) {
+            ret = false;
+        }
+    }
+
+    nv_scope_leave(previous);
+    pthread_mutex_unlock(&nv_path_lock);
+
+    return ret;
+}
+
+/**
+ * nv_sync_async, update value in memory, written by the flusher thread
+ * @param file  nv file path
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_sync_async(const char* file, char* key, void* value, uint32_t len,
+                   nv_data_type_t type)
+{
+    pthread_once(&nv_flusher.once, nv_flusher_start);
+
+    nv_registry_t* registry = atomic_load(&nv_flusher.registry);
+    if (registry == NULL) {
+        return nv_sync_file(file, key, value, len, type);
+    }
+
+    nv_store_t* store = nv_registry_open(registry, file);
+    if (store == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&nv_flusher.data_lock);
+    bool ret = nv_store_sync(store, key, value, len, type);
+    nv_flusher_mark(store, key);
+    pthread_mutex_unlock(&nv_flusher.data_lock);
+
+    nv_registry_close(registry, store);
+
+    size_t size = nv_flusher_size(key, len, type);
+    size_t dirty = atomic_fetch_add(&nv_flusher.dirty, size) + size;
+    if (dirty >= CONFIG_NV_FLUSH_DIRTY_SIZE
+        && dirty - size < CONFIG_NV_FLUSH_DIRTY_SIZE) {
+        pthread_mutex_lock(&nv_flusher.lock);
+        pthread_cond_signal(&nv_flusher.cond);
+        pthread_mutex_unlock(&nv_flusher.lock);
+    }
+
+    return ret;
+}
+
+/**
+ * nv_flush, ask the flusher thread to write pending updates now
+ */
+void nv_flush(void)
+{
+    pthread_mutex_lock(&nv_flusher.lock);
+    nv_flusher.requested++;
+    pthread_cond_signal(&nv_flusher.cond);
+    pthread_mutex_unlock(&nv_flusher.lock);
+}
+
+/**
+ * nv_flush_wait, write pending updates and wait until they are durable
+ * @return boolean, false if a write fail
+ */
+bool nv_flush_wait(void)
+{
+    if (atomic_load(&nv_flusher.registry) == NULL) {
+        return true;
+    }
+
+    pthread_mutex_lock(&nv_flusher.lock);
+
+    uint64_t generation = ++nv_flusher.requested;
+    pthread_cond_signal(&nv_flusher.cond);
+
+    while (nv_flusher.completed < generation) {
+        pthread_cond_wait(&nv_flusher.done, &nv_flusher.lock);
+    }
+
+    bool ret = nv_flusher.ret;
+    pthread_mutex_unlock(&nv_flusher.lock);
+
+    return ret;
+}
+
+/**
+ * nv_sync to file
+ * @param file  nv file path
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ */
+void nv_sync(const char* file, char* key, void* value, uint32_t len,
+             nv_data_type_t type)
+{
+    if (nv_sync_file(file, key, value, len, type) == false) {
+        nv_log("nv sync %s %s fail\n", file, key);
+    }
+}
+
+/**
+ * nv_get_scan, read one key straight from the file text without a tree
+ * @param file  nv file path
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      scan result, NV_SCAN_FALLBACK for log, binary or odd content
+ */
+static nv_scan_result_t nv_get_scan(const char* file, const char* key,
+                                    char* value, uint32_t len,
+                                    nv_data_type_t type)
+{
+    char wal_file[PATH_MAX];
+    nv_view_t view;
+
+    /* pending log records override the file, the tree path replays them */
+    if (snprintf(wal_file, sizeof(wal_file), "%s%s", file, NV_WAL_SUFFIX)
+            >= (int)sizeof(wal_file)
+        || access(wal_file, F_OK) == 0) {
+        return NV_SCAN_FALLBACK;
+    }
+
+    uint64_t start = nv_stats_begin();
+    if (nv_view_open(file, &view) == false) {
+        return errno == ENOENT ? NV_SCAN_MISSING : NV_SCAN_FALLBACK;
+    }
+    nv_stats_end(NV_STATS_READ, start);
+    nv_stats_add(NV_STATS_BYTES_READ, view.len);
+
+    if (nv_view_inflate(&view) == false) {
+        return NV_SCAN_FALLBACK;
+    }
+
+    nv_scan_result_t ret = NV_SCAN_FALLBACK;
+    if (nv_backend_detect(view.data, view.len) == NV_FORMAT_JSON) {
+        start = nv_stats_begin();
+        ret = nv_scan_get(view.data, view.len, key, value, len, type);
+        nv_stats_end(NV_STATS_LOOKUP, start);
+    }
+
+    nv_view_close(&view);
+    return ret;
+}
+
+/**
+ * nv_get from file
+ * @param file  nv file path
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_get(const char* file, char* key, char* value, uint32_t len,
+            nv_data_type_t type)
+{
+    nv_store_t* store = nv_flusher_find(file);
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        bool ret = nv_store_get(store, key, value, len, type);
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+
+        nv_registry_close(atomic_load(&nv_flusher.registry), store);
+        return ret;
+    }
+
+    if (NV_PATH_REGISTRY) {
+        store = nv_path_open(file, false);
+        if (store == NULL) {
+            return false;
+        }
+
+        bool ret = nv_store_get(store, key, value, len, type);
+        nv_path_close(store);
+        return ret;
+    }
+
+    nv_scan_result_t scan = nv_get_scan(file, key, value, len, type);
+    if (scan != NV_SCAN_FALLBACK) {
+        return scan == NV_SCAN_FOUND;
+    }
+
+    bool ret = false;
+    nv_arena_t* previous = nv_scope_enter(NULL);
+
+    store = nv_store_load(file, NULL, false);
+    if (store) {
+        ret = nv_store_get(store, key, value, len, type);
+        nv_close(store);
+    }
+
+    nv_scope_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_get_many, read many keys with one read and one parse of the file
+ * @param file    nv file path
+ * @param entries key descriptors, status set per entry
+ * @param count   number of entries
+ * @return        boolean, true if every entry is NV_STATUS_OK
+ */
+bool nv_get_many(const char* file, nv_entry_t* entries, size_t count)
+{
+    nv_store_t* store = nv_flusher_find(file);
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        bool ret = nv_store_get_many(store, entries, count);
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+
+        nv_registry_close(atomic_load(&nv_flusher.registry), store);
+        return ret;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        entries[i].status = NV_STATUS_NOT_FOUND;
+    }
+
+    if (NV_PATH_REGISTRY) {
+        store = nv_path_open(file, false);
+        if (store == NULL) {
+            return false;
+        }
+
+        bool ret = nv_store_get_many(store, entries, count);
+        nv_path_close(store);
+        return ret;
+    }
+
+    bool ret = false;
+    nv_arena_t* previous = nv_scope_enter(NULL);
+
+    store = nv_store_load(file, NULL, false);
+    if (store) {
+        ret = nv_store_get_many(store, entries, count);
+        nv_close(store);
+    }
+
+    nv_scope_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_sync_many, update many keys with one read, one parse and one write
+ * @param file    nv file path
+ * @param entries key descriptors, status set per entry
+ * @param count   number of entries
+ * @return        boolean, true if every entry is NV_STATUS_OK
+ */
+bool nv_sync_many(const char* file, nv_entry_t* entries, size_t count)
+{
+    bool ret = false;
+
+    nv_store_t* store = nv_flusher_find(file);
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        ret = nv_store_sync_many(store, entries, count);
+        for (size_t i = 0; i < count; i++) {
+            nv_flusher_mark(store, entries[i].key);
+        }
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+
+        ret = nv_flusher_write(store) && ret;
+        nv_registry_close(atomic_load(&nv_flusher.registry), store);
+        return ret;
+    }
+
+    if (NV_PATH_REGISTRY) {
+        store = nv_path_open(file, true);
+        if (store) {
+            ret = nv_store_sync_many(store, entries, count);
+            nv_path_close(store);
+        }
+        return ret;
+    }
+
+    pthread_mutex_lock(&nv_path_lock);
+    nv_arena_t* previous = nv_scope_enter(NULL);
+
+    store = nv_store_load(file, NULL, true);
+    if (store) {
+        ret = nv_store_sync_many(store, entries, count);
+
+        /* a failed write leaves the updates unsaved */
+        if (nv_close(store) == false) {
+            for (size_t i = 0; i < count; i++) {
+                entries[i].status = NV_STATUS_FAIL;
+            }
+            ret = false;
+        }
+    }
+
+    nv_scope_leave(previous);
+    pthread_mutex_unlock(&nv_path_lock);
+    return ret;
+}
 
 /**
- * nv_read from file
- * @param file nv file path
- * @param data data buffer
- * @return     boolean
+ * nv_get_range, read array elements from offset
+ * @param file   nv file path
+ * @param key    nv key
+ * @param offset first element
+ * @param value  data buffer of the array type
+ * @param count  buffer elements, fewer are read at the end of the array
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length, may be NULL
+ * @return       boolean
  */
-bool nv_read(const char* file, void* data)
+bool nv_get_range(const char* file, const char* key, uint32_t offset,
+                  void* value, uint32_t count, nv_data_type_t type,
+                  uint32_t* length)
 {
-    FILE* fp = fopen(file, "r");
-    if (fp == NULL) {
-        nv_log("nv read open %s fail, errno %d %s\n", file, errno,
-               strerror(errno));
-        return false;
+    nv_store_t* store = nv_flusher_find(file);
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        bool ret = nv_store_get_range(store, key, offset, value, count, type,
+                                      length);
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+
+        nv_registry_close(atomic_load(&nv_flusher.registry), store);
+        return ret;
     }
 
-    fseek(fp, 0, SEEK_END);
-    long size = ftell(fp);
-    rewind(fp);
+    if (NV_PATH_REGISTRY) {
+        store = nv_path_open(file, false);
+        if (store == NULL) {
+            return false;
+        }
+
+        bool ret = nv_store_get_range(store, key, offset, value, count, type,
+                                      length);
+        nv_path_close(store);
+        return ret;
+    }
 
-    fread(data, 1, size, fp);
-    fclose(fp);
+    bool ret = false;
+    nv_arena_t* previous = nv_scope_enter(NULL);
 
-    return true;
+    store = nv_store_load(file, NULL, false);
+    if (store) {
+        ret = nv_store_get_range(store, key, offset, value, count, type,
+                                 length);
+        nv_close(store);
+    }
+
+    nv_scope_leave(previous);
+    return ret;
 }
 
 /**
- * nv_write to file
- * @param file nv file path
- * @param data data buffer
- * @return     boolean
+ * nv_path_splice, replace or append array elements of a file
+ * @param file   nv file path
+ * @param key    nv key
+ * @param offset first element, NV_RANGE_APPEND for the end
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   array data type
+ * @param length array length after the update, may be NULL
+ * @return       boolean
  */
-bool nv_write(const char* file, void* data)
+static bool nv_path_splice(const char* file, const char* key, uint32_t offset,
+                           void* value, uint32_t count, nv_data_type_t type,
+                           uint32_t* length)
 {
-    FILE* fp = fopen(file, "w");
-    if (fp == NULL) {
-        nv_log("nv write open %s fail, errno %d %s\n", file, errno,
-               strerror(errno));
-        return false;
+    bool ret = false;
+
+    nv_store_t* store = nv_flusher_find(file);
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        ret = nv_store_splice_sync(store, key, offset, value, count, type,
+                                   length);
+        nv_flusher_mark(store, key);
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+
+        ret = nv_flusher_write(store) && ret;
+        nv_registry_close(atomic_load(&nv_flusher.registry), store);
+        return ret;
     }
 
-    int fd = fileno(fp);
-    if (fd != -1) {
-        fsync(fd);
-    } else {
-        nv_log("fileno fail, errno %d %s\n", errno, strerror(errno));
+    if (NV_PATH_REGISTRY) {
+        store = nv_path_open(file, true);
+        if (store) {
+            ret = nv_store_splice_sync(store, key, offset, value, count, type,
+                                       length);
+            nv_path_close(store);
+        }
+        return ret;
     }
 
-    fprintf(fp, "%s", (char*)data);
-    fclose(fp);
+    pthread_mutex_lock(&nv_path_lock);
+    nv_arena_t* previous = nv_scope_enter(NULL);
 
-    return true;
+    store = nv_store_load(file, NULL, true);
+    if (store) {
+        ret = nv_store_splice_sync(store, key, offset, value, count, type,
+                                   length);
+        ret = nv_close(store) && ret;
+    }
+
+    nv_scope_leave(previous);
+    pthread_mutex_unlock(&nv_path_lock);
+    return ret;
 }
 
 /**
- * nv_sync to file
- * @param file  nv file path
- * @param key   nv key
- * @param value data buffer
- * @param len   data buffer length
- * @param type  data type
+ * nv_set_range, replace array elements from offset, the elements past the
+ * end are appended
+ * @param file   nv file path
+ * @param key    nv key, created if offset is 0
+ * @param offset first element, at most the array length
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length after the update, may be NULL
+ * @return       boolean
  */
-void nv_sync(const char* file, char* key, void* value, uint32_t len,
-             nv_data_type_t type)
+bool nv_set_range(const char* file, const char* key, uint32_t offset,
+                  void* value, uint32_t count, nv_data_type_t type,
+                  uint32_t* length)
 {
-    cJSON* json = NULL;
+    if (offset == NV_RANGE_APPEND) {
+        return false;
+    }
 
-    uint8_t nv_buffer[CONFIG_NV_DATA_BUFFER_SIZE] = { 0 };
+    return nv_path_splice(file, key, offset, value, count, type, length);
+}
 
-    if (access(file, F_OK) == 0) {
-        if (nv_read(file, nv_buffer)) {
-            json = cJSON_Parse((const char*)nv_buffer);
-        } else {
-            nv_log("nv sync, nv read %s fail, error %d %s\n", file, errno,
-                   strerror(errno));
-            return;
-        }
+/**
+ * nv_append, add elements at the end of an array
+ * @param file   nv file path
+ * @param key    nv key, created if not exist
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length after the update, may be NULL
+ * @return       boolean
+ */
+bool nv_append(const char* file, const char* key, void* value, uint32_t count,
+               nv_data_type_t type, uint32_t* length)
+{
+    return nv_path_splice(file, key, NV_RANGE_APPEND, value, count, type,
+                          length);
+}
+
+/**
+ * nv_schema_entries, key descriptors of the struct members
+ * @param schema struct schema
+ * @param base   struct
+ * @return       descriptors, release by free, NULL on failure
+ */
+static nv_entry_t* nv_schema_entries(const nv_schema_t* schema, void* base)
+{
+    nv_entry_t* entries = malloc(schema->count * sizeof(nv_entry_t));
+    if (entries == NULL) {
+        nv_log("nv schema of %zu fields alloc fail\n", schema->count);
+        return NULL;
     }
 
-    if (json == NULL) {
-        nv_log("cJSON Parse fail: %s\n", cJSON_GetErrorPtr());
+    for (size_t i = 0; i < schema->count; i++) {
+        const nv_field_t* field = &schema->fields[i];
 
-        cJSON* root = cJSON_CreateObject();
-        char* str = cJSON_Print(root);
-        json = cJSON_Parse(str);
+        entries[i].key = field->key;
+        entries[i].type = field->type;
+        entries[i].value = (char*)base + field->offset;
+        entries[i].len = field->len;
+        entries[i].status = NV_STATUS_OK;
+    }
 
-        cJSON_free(str);
-        cJSON_Delete(root);
+    return entries;
+}
 
-        if (!json) {
-            nv_log("cJSON Parse fail again: %s\n", cJSON_GetErrorPtr());
-            return;
-        }
+/**
+ * nv_json_get_struct, decode the members of a struct in one pass over the
+ * members of the tree, the next field in schema order is tried first as
+ * nv_store_struct writes them in that order, the others are found through an
+ * index of the field keys built on the first miss
+ * @param file   nv file path the blob references are relative to
+ * @param json   tree
+ * @param schema struct schema
+ * @param base   struct
+ * @return       boolean, true if every member was read
+ */
+static bool nv_json_get_struct(const char* file, const cJSON* json,
+                               const nv_schema_t* schema, void* base)
+{
+    bool* seen = calloc(schema->count, sizeof(bool));
+    if (seen == NULL) {
+        nv_log("nv schema of %zu fields alloc fail\n", schema->count);
+        return false;
     }
 
-    cJSON* key_item = cJSON_GetObjectItem(json, key);
-    if (key_item == NULL) {
-        nv_log("cJSON_GetObjectItem %s key %s fail: %s\n", key, file,
-               cJSON_GetErrorPtr());
-    }
+    /* the field keys as members of an object, so the store index finds them
+     * with the same case-insensitive match as a lookup of the tree */
+    cJSON* keys = NULL;
+    nv_index_t index = { 0 };
 
-    switch (type) {
-    case NV_DATA_U8:
-    case NV_DATA_S8:
-        if (key_item) {
-            if (type == NV_DATA_U8) {
-                cJSON_SetNumberHelper(key_item, *(uint8_t*)value);
-            } else {
-                cJSON_SetNumberHelper(key_item, *(int8_t*)value);
-            }
-        } else {
-            if (type == NV_DATA_U8) {
-                cJSON_AddNumberToObject(json, key, *(uint8_t*)value);
-            } else {
-                cJSON_AddNumberToObject(json, key, *(int8_t*)value);
-            }
-        }
-        break;
-    case NV_DATA_U16:
-    case NV_DATA_S16:
-        if (key_item) {
-            if (type == NV_DATA_U16) {
-                cJSON_SetNumberHelper(key_item, *(uint16_t*)value);
-            } else {
-                cJSON_SetNumberHelper(key_item, *(uint16_t*)value);
-            }
-        } else {
-            if (type == NV_DATA_U16) {
-                cJSON_AddNumberToObject(json, key, *(uint16_t*)value);
-            } else {
-                cJSON_AddNumberToObject(json, key, *(int16_t*)value);
-            }
-        }
-        break;
-    case NV_DATA_U32:
-    case NV_DATA_S32:
-        if (key_item) {
-            if (type == NV_DATA_U32) {
-                cJSON_SetNumberHelper(key_item, *(uint32_t*)value);
-            } else {
-                cJSON_SetNumberHelper(key_item, *(int32_t*)value);
-            }
-        } else {
-            if (type == NV_DATA_U32) {
-                cJSON_AddNumberToObject(json, key, *(uint32_t*)value);
-            } else {
-                cJSON_AddNumberToObject(json, key, *(int32_t*)value);
-            }
-        }
-        break;
-    case NV_DATA_U64:
-    case NV_DATA_S64:
-        if (key_item) {
-            if (type == NV_DATA_U64) {
-                cJSON_SetNumberHelper(key_item, *(uint64_t*)value);
-            } else {
-                cJSON_SetNumberHelper(key_item, *(int64_t*)value);
-            }
-        } else {
-            if (type == NV_DATA_U64) {
-                cJSON_AddNumberToObject(json, key, *(uint64_t*)value);
-            } else {
-                cJSON_AddNumberToObject(json, key, *(int64_t*)value);
-            }
-        }
-        break;
-    case NV_DATA_FLOAT:
-    case NV_DATA_DOUBLE:
-        if (key_item) {
-            if (type == NV_DATA_FLOAT) {
-                cJSON_SetNumberHelper(key_item, *(float*)value);
-            } else {
-                cJSON_SetNumberHelper(key_item, *(double*)value);
+    bool ret = true;
+    size_t next = 0;
+    size_t found = 0;
+    for (const cJSON* item = json->child; item && found < schema->count;
+         item = item->next) {
+        size_t i = next;
+        if (i >= schema->count || seen[i]
+            || strcasecmp(schema->fields[i].key, item->string) != 0) {
+            if (keys == NULL) {
+                keys = calloc(schema->count + 1, sizeof(cJSON));
+                if (keys == NULL) {
+                    nv_log("nv schema of %zu fields alloc fail\n",
+                           schema->count);
+                    ret = false;
+                    break;
+                }
+
+                for (size_t k = 0; k < schema->count; k++) {
+                    keys[k].string = (char*)schema->fields[k].key;
+                    keys[k].next = k + 1 < schema->count ? &keys[k + 1]
+                                                         : NULL;
+                }
+                keys[schema->count].child = &keys[0];
+                if (nv_index_build(&index, &keys[schema->count]) == false) {
+                    ret = false;
+                    break;
+                }
             }
-        } else {
-            if (type == NV_DATA_FLOAT) {
-                cJSON_AddNumberToObject(json, key, *(float*)value);
-            } else {
-                cJSON_AddNumberToObject(json, key, *(double*)value);
+
+            const cJSON* key = nv_index_find(&index, item->string);
+            if (key == NULL || seen[key - keys]) {
+                continue;
             }
+            i = key - keys;
         }
-        break;
-    case NV_DATA_STR:
-        if (key_item) {
-            cJSON_SetValuestring(key_item, value);
-        } else {
-            cJSON_AddStringToObject(json, key, value);
-        }
-        break;
-    case NV_DATA_STRING_ARRAY:
-    case NV_DATA_INT_ARRAY:
-    case NV_DATA_FLOAT_ARRAY:
-    case NV_DATA_DOUBLE_ARRAY: {
-        if (key_item) {
-            cJSON* tmp = cJSON_DetachItemFromObject(json, key);
-            cJSON_Delete(tmp);
-        }
-
-        if (type == NV_DATA_STRING_ARRAY) {
-            cJSON_AddItemToObject(
-                json, key, cJSON_CreateStringArray((const char**)value, len));
-        } else if (type == NV_DATA_INT_ARRAY) {
-            cJSON_AddItemToObject(json, key,
-                                  cJSON_CreateIntArray((const int*)value, len));
-        } else if (type == NV_DATA_FLOAT_ARRAY) {
-            cJSON_AddItemToObject(
-                json, key, cJSON_CreateFloatArray((const float*)value, len));
-        } else if (type == NV_DATA_DOUBLE_ARRAY) {
-            cJSON_AddItemToObject(
-                json, key, cJSON_CreateDoubleArray((const double*)value, len));
-        }
-        break;
+
+        /* the first member of a key wins as for a lookup */
+        const nv_field_t* field = &schema->fields[i];
+        seen[i] = true;
+        found++;
+        next = i + 1;
+        ret &= field->decode(file, item, (char*)base + field->offset,
+                             field->len);
     }
-    case NV_DATA_IP:
-        memset(nv_buffer, 0, sizeof(nv_buffer));
-        sprintf((char*)nv_buffer, "%d.%d.%d.%d", *((uint32_t*)value),
-                *((uint32_t*)value + 1), *((uint32_t*)value + 2),
-                *((uint32_t*)value + 3));
-        if (key_item) {
-            cJSON_SetValuestring(key_item, (const char*)nv_buffer);
-        } else {
-            cJSON_AddStringToObject(json, key, (const char* const)nv_buffer);
-        }
-        break;
-    case NV_DATA_MAC:
-        memset(nv_buffer, 0, sizeof(nv_buffer));
-        sprintf((char*)nv_buffer, "%d-%d-%d-%d-%d-%d", *((uint32_t*)value),
-                *((uint32_t*)value + 1), *((uint32_t*)value + 2),
-                *((uint32_t*)value + 3), *((uint32_t*)value + 4),
-                *((uint32_t*)value + 5));
-
-        if (key_item) {
-            cJSON_SetValuestring(key_item, (const char*)nv_buffer);
-        } else {
-            cJSON_AddStringToObject(json, key, (const char* const)nv_buffer);
-        }
-        break;
-    default:
-        nv_log("unknown %d type\n", type);
-        break;
+
+    nv_index_free(&index);
+    free(keys);
+    free(seen);
+    return ret && found == schema->count;
+}
+
+/**
+ * nv_store_get_struct, read every member of a struct from one version of the
+ * tree
+ * @param store  store handle
+ * @param schema struct schema
+ * @param base   struct
+ * @return       boolean, true if every member was read
+ */
+static bool nv_store_get_struct(nv_store_t* store, const nv_schema_t* schema,
+                                void* base)
+{
+    bool ret;
+    nv_stats_data_t* previous = nv_stats_enter(&store->stats);
+
+    if (store->config.shared) {
+        nv_store_revalidate(store);
+        nv_watch_deliver(store);
     }
 
-    char* p_json = cJSON_Print(json);
-    if (nv_write(file, p_json) == false) {
-        nv_log("nv write %s fail, errno %d %s\n", file, errno, strerror(errno));
+    if (store->config.thread_safe) {
+        uint32_t token = nv_rcu_read_lock(store->rcu);
+
+        nv_version_t* version = atomic_load(&store->version);
+        ret = nv_json_get_struct(store->file, version->json, schema, base);
+
+        nv_rcu_read_unlock(store->rcu, token);
+    } else {
+        ret = nv_json_get_struct(store->file, store->json, schema, base);
     }
-    cJSON_free(p_json);
 
-    cJSON_Delete(json);
+    nv_stats_leave(previous);
+    return ret;
 }
 
 /**
- * nv_get from file
- * @param file  nv file path
- * @param key   nv key
- * @param value data buffer
- * @param len   data buffer length
- * @param type  data type
- * @return      boolean
+ * nv_get_blob, map a NV_DATA_BLOB value read-only without copying it, the
+ * bytes are read on access and nv_get checks the checksum of a copy
+ * @param file nv file path
+ * @param key  nv key
+ * @param blob mapping, release by nv_blob_release
+ * @return     boolean
  */
-bool nv_get(const char* file, char* key, char* value, uint32_t len,
-            nv_data_type_t type)
+bool nv_get_blob(const char* file, const char* key, nv_blob_t* blob)
 {
-    UNUSED(len);
+    nv_store_t* store = nv_flusher_find(file);
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        bool ret = nv_store_get_blob(store, key, blob);
+        pthread_mutex_unlock(&nv_flusher.data_lock);
 
-    uint8_t nv_buffer[CONFIG_NV_DATA_BUFFER_SIZE] = { 0 };
-    if (nv_read(file, nv_buffer) == false) {
-        return false;
+        nv_registry_close(atomic_load(&nv_flusher.registry), store);
+        return ret;
     }
 
-    cJSON* json = cJSON_Parse((const char*)nv_buffer);
-    if (json == NULL) {
-        nv_log("cJSON_Parse fail %s\n", cJSON_GetErrorPtr());
-        return false;
+    if (NV_PATH_REGISTRY) {
+        store = nv_path_open(file, false);
+        if (store == NULL) {
+            memset(blob, 0, sizeof(nv_blob_t));
+            return false;
+        }
+
+        bool ret = nv_store_get_blob(store, key, blob);
+        nv_path_close(store);
+        return ret;
     }
 
-    cJSON* key_item = cJSON_GetObjectItem(json, key);
-    if (key_item == NULL) {
-        cJSON_Delete(json);
-        return false;
+    bool ret = false;
+    nv_arena_t* previous = nv_scope_enter(NULL);
+
+    memset(blob, 0, sizeof(nv_blob_t));
+    store = nv_store_load(file, NULL, false);
+    if (store) {
+        ret = nv_store_get_blob(store, key, blob);
+        nv_close(store);
     }
 
-    switch (type) {
-    case NV_DATA_U8:
-        *(uint8_t *)value = key_item->valueint;
-        break;
-    case NV_DATA_S8:
-        *(int8_t *)value = key_item->valueint;
-        break;
-    case NV_DATA_U16:
-        *(uint16_t *)value = key_item->valueint;
-        break;
-    case NV_DATA_S16:
-        *(int16_t *)value = key_item->valueint;
-        break;
-    case NV_DATA_U32:
-        *(uint32_t *)value = key_item->valueint;
-        break;
-    case NV_DATA_S32:
-        *(int32_t *)value = key_item->valueint;
-        break;
-    case NV_DATA_U64:
-        *(uint64_t *)value = key_item->valuedouble;
-        break;
-    case NV_DATA_S64:
-        *(int64_t *)value = key_item->valuedouble;
-        break;
-    case NV_DATA_FLOAT:
-        *(float *)value = key_item->valuedouble;
-        break;
-    case NV_DATA_DOUBLE:
-        *(double *)value = key_item->valuedouble;
-        break;
-    case NV_DATA_STR:
-        strcpy((char*)value, key_item->valuestring);
-        break;
-    case NV_DATA_STRING_ARRAY:
-    case NV_DATA_INT_ARRAY:
-    case NV_DATA_FLOAT_ARRAY:
-    case NV_DATA_DOUBLE_ARRAY: {
-        int size = cJSON_GetArraySize(key_item);
-        for (int i = 0; i < size; i++) {
-            cJSON* array_json = cJSON_GetArrayItem(key_item, i);
-            if (array_json) {
-                if (type == NV_DATA_STRING_ARRAY) {
-                    memcpy(((char**)value)[i], array_json->valuestring,
-                           strlen(array_json->valuestring) + 1);
-                } else if (type == NV_DATA_INT_ARRAY) {
-                    *((int32_t*)value + i) = array_json->valueint;
-                } else if (type == NV_DATA_FLOAT_ARRAY) {
-                    *((float*)value + i) = array_json->valuedouble;
-                } else if (type == NV_DATA_DOUBLE_ARRAY) {
-                    *((double*)value + i) = array_json->valuedouble;
-                }
-            }
-        }
-        break;
+    nv_scope_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_blob_release, unmap a blob of nv_get_blob or nv_store_get_blob
+ * @param blob mapping
+ */
+void nv_blob_release(nv_blob_t* blob)
+{
+    nv_blob_unmap(blob);
+}
+
+/**
+ * nv_load_struct, read every member of a struct with one read and one parse
+ * and one pass over the members of the file
+ * @param file   nv file path
+ * @param schema struct schema
+ * @param base   struct
+ * @return       boolean, true if every member was read
+ */
+bool nv_load_struct(const char* file, const nv_schema_t* schema, void* base)
+{
+    if (schema->count == 0) {
+        return true;
     }
-    case NV_DATA_IP:
-    case NV_DATA_MAC: {
-        int* data = (int*)value;
-        if (type == NV_DATA_IP) {
-            sscanf(key_item->valuestring, "%d.%d.%d.%d", &data[0], &data[1],
-                   &data[2], &data[3]);
-        } else {
 
-            sscanf(key_item->valuestring, "%d-%d-%d-%d-%d-%d", &data[0],
-                   &data[1], &data[2], &data[3], &data[4], &data[5]);
+    nv_store_t* store = nv_flusher_find(file);
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        bool ret = nv_store_get_struct(store, schema, base);
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+
+        nv_registry_close(atomic_load(&nv_flusher.registry), store);
+        return ret;
+    }
+
+    if (NV_PATH_REGISTRY) {
+        store = nv_path_open(file, false);
+        if (store == NULL) {
+            return false;
         }
-        break;
+
+        bool ret = nv_store_get_struct(store, schema, base);
+        nv_path_close(store);
+        return ret;
     }
-    default:
-        nv_log("unknown %d type\n", type);
-        break;
+
+    bool ret = false;
+    nv_arena_t* previous = nv_scope_enter(NULL);
+
+    store = nv_store_load(file, NULL, false);
+    if (store) {
+        ret = nv_store_get_struct(store, schema, base);
+        nv_close(store);
     }
 
-    cJSON_Delete(json);
-    return true;
+    nv_scope_leave(previous);
+    return ret;
+}
+
+/**
+ * nv_store_struct, write every member of a struct with one write
+ * @param file   nv file path
+ * @param schema struct schema
+ * @param base   struct
+ * @return       boolean, true if every member was written
+ */
+bool nv_store_struct(const char* file, const nv_schema_t* schema,
+                     const void* base)
+{
+    if (schema->count == 0) {
+        return true;
+    }
+
+    /* the members are only read by the update */
+    nv_entry_t* entries = nv_schema_entries(schema, (void*)base);
+    if (entries == NULL) {
+        return false;
+    }
+
+    bool ret = nv_sync_many(file, entries, schema->count);
+
+    free(entries);
+    return ret;
 }
 
 /**
@@ -398,47 +5492,118 @@ bool nv_get(const char* file, char* key, char* value, uint32_t len,
  */
 bool nv_delete(const char* file, char* key)
 {
-    uint8_t nv_buffer[CONFIG_NV_DATA_BUFFER_SIZE] = { 0 };
-    if (nv_read(file, nv_buffer) == false) {
-        return false;
+    nv_store_t* store = nv_flusher_find(file);
+    if (store) {
+        pthread_mutex_lock(&nv_flusher.data_lock);
+        nv_store_delete(store, key);
+        nv_flusher_mark(store, key);
+        pthread_mutex_unlock(&nv_flusher.data_lock);
+
+        bool ret = nv_flusher_write(store);
+        nv_registry_close(atomic_load(&nv_flusher.registry), store);
+        return ret;
     }
 
-    cJSON* json = cJSON_Parse((const char*)nv_buffer);
-    if (json == NULL) {
-        nv_log("cJSON_Parse fail %s\n", cJSON_GetErrorPtr());
-        return false;
+    if (NV_PATH_REGISTRY) {
+        store = nv_path_open(file, false);
+        if (store == NULL) {
+            return false;
+        }
+
+        bool ret = nv_store_delete(store, key);
+        nv_path_close(store);
+        return ret;
     }
 
-    cJSON_DeleteItemFromObject(json, key);
+    bool ret = false;
 
-    char* str = cJSON_Print(json);
-    if (str) {
-        if (nv_write(file, str) == false) {
-            nv_log("nv delete write fail, error %d %s\n", errno,
-                   strerror(errno));
+    pthread_mutex_lock(&nv_path_lock);
+    nv_arena_t* previous = nv_scope_enter(NULL);
+
+    store = nv_store_load(file, NULL, false);
+    if (store) {
+        nv_store_delete(store, key);
+        ret = nv_close(store);
+    }
+
+    nv_scope_leave(previous);
+    pthread_mutex_unlock(&nv_path_lock);
+    return ret;
+}
+
+/**
+ * nv_convert, rewrite nv file with its log folded in, in another format
+ * @param src    source nv file path, format detected by content
+ * @param dst    destination nv file path
+ * @param format destination file format
+ * @return       boolean
+ */
+bool nv_convert(const char* src, const char* dst, nv_format_t format)
+{
+    bool ret = false;
+    nv_arena_t* previous = nv_scope_enter(NULL);
+
+    nv_store_t* store = nv_store_load(src, NULL, false);
+    if (store) {
+        if (format == NV_FORMAT_AUTO) {
+            format = store->format;
         }
-        cJSON_free(str);
+
+        ret = nv_save(dst, store->json, format, &store->config);
+        nv_close(store);
     }
 
-    cJSON_Delete(json);
-    return true;
+    nv_scope_leave(previous);
+    return ret;
 }
 
 /**
  * nv_init
  * @param file nv file path
- * @param data nv json format data from file
+ * @param data nv json format data from file, nul terminated
+ * @param size data buffer size
  */
-void nv_init(const char* file, void* data)
+void nv_init(const char* file, void* data, size_t size)
 {
     if (access(file, F_OK) != 0) {
         nv_log("%s not exist, errno %d %s\n", file, errno, strerror(errno));
         return;
     }
 
-    if (nv_read(file, (char*)data) == false) {
+    if (nv_read(file, data, size) == false) {
         return;
     }
 
     nv_log("nv init, file %s\n", file);
 }
+
+/**
+ * nv_stats_get, operation statistics, needs CONFIG_NV_STATS
+ * @param store store handle, NULL for the totals of the process
+ * @param stats statistics snapshot
+ * @return      boolean, false if statistics are compiled out
+ */
+bool nv_stats_get(nv_store_t* store, nv_stats_t* stats)
+{
+#if CONFIG_NV_STATS
+    nv_stats_snapshot(store ? &store->stats : nv_stats_global(), stats);
+    return true;
+#else
+    UNUSED(store);
+    memset(stats, 0, sizeof(nv_stats_t));
+    return false;
+#endif
+}
+
+/**
+ * nv_stats_reset, clear operation statistics
+ * @param store store handle, NULL for the totals of the process
+ */
+void nv_stats_reset(nv_store_t* store)
+{
+#if CONFIG_NV_STATS
+    nv_stats_clear(store ? &store->stats : nv_stats_global());
+#else
+    UNUSED(store);
+#endif
+}
@@ -19,6 +19,7 @@
 #define _NV_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -51,15 +52,216 @@ typedef enum {
     NV_DATA_FLOAT_ARRAY,     ///< float array
     NV_DATA_DOUBLE_ARRAY,    ///< double array
     NV_DATA_IP,              ///< IP Address  (uint32_t array)
-    NV_DATA_MAC              ///< MAC Address (uint32_t array)
+    NV_DATA_MAC,             ///< MAC Address (uint32_t array)
+    /* packed arrays keep the raw little-endian elements as one base64 string,
+     * len is the element count as for the plain array types */
+    NV_DATA_PACKED_INT_ARRAY,       ///< packed int array (int32_t)
+    NV_DATA_PACKED_FLOAT_ARRAY,     ///< packed float array
+    NV_DATA_PACKED_DOUBLE_ARRAY,    ///< packed double array
+    /* opaque bytes kept in the sidecar "<file>.blob", the tree only holds a
+     * reference, len is the byte count */
+    NV_DATA_BLOB                    ///< binary data
 } nv_data_type_t;
 
+typedef struct nv_store nv_store_t;
+typedef struct nv_txn nv_txn_t;
+typedef struct nv_registry nv_registry_t;
+typedef struct nv_item nv_item_t;
+typedef struct nv_watch nv_watch_t;
+typedef struct nv_snapshot nv_snapshot_t;
+
+/**
+ * nv_visit_cb_t, called for each key of an iteration in key order
+ * @param key  nv key
+ * @param item value, read by nv_item_get during the call
+ * @param arg  caller argument
+ * @return     boolean, false to stop, the cursor resumes after key
+ */
+typedef bool (*nv_visit_cb_t)(const char* key, const nv_item_t* item,
+                              void* arg);
+
+/**
+ * nv_watch_cb_t, called after a watched key changed
+ * @param store store handle, the callback may read and update it
+ * @param patch RFC 6902 JSON Patch from the old to the new keys, paths are
+ *              rooted at the top level object, e.g. "/key"
+ * @param arg   caller argument
+ */
+typedef void (*nv_watch_cb_t)(nv_store_t* store, const char* patch,
+                              void* arg);
+
+typedef enum {
+    NV_STATUS_OK = 0,       ///< value read or updated
+    NV_STATUS_NOT_FOUND,    ///< key not exist
+    NV_STATUS_INVALID,      ///< value does not convert to the data type
+    NV_STATUS_FAIL          ///< update or file write failed
+} nv_status_t;
+
+typedef struct {
+    const char* key;        ///< nv key
+    nv_data_type_t type;    ///< data type
+    void* value;            ///< data buffer
+    uint32_t len;           ///< data buffer length
+    nv_status_t status;     ///< result of the entry
+} nv_entry_t;
+
+struct cJSON;
+
+/* decoder of one schema field, converts the member its key names */
+typedef bool (*nv_field_decode_t)(const char* file, const struct cJSON* item,
+                                  void* value, uint32_t len);
+
+typedef struct {
+    const char* key;            ///< nv key
+    nv_data_type_t type;        ///< data type
+    size_t offset;              ///< member offset in the struct
+    uint32_t len;               ///< data buffer length, element count of arrays
+    nv_field_decode_t decode;   ///< decoder of the data type
+} nv_field_t;
+
+typedef struct {
+    const void* data;    ///< blob bytes, read-only, valid until released
+    size_t size;         ///< blob bytes
+    void* map;           ///< mapping, NULL if nothing is mapped
+    size_t map_size;     ///< mapping length
+} nv_blob_t;
+
+typedef struct {
+    const nv_field_t* fields;    ///< one descriptor per member
+    size_t count;                ///< number of fields
+} nv_schema_t;
+
+/* element size of the array types, length of the others is the byte size */
+#define NV_DATA_ELEMENT_SIZE(type)                               \
+    ((type) == NV_DATA_STRING_ARRAY           ? sizeof(char*)    \
+     : (type) == NV_DATA_INT_ARRAY            ? sizeof(int32_t)  \
+     : (type) == NV_DATA_FLOAT_ARRAY          ? sizeof(float)    \
+     : (type) == NV_DATA_DOUBLE_ARRAY         ? sizeof(double)   \
+     : (type) == NV_DATA_IP                   ? sizeof(uint32_t) \
+     : (type) == NV_DATA_MAC                  ? sizeof(uint32_t) \
+     : (type) == NV_DATA_PACKED_INT_ARRAY     ? sizeof(int32_t)  \
+     : (type) == NV_DATA_PACKED_FLOAT_ARRAY   ? sizeof(float)    \
+     : (type) == NV_DATA_PACKED_DOUBLE_ARRAY  ? sizeof(double)   \
+                                              : 1)
+
+/* one decoder per data type, named after the type for NV_FIELD */
+#define NV_FIELD_DECODE_DECLARE(type)                                     \
+    bool nv_field_decode_##type(const char* file, const struct cJSON* item, \
+                                void* value, uint32_t len);
+
+NV_FIELD_DECODE_DECLARE(NV_DATA_U8)
+NV_FIELD_DECODE_DECLARE(NV_DATA_S8)
+NV_FIELD_DECODE_DECLARE(NV_DATA_U16)
+NV_FIELD_DECODE_DECLARE(NV_DATA_S16)
+NV_FIELD_DECODE_DECLARE(NV_DATA_U32)
+NV_FIELD_DECODE_DECLARE(NV_DATA_S32)
+NV_FIELD_DECODE_DECLARE(NV_DATA_U64)
+NV_FIELD_DECODE_DECLARE(NV_DATA_S64)
+NV_FIELD_DECODE_DECLARE(NV_DATA_FLOAT)
+NV_FIELD_DECODE_DECLARE(NV_DATA_DOUBLE)
+NV_FIELD_DECODE_DECLARE(NV_DATA_STR)
+NV_FIELD_DECODE_DECLARE(NV_DATA_STRING_ARRAY)
+NV_FIELD_DECODE_DECLARE(NV_DATA_INT_ARRAY)
+NV_FIELD_DECODE_DECLARE(NV_DATA_FLOAT_ARRAY)
+NV_FIELD_DECODE_DECLARE(NV_DATA_DOUBLE_ARRAY)
+NV_FIELD_DECODE_DECLARE(NV_DATA_IP)
+NV_FIELD_DECODE_DECLARE(NV_DATA_MAC)
+NV_FIELD_DECODE_DECLARE(NV_DATA_PACKED_INT_ARRAY)
+NV_FIELD_DECODE_DECLARE(NV_DATA_PACKED_FLOAT_ARRAY)
+NV_FIELD_DECODE_DECLARE(NV_DATA_PACKED_DOUBLE_ARRAY)
+NV_FIELD_DECODE_DECLARE(NV_DATA_BLOB)
+
+/**
+ * NV_FIELD, schema descriptor of one struct member, the X of an X-macro list
+ * @param st     struct type
+ * @param member struct member
+ * @param key    nv key
+ * @param type   data type, one of the NV_DATA_* names, it selects the decoder
+ */
+#define NV_FIELD(st, member, key, type)                                  \
+    { (key), (type), offsetof(st, member),                               \
+      (uint32_t)(sizeof(((st*)0)->member) / NV_DATA_ELEMENT_SIZE(type)), \
+      nv_field_decode_##type },
+
+/**
+ * NV_SCHEMA, define a static schema from an X-macro list of NV_FIELD
+ * arguments, e.g.
+ *   #define SETTINGS_FIELDS(X)                           \
+ *       X(settings_t, name, "name", NV_DATA_STR)         \
+ *       X(settings_t, age,  "age",  NV_DATA_U8)
+ *   NV_SCHEMA(settings_schema, SETTINGS_FIELDS);
+ * @param name   schema variable
+ * @param FIELDS X-macro list
+ */
+#define NV_SCHEMA(name, FIELDS)                                         \
+    static const nv_field_t name##_fields[] = { FIELDS(NV_FIELD) };     \
+    static const nv_schema_t name                                       \
+        = { name##_fields, sizeof(name##_fields) / sizeof(nv_field_t) }
+
+typedef struct {
+    char* key;    ///< last key visited, NULL to start from the first
+    bool done;    ///< every key of the range was visited
+} nv_cursor_t;
+
+typedef enum {
+    NV_FORMAT_AUTO = 0,    ///< keep the on-disk format, json for new file
+    NV_FORMAT_JSON,        ///< cJSON text
+    NV_FORMAT_BINARY       ///< typed TLV, exact 64-bit integers
+} nv_format_t;
+
+typedef enum {
+    NV_DURABILITY_NONE = 0,    ///< atomic replace, no fsync
+    NV_DURABILITY_ASYNC,       ///< atomic replace, fsync by background thread
+    NV_DURABILITY_FULL,        ///< temp file, fsync, rename, fsync directory
+    NV_DURABILITY_GROUP        ///< FULL, concurrent commits share fsync
+} nv_durability_t;
+
+typedef struct {
+    nv_format_t format;           ///< file format written on flush
+    nv_durability_t durability;   ///< file and log write durability
+    uint32_t group_commit_us;     ///< NV_DURABILITY_GROUP window, us
+    bool wal;                     ///< append-only log mode, see nv_store_flush
+    uint32_t wal_compact_size;    ///< fold log into nv file beyond, bytes
+    bool thread_safe;             ///< lock-free readers, copying writers
+    bool shared;                  ///< coherent across processes
+    uint32_t compress;            ///< nv file compression level 1-9, 0 off
+} nv_config_t;
+
+#define NV_STATS_BUCKETS 32    ///< log2 latency buckets, the last one open
+
+typedef enum {
+    NV_STATS_READ = 0,     ///< open and read or map nv file and log
+    NV_STATS_PARSE,        ///< decode nv file, replay log
+    NV_STATS_LOOKUP,       ///< find key in tree or file text
+    NV_STATS_SERIALIZE,    ///< encode tree, print log records
+    NV_STATS_WRITE,        ///< write nv file or log
+    NV_STATS_SYNC,         ///< fsync file or directory
+    NV_STATS_COMPRESS,     ///< compress or decompress nv file
+    NV_STATS_PHASE_MAX
+} nv_stats_phase_t;
+
+typedef struct {
+    uint64_t count;                        ///< timed calls
+    uint64_t total_ns;                     ///< summed latency, ns
+    uint64_t max_ns;                       ///< largest latency, ns
+    uint64_t buckets[NV_STATS_BUCKETS];    ///< [2^(i-1), 2^i) ns, 0 for 0 ns
+} nv_stats_hist_t;
+
+typedef struct {
+    nv_stats_hist_t phase[NV_STATS_PHASE_MAX];    ///< latency per phase
+    uint64_t bytes_read;                          ///< nv file and log bytes
+    uint64_t bytes_written;                       ///< nv file and log bytes
+    uint64_t cache_hits;      ///< parsed tree still current, no reload
+    uint64_t cache_misses;    ///< parsed tree stale, reloaded
+} nv_stats_t;
+
 /**
  * nv_init
  * @param file nv file path
- * @param data nv json format data from file
+ * @param data nv json format data from file, nul terminated
+ * @param size data buffer size, nv_open has no size limit
  */
-void nv_init(const char* file, void* data);
+void nv_init(const char* file, void* data, size_t size);
 
 /**
  * nv_write to file
@@ -72,10 +274,11 @@ bool nv_write(const char* file, void* data);
 /**
  * nv_read from file
  * @param file nv file path
- * @param data data buffer
- * @return     boolean
+ * @param data data buffer, nul terminated
+ * @param size data buffer size, more than the file content
+ * @return     boolean, false if the content does not fit
  */
-bool nv_read(const char* file, void* data);
+bool nv_read(const char* file, void* data, size_t size);
 
 /**
  * nv_sync to file
@@ -100,6 +303,132 @@ void nv_sync(const char* file, char* key, void* value, uint32_t len,
 bool nv_get(const char* file, char* key, char* value, uint32_t len,
             nv_data_type_t type);
 
+/**
+ * nv_get_many, read many keys with one read and one parse of the file
+ * @param file    nv file path
+ * @param entries key descriptors, status set per entry
+ * @param count   number of entries
+ * @return        boolean, true if every entry is NV_STATUS_OK
+ */
+bool nv_get_many(const char* file, nv_entry_t* entries, size_t count);
+
+/**
+ * nv_sync_many, update many keys with one read, one parse and one write
+ * @param file    nv file path
+ * @param entries key descriptors, status set per entry
+ * @param count   number of entries
+ * @return        boolean, true if every entry is NV_STATUS_OK
+ */
+bool nv_sync_many(const char* file, nv_entry_t* entries, size_t count);
+
+/**
+ * nv_get_range, read array elements from offset without copying the others
+ * @param file   nv file path
+ * @param key    nv key
+ * @param offset first element
+ * @param value  data buffer of the array type
+ * @param count  buffer elements, fewer are read at the end of the array
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length, may be NULL
+ * @return       boolean, false if not an array or offset beyond its end
+ */
+bool nv_get_range(const char* file, const char* key, uint32_t offset,
+                  void* value, uint32_t count, nv_data_type_t type,
+                  uint32_t* length);
+
+/**
+ * nv_set_range, replace array elements from offset, the elements past the
+ * end are appended, the others are not touched
+ * @param file   nv file path
+ * @param key    nv key, created if offset is 0
+ * @param offset first element, at most the array length
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length after the update, may be NULL
+ * @return       boolean
+ */
+bool nv_set_range(const char* file, const char* key, uint32_t offset,
+                  void* value, uint32_t count, nv_data_type_t type,
+                  uint32_t* length);
+
+/**
+ * nv_append, add elements at the end of an array
+ * @param file   nv file path
+ * @param key    nv key, created if not exist
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length after the update, may be NULL
+ * @return       boolean
+ */
+bool nv_append(const char* file, const char* key, void* value, uint32_t count,
+               nv_data_type_t type, uint32_t* length);
+
+/**
+ * nv_get_blob, map a NV_DATA_BLOB value read-only without copying it, the
+ * bytes are read on access and nv_get checks the checksum of a copy
+ * @param file nv file path
+ * @param key  nv key
+ * @param blob mapping, release by nv_blob_release
+ * @return     boolean
+ */
+bool nv_get_blob(const char* file, const char* key, nv_blob_t* blob);
+
+/**
+ * nv_blob_release, unmap a blob of nv_get_blob or nv_store_get_blob
+ * @param blob mapping
+ */
+void nv_blob_release(nv_blob_t* blob);
+
+/**
+ * nv_load_struct, read every member of a struct with one read and one parse
+ * and one pass over the members of the file, members whose key does not exist
+ * keep their value, the keys of a schema are distinct
+ * @param file   nv file path
+ * @param schema struct schema, see NV_SCHEMA
+ * @param base   struct
+ * @return       boolean, true if every member was read
+ */
+bool nv_load_struct(const char* file, const nv_schema_t* schema, void* base);
+
+/**
+ * nv_store_struct, write every member of a struct with one write
+ * @param file   nv file path
+ * @param schema struct schema, see NV_SCHEMA
+ * @param base   struct
+ * @return       boolean, true if every member was written
+ */
+bool nv_store_struct(const char* file, const nv_schema_t* schema,
+                     const void* base);
+
+/**
+ * nv_sync_async, update value in memory and return without disk I/O
+ * a background thread writes the file every CONFIG_NV_FLUSH_INTERVAL_MS or
+ * once CONFIG_NV_FLUSH_DIRTY_SIZE bytes were updated, repeated updates of a
+ * key are written once, nv_get/nv_sync/nv_delete of this process see the
+ * pending value, other handles and processes once it is written
+ * @param file  nv file path
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_sync_async(const char* file, char* key, void* value, uint32_t len,
+                   nv_data_type_t type);
+
+/**
+ * nv_flush, ask the background thread to write nv_sync_async updates now
+ */
+void nv_flush(void);
+
+/**
+ * nv_flush_wait, write nv_sync_async updates made so far and wait for them
+ * @return boolean, false if a write fail
+ */
+bool nv_flush_wait(void);
+
 /**
  * nv_delete
  * @param file nv file path
@@ -108,6 +437,395 @@ bool nv_get(const char* file, char* key, char* value, uint32_t len,
  */
 bool nv_delete(const char* file, char* key);
 
+/**
+ * nv_convert, rewrite nv file with its log folded in, in another format
+ * @param src    source nv file path, format detected by content
+ * @param dst    destination nv file path
+ * @param format destination file format
+ * @return       boolean
+ */
+bool nv_convert(const char* src, const char* dst, nv_format_t format);
+
+/**
+ * nv_open, parse nv file once and keep the tree resident
+ * @param file nv file path, created on first flush if not exist
+ * @return     store handle, NULL on failure
+ */
+nv_store_t* nv_open(const char* file);
+
+/**
+ * nv_config_init, fill config with CONFIG_NV_* defaults
+ * @param config config
+ */
+void nv_config_init(nv_config_t* config);
+
+/**
+ * nv_open_config, nv_open with explicit store config
+ * in shared mode writers lock "<file>.lock" and write through, readers check
+ * the file stat and reparse only when another process changed it
+ * @param file   nv file path, created on first flush if not exist
+ * @param config store config, NULL for defaults
+ * @return       store handle, NULL on failure
+ */
+nv_store_t* nv_open_config(const char* file, const nv_config_t* config);
+
+/**
+ * nv_close, flush dirty data and release the store
+ * @param store store handle
+ * @return      boolean, false if dirty data flush fail
+ */
+bool nv_close(nv_store_t* store);
+
+/**
+ * nv_store_flush, write dirty data to file
+ * in wal mode only the changed keys are appended to "<file>.wal", the log is
+ * folded into the nv file once it grows beyond wal_compact_size
+ * @param store store handle
+ * @return      boolean
+ */
+bool nv_store_flush(nv_store_t* store);
+
+/**
+ * nv_store_compact, rewrite the nv file from memory and drop its log
+ * safe to call from a background thread owning the store, the live blobs
+ * move to a new sidecar and the space of replaced ones is given back, blobs
+ * of older snapshots can no longer be read afterwards
+ * @param store store handle
+ * @return      boolean
+ */
+bool nv_store_compact(nv_store_t* store);
+
+/**
+ * nv_store_sync, update value in memory, flushed by nv_store_flush or nv_close
+ * in thread safe mode the update is made on a copy of the tree and published
+ * atomically, writers are serialized and readers never block
+ * @param store store handle
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_store_sync(nv_store_t* store, const char* key, void* value,
+                   uint32_t len, nv_data_type_t type);
+
+/**
+ * nv_store_get
+ * in thread safe mode lock-free, readers see the last published version
+ * @param store store handle
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_store_get(nv_store_t* store, const char* key, char* value,
+                  uint32_t len, nv_data_type_t type);
+
+/**
+ * nv_store_delete
+ * @param store store handle
+ * @param key   nv key
+ * @return      boolean, false if key not exist
+ */
+bool nv_store_delete(nv_store_t* store, const char* key);
+
+/**
+ * nv_store_get_range, read array elements from offset
+ * @param store  store handle
+ * @param key    nv key
+ * @param offset first element
+ * @param value  data buffer of the array type
+ * @param count  buffer elements, fewer are read at the end of the array
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length, may be NULL
+ * @return       boolean, false if not an array or offset beyond its end
+ */
+bool nv_store_get_range(nv_store_t* store, const char* key, uint32_t offset,
+                        void* value, uint32_t count, nv_data_type_t type,
+                        uint32_t* length);
+
+/**
+ * nv_store_set_range, replace array elements from offset, the elements
+ * past the end are appended, with wal only the new elements are logged
+ * @param store  store handle
+ * @param key    nv key, created if offset is 0
+ * @param offset first element, at most the array length
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length after the update, may be NULL
+ * @return       boolean
+ */
+bool nv_store_set_range(nv_store_t* store, const char* key, uint32_t offset,
+                        void* value, uint32_t count, nv_data_type_t type,
+                        uint32_t* length);
+
+/**
+ * nv_store_append, add elements at the end of an array
+ * @param store  store handle
+ * @param key    nv key, created if not exist
+ * @param value  data buffer of the array type
+ * @param count  number of elements
+ * @param type   plain array data type, packed arrays fail with ENOTSUP
+ * @param length array length after the update, may be NULL
+ * @return       boolean
+ */
+bool nv_store_append(nv_store_t* store, const char* key, void* value,
+                     uint32_t count, nv_data_type_t type, uint32_t* length);
+
+/**
+ * nv_store_get_blob, map a NV_DATA_BLOB value read-only without copying it,
+ * the mapping stays valid after later updates and nv_close
+ * @param store store handle
+ * @param key   nv key
+ * @param blob  mapping, release by nv_blob_release
+ * @return      boolean
+ */
+bool nv_store_get_blob(nv_store_t* store, const char* key, nv_blob_t* blob);
+
+/**
+ * nv_snapshot, consistent read-only view of the store at this moment
+ * later updates do not change it, it pins the published version and shares
+ * its values, a store not opened thread safe publishes versions from its
+ * first snapshot on, so its later writes copy the members they change
+ * @param store store handle
+ * @return      snapshot, release by nv_snapshot_release before nv_close
+ */
+nv_snapshot_t* nv_snapshot(nv_store_t* store);
+
+/**
+ * nv_snapshot_get, read a value as it was when the snapshot was taken
+ * @param snapshot snapshot handle
+ * @param key      nv key
+ * @param value    data buffer
+ * @param len      data buffer length
+ * @param type     data type
+ * @return         boolean
+ */
+bool nv_snapshot_get(const nv_snapshot_t* snapshot, const char* key,
+                     char* value, uint32_t len, nv_data_type_t type);
+
+/**
+ * nv_snapshot_release, drop the view, the versions only it kept are freed
+ * @param snapshot snapshot handle, NULL ignored
+ */
+void nv_snapshot_release(nv_snapshot_t* snapshot);
+
+/**
+ * nv_checkpoint, write a snapshot of the store to another file in the
+ * store format, writers of the store are not blocked meanwhile, blobs are
+ * copied into a sidecar of the destination
+ * @param store store handle
+ * @param path  destination nv file path
+ * @return      boolean
+ */
+bool nv_checkpoint(nv_store_t* store, const char* path);
+
+/**
+ * nv_store_get_many, read many keys from one version of the tree
+ * @param store   store handle
+ * @param entries key descriptors, status set per entry
+ * @param count   number of entries
+ * @return        boolean, true if every entry is NV_STATUS_OK
+ */
+bool nv_store_get_many(nv_store_t* store, nv_entry_t* entries, size_t count);
+
+/**
+ * nv_store_sync_many, update many keys as one write, a shared store writes
+ * the file once
+ * @param store   store handle
+ * @param entries key descriptors, status set per entry
+ * @param count   number of entries
+ * @return        boolean, true if every entry is NV_STATUS_OK
+ */
+bool nv_store_sync_many(nv_store_t* store, nv_entry_t* entries, size_t count);
+
+/**
+ * nv_foreach, visit every key in case-insensitive key order
+ * the callback must not update the store
+ * @param store  store handle
+ * @param cursor resume point, zero initialized to start, NULL for none
+ * @param visit  callback
+ * @param arg    callback argument
+ * @return       boolean, false on failure
+ */
+bool nv_foreach(nv_store_t* store, nv_cursor_t* cursor, nv_visit_cb_t visit,
+                void* arg);
+
+/**
+ * nv_scan_prefix, visit the keys starting with prefix in key order
+ * keys are kept ordered, the range is found in O(log n), case-insensitive
+ * @param store  store handle
+ * @param prefix key prefix
+ * @param cursor resume point, zero initialized to start, NULL for none
+ * @param visit  callback
+ * @param arg    callback argument
+ * @return       boolean, false on failure
+ */
+bool nv_scan_prefix(nv_store_t* store, const char* prefix,
+                    nv_cursor_t* cursor, nv_visit_cb_t visit, void* arg);
+
+/**
+ * nv_cursor_free, release the resume point and start over
+ * @param cursor cursor
+ */
+void nv_cursor_free(nv_cursor_t* cursor);
+
+/**
+ * nv_item_get, read the value of a visited key
+ * @param item  value passed to nv_visit_cb_t
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_item_get(const nv_item_t* item, char* value, uint32_t len,
+                 nv_data_type_t type);
+
+/**
+ * nv_watch, subscribe to changes of a key
+ * local updates are reported after they took effect, updates of other
+ * processes when a shared store reloads the file
+ * @param store store handle
+ * @param key   nv key, "prefix*" for the keys starting with prefix, "*" for
+ *              every key
+ * @param cb    callback
+ * @param arg   callback argument
+ * @return      watch handle, NULL on failure
+ */
+nv_watch_t* nv_watch(nv_store_t* store, const char* key, nv_watch_cb_t cb,
+                     void* arg);
+
+/**
+ * nv_unwatch, cancel a subscription, undelivered patches of it are dropped
+ * @param store store handle
+ * @param watch watch handle
+ */
+void nv_unwatch(nv_store_t* store, nv_watch_t* watch);
+
+/**
+ * nv_watch_fd, descriptor readable when the nv file changed on disk
+ * poll it and call nv_watch_dispatch, linux inotify only
+ * @param store store handle
+ * @return      file descriptor, -1 if not supported
+ */
+int nv_watch_fd(nv_store_t* store);
+
+/**
+ * nv_watch_dispatch, consume file change events, reload a store another
+ * writer changed and deliver the patches of the watched keys, a store not
+ * shared keeps its updates not written yet and skips the reload
+ * @param store store handle
+ * @return      boolean, false on failure
+ */
+bool nv_watch_dispatch(nv_store_t* store);
+
+/**
+ * nv_txn_begin, read and parse nv file once for a batch of updates
+ * @param file nv file path
+ * @return     transaction handle, NULL on failure
+ */
+nv_txn_t* nv_txn_begin(const char* file);
+
+/**
+ * nv_txn_sync, update value in the transaction
+ * @param txn   transaction handle
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      boolean
+ */
+bool nv_txn_sync(nv_txn_t* txn, const char* key, void* value, uint32_t len,
+                 nv_data_type_t type);
+
+/**
+ * nv_txn_delete, delete key in the transaction
+ * @param txn transaction handle
+ * @param key nv key
+ * @return    boolean, false if key not exist
+ */
+bool nv_txn_delete(nv_txn_t* txn, const char* key);
+
+/**
+ * nv_txn_commit, write the whole batch to file once and release it
+ * @param txn transaction handle
+ * @return    boolean, on failure the transaction stays open for another
+ *            commit or nv_txn_abort
+ */
+bool nv_txn_commit(nv_txn_t* txn);
+
+/**
+ * nv_txn_abort, discard the batch and release it
+ * @param txn transaction handle
+ */
+void nv_txn_abort(nv_txn_t* txn);
+
+/**
+ * nv_registry_create, map nv file paths to stores kept open and parsed
+ * when the estimated tree memory of all stores exceeds budget, the least
+ * recently used stores nobody holds are flushed and closed
+ * @param config store config of every opened store, NULL for defaults
+ * @param budget estimated tree bytes kept open
+ * @return       registry handle, NULL on failure
+ */
+nv_registry_t* nv_registry_create(const nv_config_t* config, size_t budget);
+
+/**
+ * nv_registry_open, store of the path, parsed on first use
+ * the registry may be used by many threads, the store only if its config
+ * is thread safe, files are parsed and flushed outside the registry lock
+ * @param registry registry handle
+ * @param file     nv file path
+ * @return         store handle, release by nv_registry_close, not nv_close
+ */
+nv_store_t* nv_registry_open(nv_registry_t* registry, const char* file);
+
+/**
+ * nv_registry_close, release a store of nv_registry_open, it stays open
+ * until evicted or the registry is destroyed
+ * @param registry registry handle
+ * @param store    store handle
+ */
+void nv_registry_close(nv_registry_t* registry, nv_store_t* store);
+
+/**
+ * nv_registry_flush, flush every dirty store
+ * @param registry registry handle
+ * @return         boolean, false if any flush fail
+ */
+bool nv_registry_flush(nv_registry_t* registry);
+
+/**
+ * nv_registry_destroy, flush and close every store, none may be in use
+ * @param registry registry handle
+ * @return         boolean, false if any flush fail
+ */
+bool nv_registry_destroy(nv_registry_t* registry);
+
+/**
+ * nv_stats_get, operation statistics, needs CONFIG_NV_STATS
+ * @param store store handle, NULL for the totals of the process
+ * @param stats statistics snapshot
+ * @return      boolean, false if statistics are compiled out
+ */
+bool nv_stats_get(nv_store_t* store, nv_stats_t* stats);
+
+/**
+ * nv_stats_reset, clear operation statistics
+ * @param store store handle, NULL for the totals of the process
+ */
+void nv_stats_reset(nv_store_t* store);
+
+/**
+ * nv_stats_percentile, latency percentile estimated from the histogram
+ * @param hist  phase histogram
+ * @param ratio percentile as ratio, 0.99 for p99
+ * @return      upper bound of the bucket holding the percentile, ns
+ */
+uint64_t nv_stats_percentile(const nv_stats_hist_t* hist, double ratio);
+
 #ifdef __cplusplus
 }
 #endif
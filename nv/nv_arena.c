@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_arena.h"
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cJSON.h"
+
+#define NV_ARENA_ALIGN alignof(max_align_t)
+#define NV_ARENA_DEPTH 16
+
+struct nv_arena_chunk {
+    nv_arena_chunk_t* next;            ///< older chunk
+    size_t size;                       ///< data bytes
+    size_t used;                       ///< data bytes handed out
+    alignas(max_align_t) char data[];
+};
+
+static pthread_once_t nv_arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t nv_arena_key;
+
+static _Thread_local nv_arena_t* nv_arena_current;
+static _Thread_local nv_arena_t nv_arena_thread;
+
+/* arenas entered on this thread, outermost first, their memory may be
+ * freed by cJSON while an inner one is current */
+static _Thread_local nv_arena_t* nv_arena_stack[NV_ARENA_DEPTH];
+static _Thread_local size_t nv_arena_depth;
+
+/**
+ * nv_arena_owns
+ */
+static bool nv_arena_owns(const nv_arena_t* arena, const void* ptr)
+{
+    for (nv_arena_chunk_t* chunk = arena->head; chunk; chunk = chunk->next) {
+        if ((const char*)ptr >= chunk->data
+            && (const char*)ptr < chunk->data + chunk->size) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * nv_arena_entered, arena is entered on this thread, nested scopes beyond
+ * NV_ARENA_DEPTH are only seen while current
+ */
+static bool nv_arena_entered(const nv_arena_t* arena)
+{
+    size_t depth = nv_arena_depth < NV_ARENA_DEPTH ? nv_arena_depth
+                                                   : NV_ARENA_DEPTH;
+
+    for (size_t i = 0; i < depth; i++) {
+        if (nv_arena_stack[i] == arena) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static nv_arena_chunk_t* nv_arena_chunk_new(size_t size)
+{
+    nv_arena_chunk_t* chunk = malloc(sizeof(nv_arena_chunk_t) + size);
+    if (chunk) {
+        chunk->next = NULL;
+        chunk->size = size;
+        chunk->used = 0;
+    }
+
+    return chunk;
+}
+
+static void* nv_arena_alloc(nv_arena_t* arena, size_t size)
+{
+    size = (size + NV_ARENA_ALIGN - 1) & ~(NV_ARENA_ALIGN - 1);
+
+    nv_arena_chunk_t* chunk = arena->head;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        /* double the chunk size with the arena, so frees scan few chunks */
+        size_t chunk_size = CONFIG_NV_ARENA_CHUNK_SIZE;
+        while (chunk_size < size || chunk_size < arena->total) {
+            chunk_size *= 2;
+        }
+
+        chunk = nv_arena_chunk_new(chunk_size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+
+        chunk->next = arena->head;
+        arena->head = chunk;
+    }
+
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->total += size;
+
+    return ptr;
+}
+
+static void* nv_arena_hook_malloc(size_t size)
+{
+    if (nv_arena_current) {
+        return nv_arena_alloc(nv_arena_current, size);
+    }
+
+    return malloc(size);
+}
+
+static void nv_arena_hook_free(void* ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (nv_arena_current && nv_arena_owns(nv_arena_current, ptr)) {
+        return;
+    }
+
+    /* memory of an outer scope is released by the reset of its arena */
+    size_t depth = nv_arena_depth < NV_ARENA_DEPTH ? nv_arena_depth
+                                                   : NV_ARENA_DEPTH;
+    for (size_t i = depth; i-- > 0;) {
+        if (nv_arena_owns(nv_arena_stack[i], ptr)) {
+            return;
+        }
+    }
+
+    free(ptr);
+}
+
+static void nv_arena_thread_exit(void* arena)
+{
+    nv_arena_free(arena);
+}
+
+static void nv_arena_init(void)
+{
+    cJSON_Hooks hooks = { nv_arena_hook_malloc, nv_arena_hook_free };
+
+    /* outside an arena the hooks behave like plain malloc and free */
+    cJSON_InitHooks(&hooks);
+    pthread_key_create(&nv_arena_key, nv_arena_thread_exit);
+}
+
+/**
+ * nv_arena_enter, route cJSON allocations of this thread to arena
+ * @param arena arena, NULL for the per-thread arena, reset when its
+ *              outermost scope leaves
+ * @return      arena entered before, pass to nv_arena_leave
+ */
+nv_arena_t* nv_arena_enter(nv_arena_t* arena)
+{
+    pthread_once(&nv_arena_once, nv_arena_init);
+
+    if (arena == NULL) {
+        arena = &nv_arena_thread;
+        pthread_setspecific(nv_arena_key, arena);
+    }
+
+    if (nv_arena_depth < NV_ARENA_DEPTH) {
+        nv_arena_stack[nv_arena_depth] = arena;
+    }
+    nv_arena_depth++;
+
+    nv_arena_t* previous = nv_arena_current;
+    nv_arena_current = arena;
+
+    return previous;
+}
+
+/**
+ * nv_arena_leave, restore the previous arena
+ * @param previous return value of nv_arena_enter
+ */
+void nv_arena_leave(nv_arena_t* previous)
+{
+    nv_arena_t* arena = nv_arena_current;
+
+    if (nv_arena_depth > 0) {
+        nv_arena_depth--;
+    }
+    nv_arena_current = previous;
+
+    /* a nested scope leaves the memory to the outermost one */
+    if (arena == &nv_arena_thread && nv_arena_entered(arena) == false) {
+        nv_arena_reset(&nv_arena_thread);
+    }
+}
+
+/**
+ * nv_arena_reset, release all allocations at once, keep one chunk for reuse
+ * @param arena arena
+ */
+void nv_arena_reset(nv_arena_t* arena)
+{
+    size_t total = arena->total;
+    nv_arena_chunk_t* keep = arena->head;
+
+    /* several chunks mean the next run of the same size wants one bigger */
+    if (keep && (keep->next || keep->size > CONFIG_NV_ARENA_KEEP_SIZE)) {
+        nv_arena_free(arena);
+        keep = NULL;
+
+        if (total > CONFIG_NV_ARENA_CHUNK_SIZE
+            && total <= CONFIG_NV_ARENA_KEEP_SIZE) {
+            keep = nv_arena_chunk_new(total);
+        }
+    }
+
+    if (keep) {
+        keep->used = 0;
+    }
+
+    arena->head = keep;
+    arena->total = 0;
+}
+
+/**
+ * nv_arena_free, release all chunks
+ * @param arena arena
+ */
+void nv_arena_free(nv_arena_t* arena)
+{
+    nv_arena_chunk_t* chunk = arena->head;
+
+    while (chunk) {
+        nv_arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->head = NULL;
+    arena->total = 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_ARENA_H_
+#define _NV_ARENA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_NV_ARENA_CHUNK_SIZE
+#define CONFIG_NV_ARENA_CHUNK_SIZE 65536
+#endif
+
+#ifndef CONFIG_NV_ARENA_KEEP_SIZE
+#define CONFIG_NV_ARENA_KEEP_SIZE 1048576
+#endif
+
+typedef struct nv_arena_chunk nv_arena_chunk_t;
+
+/*
+ * Bump pointer arena for cJSON nodes and strings. While an arena is entered
+ * on a thread, cJSON allocations of that thread come from it, cJSON_free of
+ * the memory of any arena entered on the thread is a no-op and everything
+ * is released by one reset.
+ */
+typedef struct {
+    nv_arena_chunk_t* head;    ///< newest chunk first
+    size_t total;              ///< bytes handed out since the last reset
+} nv_arena_t;
+
+/**
+ * nv_arena_enter, route cJSON allocations of this thread to arena
+ * @param arena arena, NULL for the per-thread arena, reset when its
+ *              outermost scope leaves
+ * @return      arena entered before, pass to nv_arena_leave
+ */
+nv_arena_t* nv_arena_enter(nv_arena_t* arena);
+
+/**
+ * nv_arena_leave, restore the previous arena
+ * @param previous return value of nv_arena_enter
+ */
+void nv_arena_leave(nv_arena_t* previous);
+
+/**
+ * nv_arena_reset, release all allocations at once, keep one chunk for reuse
+ * @param arena arena
+ */
+void nv_arena_reset(nv_arena_t* arena);
+
+/**
+ * nv_arena_free, release all chunks
+ * @param arena arena
+ */
+void nv_arena_free(nv_arena_t* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_ARENA_H_ */
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_base64.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef CONFIG_NV_SIMD
+#define CONFIG_NV_SIMD 0
+#endif
+
+#if CONFIG_NV_SIMD && (defined(__x86_64__) || defined(__i386__)) \
+    && defined(__GNUC__)
+#define NV_BASE64_X86 1
+#include <immintrin.h>
+#else
+#define NV_BASE64_X86 0
+#endif
+
+static const char nv_base64_alphabet[]
+    = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* 6-bit value of each ascii character, -1 if not in the alphabet */
+static const int8_t nv_base64_values[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+};
+
+/**
+ * nv_base64_value, 6-bit value of a base64 character
+ * @param c character
+ * @return  value, -1 if not in the alphabet
+ */
+static inline int nv_base64_value(unsigned char c)
+{
+    return c < 128 ? nv_base64_values[c] : -1;
+}
+
+#if NV_BASE64_X86
+/**
+ * nv_base64_encode_ssse3, encode 12 bytes into 16 characters per step
+ * @return raw bytes consumed, a multiple of 12
+ */
+__attribute__((target("ssse3"))) static size_t
+nv_base64_encode_ssse3(char* dst, const uint8_t* src, size_t size)
+{
+    const __m128i shuffle
+        = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4,
+                                          -4, -4, -4, -19, -16, 0, 0);
+    size_t done = 0;
+
+    /* every load reads 16 bytes and uses 12 */
+    while (size - done >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + done));
+
+        /* spread 3 bytes over the low 6 bits of 4 bytes */
+        in = _mm_shuffle_epi8(in, shuffle);
+        __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+        __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+        __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(t1, t3);
+
+        /* add the offset of the alphabet range of each value */
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i lower = _mm_cmpgt_epi8(indices, _mm_set1_epi8(25));
+        range = _mm_sub_epi8(range, lower);
+        __m128i out
+            = _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range));
+
+        _mm_storeu_si128((__m128i*)dst, out);
+        dst += 16;
+        done += 12;
+    }
+
+    return done;
+}
+
+/**
+ * nv_base64_decode_ssse3, decode 16 characters into 12 bytes per step, stop
+ * before padding or an invalid character
+ * @return characters consumed, a multiple of 16
+ */
+__attribute__((target("ssse3"))) static size_t
+nv_base64_decode_ssse3(uint8_t* dst, size_t cap, const char* src, size_t len)
+{
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                         0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08,
+                                         0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                         0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                           0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2F);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                       -1, -1, -1, -1);
+    size_t done = 0;
+    size_t written = 0;
+
+    /* every store writes 16 bytes of which 12 are output */
+    while (len - done >= 16 && cap - written >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + done));
+
+        /* a character is valid if its nibble classes do not intersect */
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+        __m128i lo_nibbles = _mm_and_si128(in, mask_2f);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        __m128i invalid = _mm_cmpeq_epi8(_mm_and_si128(lo, hi),
+                                         _mm_setzero_si128());
+        if (_mm_movemask_epi8(invalid) != 0xFFFF) {
+            break;
+        }
+
+        __m128i eq_2f = _mm_cmpeq_epi8(in, mask_2f);
+        __m128i roll
+            = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+        in = _mm_add_epi8(in, roll);
+
+        /* join 4 values of 6 bits into 3 bytes */
+        __m128i merged = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+        __m128i out = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        out = _mm_shuffle_epi8(out, pack);
+
+        _mm_storeu_si128((__m128i*)(dst + written), out);
+        written += 12;
+        done += 16;
+    }
+
+    return done;
+}
+
+/**
+ * nv_base64_simd, CPU has SSSE3, checked once
+ * @return boolean
+ */
+static bool nv_base64_simd(void)
+{
+    /* every thread computes the same answer, no ordering needed */
+    static atomic_int simd = -1;
+
+    int value = atomic_load_explicit(&simd, memory_order_relaxed);
+    if (value < 0) {
+        __builtin_cpu_init();
+        value = __builtin_cpu_supports("ssse3") ? 1 : 0;
+        atomic_store_explicit(&simd, value, memory_order_relaxed);
+    }
+
+    return value;
+}
+#endif /* NV_BASE64_X86 */
+
+/**
+ * nv_base64_encoded_size, encoded length of size bytes, without nul
+ * @param size raw bytes
+ * @return     base64 characters
+ */
+size_t nv_base64_encoded_size(size_t size)
+{
+    return (size + 2) / 3 * 4;
+}
+
+/**
+ * nv_base64_encode, standard alphabet with padding, nul terminated
+ * @param dst  output, nv_base64_encoded_size(size) + 1 bytes
+ * @param src  raw bytes
+ * @param size raw bytes
+ */
+void nv_base64_encode(char* dst, const void* src, size_t size)
+{
+    const uint8_t* in = src;
+    size_t i = 0;
+
+#if NV_BASE64_X86
+    if (nv_base64_simd()) {
+        i = nv_base64_encode_ssse3(dst, in, size);
+        dst += i / 3 * 4;
+    }
+#endif
+
+    for (; size - i >= 3; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | in[i + 1] << 8 | in[i + 2];
+        *dst++ = nv_base64_alphabet[v >> 18];
+        *dst++ = nv_base64_alphabet[(v >> 12) & 0x3F];
+        *dst++ = nv_base64_alphabet[(v >> 6) & 0x3F];
+        *dst++ = nv_base64_alphabet[v & 0x3F];
+    }
+
+    if (size - i == 1) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        *dst++ = nv_base64_alphabet[v >> 18];
+        *dst++ = nv_base64_alphabet[(v >> 12) & 0x3F];
+        *dst++ = '=';
+        *dst++ = '=';
+    } else if (size - i == 2) {
+        uint32_t v = (uint32_t)in[i] << 16 | in[i + 1] << 8;
+        *dst++ = nv_base64_alphabet[v >> 18];
+        *dst++ = nv_base64_alphabet[(v >> 12) & 0x3F];
+        *dst++ = nv_base64_alphabet[(v >> 6) & 0x3F];
+        *dst++ = '=';
+    }
+
+    *dst = '\0';
+}
+
+/**
+ * nv_base64_decode, decode standard base64 with padding
+ * @param dst  output
+ * @param cap  output bytes, decoding stops when it is full
+ * @param src  base64 text, not nul terminated
+ * @param len  base64 characters
+ * @param size decoded bytes of the whole text
+ * @return     boolean, false on invalid text
+ */
+bool nv_base64_decode(void* dst, size_t cap, const char* src, size_t len,
+                      size_t* size)
+{
+    uint8_t* out = dst;
+
+    if (len % 4 != 0) {
+        return false;
+    }
+
+    size_t padding = 0;
+    if (len && src[len - 1] == '=') {
+        padding = src[len - 2] == '=' ? 2 : 1;
+    }
+
+    size_t total = len / 4 * 3 - padding;
+    if (size) {
+        *size = total;
+    }
+
+    /* the vector stores overrun their output, keep them within the data so
+     * caller bytes past it stay untouched */
+    if (cap > total) {
+        cap = total;
+    }
+
+    size_t i = 0;
+    size_t written = 0;
+
+#if NV_BASE64_X86
+    if (nv_base64_simd()) {
+        i = nv_base64_decode_ssse3(out, cap, src, len);
+        written = i / 4 * 3;
+    }
+#endif
+
+    /* whole quanta straight into the output, padding and a short tail
+     * below */
+    size_t full = padding ? len - 4 : len;
+    for (; i < full && cap - written >= 3; i += 4) {
+        int a = nv_base64_value(src[i]);
+        int b = nv_base64_value(src[i + 1]);
+        int c = nv_base64_value(src[i + 2]);
+        int d = nv_base64_value(src[i + 3]);
+        if ((a | b | c | d) < 0) {
+            return false;
+        }
+
+        uint32_t v = (uint32_t)a << 18 | b << 12 | c << 6 | d;
+        out[written] = v >> 16;
+        out[written + 1] = (v >> 8) & 0xFF;
+        out[written + 2] = v & 0xFF;
+        written += 3;
+    }
+
+    for (; i < len && written < cap; i += 4) {
+        int a = nv_base64_value(src[i]);
+        int b = nv_base64_value(src[i + 1]);
+        int c = nv_base64_value(src[i + 2]);
+        int d = nv_base64_value(src[i + 3]);
+        bool last = i + 4 == len;
+
+        /* padding only ends the last quantum */
+        if (last && padding >= 1) {
+            d = 0;
+        }
+        if (last && padding == 2) {
+            c = 0;
+        }
+
+        if (a < 0 || b < 0 || c < 0 || d < 0) {
+            return false;
+        }
+
+        uint32_t v = (uint32_t)a << 18 | b << 12 | c << 6 | d;
+        uint8_t bytes[3] = { v >> 16, (v >> 8) & 0xFF, v & 0xFF };
+        size_t n = last ? 3 - padding : 3;
+        if (n > cap - written) {
+            n = cap - written;
+        }
+
+        memcpy(out + written, bytes, n);
+        written += n;
+    }
+
+    return true;
+}
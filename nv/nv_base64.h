@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_BASE64_H_
+#define _NV_BASE64_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * nv_base64_encoded_size, encoded length of size bytes, without nul
+ * @param size raw bytes
+ * @return     base64 characters
+ */
+size_t nv_base64_encoded_size(size_t size);
+
+/**
+ * nv_base64_encode, standard alphabet with padding, nul terminated
+ * with CONFIG_NV_SIMD on x86 12 bytes per step by SSSE3 if the CPU has it
+ * @param dst  output, nv_base64_encoded_size(size) + 1 bytes
+ * @param src  raw bytes
+ * @param size raw bytes
+ */
+void nv_base64_encode(char* dst, const void* src, size_t size);
+
+/**
+ * nv_base64_decode, decode standard base64 with padding
+ * with CONFIG_NV_SIMD on x86 16 characters per step by SSSE3 if the CPU
+ * has it
+ * @param dst  output
+ * @param cap  output bytes, decoding stops when it is full
+ * @param src  base64 text, not nul terminated
+ * @param len  base64 characters
+ * @param size decoded bytes of the whole text
+ * @return     boolean, false on invalid text
+ */
+bool nv_base64_decode(void* dst, size_t cap, const char* src, size_t len,
+                      size_t* size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_BASE64_H_ */
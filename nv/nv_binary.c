@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Binary file layout, all integers little endian:
+ *
+ *   "NVB\x01" value
+ *
+ *   value  := tag payload
+ *   NULL, FALSE, TRUE   no payload
+ *   INT                 zigzag varint, integral number within 2^53
+ *   DOUBLE              8 bytes IEEE 754
+ *   U64, S64            varint / zigzag varint, exact 64-bit integer
+ *   RAW, STRING         varint length, bytes
+ *   ARRAY               varint count, value * count
+ *   OBJECT              varint count, (varint length, key bytes, value) * count
+ */
+
+#include "nv_binary.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nv.h"
+
+#define NV_BINARY_MAX_SAFE_INT 9007199254740992.0    // 2^53
+#define NV_BINARY_MAX_DEPTH    1000
+
+enum {
+    NV_BINARY_NULL = 0,
+    NV_BINARY_FALSE,
+    NV_BINARY_TRUE,
+    NV_BINARY_INT,
+    NV_BINARY_DOUBLE,
+    NV_BINARY_U64,
+    NV_BINARY_S64,
+    NV_BINARY_RAW,
+    NV_BINARY_STRING,
+    NV_BINARY_ARRAY,
+    NV_BINARY_OBJECT,
+};
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} nv_binary_writer_t;
+
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+    size_t off;
+} nv_binary_reader_t;
+
+static bool nv_binary_reserve(nv_binary_writer_t* writer, size_t size)
+{
+    if (writer->len + size <= writer->cap) {
+        return true;
+    }
+
+    size_t cap = writer->cap ? writer->cap : 256;
+    while (cap < writer->len + size) {
+        cap *= 2;
+    }
+
+    char* data = cJSON_malloc(cap);
+    if (data == NULL) {
+        return false;
+    }
+
+    if (writer->data) {
+        memcpy(data, writer->data, writer->len);
+        cJSON_free(writer->data);
+    }
+
+    writer->data = data;
+    writer->cap = cap;
+    return true;
+}
+
+static bool nv_binary_put(nv_binary_writer_t* writer, const void* data,
+                          size_t len)
+{
+    if (nv_binary_reserve(writer, len) == false) {
+        return false;
+    }
+
+    memcpy(writer->data + writer->len, data, len);
+    writer->len += len;
+    return true;
+}
+
+static bool nv_binary_put_tag(nv_binary_writer_t* writer, uint8_t tag)
+{
+    return nv_binary_put(writer, &tag, 1);
+}
+
+static bool nv_binary_put_varint(nv_binary_writer_t* writer, uint64_t value)
+{
+    uint8_t buf[10];
+    size_t len = 0;
+
+    do {
+        buf[len] = value & 0x7f;
+        value >>= 7;
+        if (value) {
+            buf[len] |= 0x80;
+        }
+        len++;
+    } while (value);
+
+    return nv_binary_put(writer, buf, len);
+}
+
+static uint64_t nv_binary_zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t nv_binary_unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static bool nv_binary_put_bytes(nv_binary_writer_t* writer, const char* str)
+{
+    size_t len = strlen(str);
+
+    return nv_binary_put_varint(writer, len)
+        && nv_binary_put(writer, str, len);
+}
+
+static bool nv_binary_put_double(nv_binary_writer_t* writer, double value)
+{
+    uint64_t bits;
+    uint8_t buf[8];
+
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++) {
+        buf[i] = bits >> (i * 8);
+    }
+
+    return nv_binary_put(writer, buf, sizeof(buf));
+}
+
+/**
+ * nv_binary_put_raw, raw items hold 64-bit integers beyond double precision
+ */
+static bool nv_binary_put_raw(nv_binary_writer_t* writer, const char* raw)
+{
+    char* end = NULL;
+
+    if (raw[0] == '-') {
+        int64_t value = strtoll(raw, &end, 10);
+        if (end != raw && *end == '\0') {
+            return nv_binary_put_tag(writer, NV_BINARY_S64)
+                && nv_binary_put_varint(writer, nv_binary_zigzag(value));
+        }
+    } else {
+        uint64_t value = strtoull(raw, &end, 10);
+        if (end != raw && *end == '\0') {
+            return nv_binary_put_tag(writer, NV_BINARY_U64)
+                && nv_binary_put_varint(writer, value);
+        }
+    }
+
+    return nv_binary_put_tag(writer, NV_BINARY_RAW)
+        && nv_binary_put_bytes(writer, raw);
+}
+
+static bool nv_binary_put_value(nv_binary_writer_t* writer, const cJSON* item)
+{
+    const cJSON* child = NULL;
+    size_t count = 0;
+
+    switch (item->type & 0xff) {
+    case cJSON_NULL:
+        return nv_binary_put_tag(writer, NV_BINARY_NULL);
+    case cJSON_False:
+        return nv_binary_put_tag(writer, NV_BINARY_FALSE);
+    case cJSON_True:
+        return nv_binary_put_tag(writer, NV_BINARY_TRUE);
+    case cJSON_Number: {
+        double value = item->valuedouble;
+        if (value < NV_BINARY_MAX_SAFE_INT && value > -NV_BINARY_MAX_SAFE_INT
+            && value == (double)(int64_t)value) {
+            return nv_binary_put_tag(writer, NV_BINARY_INT)
+                && nv_binary_put_varint(writer,
+                                        nv_binary_zigzag((int64_t)value));
+        }
+        return nv_binary_put_tag(writer, NV_BINARY_DOUBLE)
+            && nv_binary_put_double(writer, value);
+    }
+    case cJSON_Raw:
+        return nv_binary_put_raw(writer, item->valuestring);
+    case cJSON_String:
+        return nv_binary_put_tag(writer, NV_BINARY_STRING)
+            && nv_binary_put_bytes(writer, item->valuestring);
+    case cJSON_Array:
+    case cJSON_Object: {
+        bool object = cJSON_IsObject(item);
+
+        cJSON_ArrayForEach(child, item) {
+            count++;
+        }
+
+        if (nv_binary_put_tag(writer,
+                              object ? NV_BINARY_OBJECT : NV_BINARY_ARRAY)
+                == false
+            || nv_binary_put_varint(writer, count) == false) {
+            return false;
+        }
+
+        cJSON_ArrayForEach(child, item) {
+            if (object && nv_binary_put_bytes(writer, child->string) == false) {
+                return false;
+            }
+
+            if (nv_binary_put_value(writer, child) == false) {
+                return false;
+            }
+        }
+        return true;
+    }
+    default:
+        nv_log("unknown cJSON type %d\n", item->type);
+        return false;
+    }
+}
+
+/**
+ * nv_binary_encode, serialize tree to binary file content
+ * @param json tree
+ * @param len  content length
+ * @return     content allocated by cJSON_malloc, NULL on failure
+ */
+char* nv_binary_encode(const cJSON* json, size_t* len)
+{
+    nv_binary_writer_t writer = { 0 };
+
+    if (nv_binary_put(&writer, NV_BINARY_MAGIC, NV_BINARY_MAGIC_LEN) == false
+        || nv_binary_put_value(&writer, json) == false) {
+        cJSON_free(writer.data);
+        return NULL;
+    }
+
+    *len = writer.len;
+    return writer.data;
+}
+
+static bool nv_binary_get_varint(nv_binary_reader_t* reader, uint64_t* value)
+{
+    *value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (reader->off >= reader->len) {
+            return false;
+        }
+
+        uint8_t byte = reader->data[reader->off++];
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * nv_binary_get_bytes, copy a length prefixed string into cJSON memory
+ */
+static char* nv_binary_get_bytes(nv_binary_reader_t* reader)
+{
+    uint64_t len = 0;
+
+    if (nv_binary_get_varint(reader, &len) == false
+        || len > reader->len - reader->off) {
+        return NULL;
+    }
+
+    char* str = cJSON_malloc(len + 1);
+    if (str) {
+        memcpy(str, reader->data + reader->off, len);
+        str[len] = '\0';
+        reader->off += len;
+    }
+
+    return str;
+}
+
+static cJSON* nv_binary_get_value(nv_binary_reader_t* reader, int depth)
+{
+    uint64_t value = 0;
+    cJSON* item = NULL;
+
+    if (reader->off >= reader->len || depth > NV_BINARY_MAX_DEPTH) {
+        return NULL;
+    }
+
+    uint8_t tag = reader->data[reader->off++];
+    switch (tag) {
+    case NV_BINARY_NULL:
+        return cJSON_CreateNull();
+    case NV_BINARY_FALSE:
+        return cJSON_CreateFalse();
+    case NV_BINARY_TRUE:
+        return cJSON_CreateTrue();
+    case NV_BINARY_INT:
+        if (nv_binary_get_varint(reader, &value) == false) {
+            return NULL;
+        }
+        return cJSON_CreateNumber((double)nv_binary_unzigzag(value));
+    case NV_BINARY_DOUBLE: {
+        uint64_t bits = 0;
+        double number;
+
+        if (reader->len - reader->off < 8) {
+            return NULL;
+        }
+
+        for (int i = 0; i < 8; i++) {
+            bits |= (uint64_t)reader->data[reader->off + i] << (i * 8);
+        }
+        reader->off += 8;
+
+        memcpy(&number, &bits, sizeof(number));
+        return cJSON_CreateNumber(number);
+    }
+    case NV_BINARY_U64:
+    case NV_BINARY_S64: {
+        char str[24];
+
+        if (nv_binary_get_varint(reader, &value) == false) {
+            return NULL;
+        }
+
+        if (tag == NV_BINARY_U64) {
+            snprintf(str, sizeof(str), "%" PRIu64, value);
+        } else {
+            snprintf(str, sizeof(str), "%" PRId64, nv_binary_unzigzag(value));
+        }
+        return cJSON_CreateRaw(str);
+    }
+    case NV_BINARY_RAW:
+    case NV_BINARY_STRING: {
+        char* str = nv_binary_get_bytes(reader);
+        if (str == NULL) {
+            return NULL;
+        }
+
+        /* hand the copied bytes over instead of duplicating them again */
+        item = cJSON_CreateNull();
+        if (item == NULL) {
+            cJSON_free(str);
+            return NULL;
+        }
+
+        item->type = tag == NV_BINARY_RAW ? cJSON_Raw : cJSON_String;
+        item->valuestring = str;
+        return item;
+    }
+    case NV_BINARY_ARRAY:
+    case NV_BINARY_OBJECT: {
+        uint64_t count = 0;
+
+        if (nv_binary_get_varint(reader, &count) == false) {
+            return NULL;
+        }
+
+        item = tag == NV_BINARY_OBJECT ? cJSON_CreateObject()
+                                       : cJSON_CreateArray();
+        if (item == NULL) {
+            return NULL;
+        }
+
+        for (uint64_t i = 0; i < count; i++) {
+            char* key = NULL;
+
+            if (tag == NV_BINARY_OBJECT) {
+                key = nv_binary_get_bytes(reader);
+                if (key == NULL) {
+                    goto fail;
+                }
+            }
+
+            cJSON* child = nv_binary_get_value(reader, depth + 1);
+            if (child == NULL) {
+                cJSON_free(key);
+                goto fail;
+            }
+
+            child->string = key;
+            cJSON_AddItemToArray(item, child);
+        }
+        return item;
+    }
+    default:
+        nv_log("unknown binary tag %d\n", tag);
+        return NULL;
+    }
+
+fail:
+    cJSON_Delete(item);
+    return NULL;
+}
+
+/**
+ * nv_binary_match, check binary file magic
+ * @param data file content
+ * @param len  file content length
+ * @return     boolean
+ */
+bool nv_binary_match(const char* data, size_t len)
+{
+    return len >= NV_BINARY_MAGIC_LEN
+        && memcmp(data, NV_BINARY_MAGIC, NV_BINARY_MAGIC_LEN) == 0;
+}
+
+/**
+ * nv_binary_decode, build tree from binary file content
+ * @param data file content
+ * @param len  file content length
+ * @return     tree, NULL if content invalid
+ */
+cJSON* nv_binary_decode(const char* data, size_t len)
+{
+    if (nv_binary_match(data, len) == false) {
+        return NULL;
+    }
+
+    nv_binary_reader_t reader = {
+        .data = (const uint8_t*)data,
+        .len = len,
+        .off = NV_BINARY_MAGIC_LEN,
+    };
+
+    cJSON* json = nv_binary_get_value(&reader, 0);
+    if (json && reader.off != reader.len) {
+        nv_log("binary trailing %zu bytes\n", reader.len - reader.off);
+        cJSON_Delete(json);
+        return NULL;
+    }
+
+    return json;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_BINARY_H_
+#define _NV_BINARY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NV_BINARY_MAGIC     "NVB\x01"
+#define NV_BINARY_MAGIC_LEN 4
+
+/**
+ * nv_binary_match, check binary file magic
+ * @param data file content
+ * @param len  file content length
+ * @return     boolean
+ */
+bool nv_binary_match(const char* data, size_t len);
+
+/**
+ * nv_binary_decode, build tree from binary file content
+ * @param data file content
+ * @param len  file content length
+ * @return     tree, NULL if content invalid
+ */
+cJSON* nv_binary_decode(const char* data, size_t len);
+
+/**
+ * nv_binary_encode, serialize tree to binary file content
+ * @param json tree
+ * @param len  content length
+ * @return     content allocated by cJSON_malloc, NULL on failure
+ */
+char* nv_binary_encode(const cJSON* json, size_t* len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_BINARY_H_ */
@@ -0,0 +1,588 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_blob.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nv_durable.h"
+#include "nv_stats.h"
+
+#define NV_BLOB_KEY_NAME   "blob"
+#define NV_BLOB_KEY_OFFSET "offset"
+#define NV_BLOB_KEY_LENGTH "length"
+#define NV_BLOB_KEY_CRC32  "crc32"
+
+static pthread_once_t nv_blob_once = PTHREAD_ONCE_INIT;
+static uint32_t nv_blob_table[256];
+
+static void nv_blob_table_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        }
+        nv_blob_table[i] = c;
+    }
+}
+
+/**
+ * nv_blob_crc32, CRC-32 as in zlib
+ * @param data bytes
+ * @param size bytes
+ * @return     checksum
+ */
+uint32_t nv_blob_crc32(const void* data, size_t size)
+{
+    const uint8_t* p = data;
+    uint32_t crc = 0xFFFFFFFF;
+
+    pthread_once(&nv_blob_once, nv_blob_table_init);
+
+    for (size_t i = 0; i < size; i++) {
+        crc = nv_blob_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+/**
+ * nv_blob_path, sidecar path of a reference, next to the nv file
+ * @param path output, PATH_MAX bytes
+ * @param file nv file path
+ * @param name sidecar file name
+ * @return     boolean
+ */
+static bool nv_blob_path(char* path, const char* file, const char* name)
+{
+    /* a reference never leaves the directory of its nv file */
+    if (name[0] == '\0' || strchr(name, '/') || strcmp(name, "..") == 0) {
+        nv_log("nv blob invalid sidecar name %s\n", name);
+        return false;
+    }
+
+    const char* slash = strrchr(file, '/');
+    int dir = slash ? (int)(slash - file + 1) : 0;
+
+    return snprintf(path, PATH_MAX, "%.*s%s", dir, file, name) < PATH_MAX;
+}
+
+/**
+ * nv_blob_append, write all bytes at the file offset
+ * @param fd   sidecar descriptor
+ * @param data bytes
+ * @param size bytes
+ * @return     boolean, errno set on failure
+ */
+static bool nv_blob_append(int fd, const void* data, size_t size)
+{
+    size_t off = 0;
+    while (off < size) {
+        ssize_t ret = write(fd, (const char*)data + off, size - off);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        off += ret;
+    }
+
+    return true;
+}
+
+/**
+ * nv_blob_write, append a blob to the sidecar of file
+ * @param file   nv file path
+ * @param data   blob bytes
+ * @param size   blob bytes
+ * @param config append durability
+ * @param ref    reference of the appended blob
+ * @return       boolean
+ */
+bool nv_blob_write(const char* file, const void* data, size_t size,
+                   const nv_config_t* config, nv_blob_ref_t* ref)
+{
+    char path[PATH_MAX];
+    const char* slash = strrchr(file, '/');
+    const char* base = slash ? slash + 1 : file;
+
+    if (snprintf(ref->name, sizeof(ref->name), "%s%s", base, NV_BLOB_SUFFIX)
+            >= (int)sizeof(ref->name)
+        || nv_blob_path(path, file, ref->name) == false) {
+        return false;
+    }
+
+    uint64_t start = nv_stats_begin();
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        nv_log("nv blob open %s fail, errno %d %s\n", path, errno,
+               strerror(errno));
+        return false;
+    }
+
+    /* one append at a time, the end of our own write is then where the file
+     * offset is, whatever other writers of the sidecar do */
+    if (flock(fd, LOCK_EX) != 0) {
+        nv_log("nv blob lock %s fail, errno %d %s\n", path, errno,
+               strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    struct stat st = { 0 };
+    bool created = fstat(fd, &st) == 0 && st.st_size == 0;
+
+    if (nv_blob_append(fd, data, size) == false) {
+        nv_log("nv blob write %s fail, errno %d %s\n", path, errno,
+               strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    off_t end = lseek(fd, 0, SEEK_CUR);
+    nv_stats_end(NV_STATS_WRITE, start);
+    nv_stats_add(NV_STATS_BYTES_WRITTEN, size);
+
+    /* the reference must never point at bytes a crash could lose */
+    if (end < (off_t)size || nv_durable_fsync(path, fd, config) == false) {
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    if (created && nv_durable_fsync_dir(path, config) == false) {
+        return false;
+    }
+
+    ref->offset = end - size;
+    ref->length = size;
+    ref->crc32 = nv_blob_crc32(data, size);
+    return true;
+}
+
+/**
+ * nv_blob_item, reference object of the tree
+ * @param ref blob reference
+ * @return    item, NULL on failure
+ */
+cJSON* nv_blob_item(const nv_blob_ref_t* ref)
+{
+    cJSON* item = cJSON_CreateObject();
+    if (cJSON_AddStringToObject(item, NV_BLOB_KEY_NAME, ref->name) == NULL
+        || cJSON_AddNumberToObject(item, NV_BLOB_KEY_OFFSET, ref->offset)
+               == NULL
+        || cJSON_AddNumberToObject(item, NV_BLOB_KEY_LENGTH, ref->length)
+               == NULL
+        || cJSON_AddNumberToObject(item, NV_BLOB_KEY_CRC32, ref->crc32)
+               == NULL) {
+        cJSON_Delete(item);
+        return NULL;
+    }
+
+    return item;
+}
+
+/**
+ * nv_blob_parse, blob reference of a tree member
+ * @param item object member
+ * @param ref  blob reference
+ * @return     boolean, false if item is not a blob reference
+ */
+bool nv_blob_parse(const cJSON* item, nv_blob_ref_t* ref)
+{
+    const cJSON* name = cJSON_GetObjectItemCaseSensitive(item,
+                                                         NV_BLOB_KEY_NAME);
+    const cJSON* offset = cJSON_GetObjectItemCaseSensitive(item,
+                                                           NV_BLOB_KEY_OFFSET);
+    const cJSON* length = cJSON_GetObjectItemCaseSensitive(item,
+                                                           NV_BLOB_KEY_LENGTH);
+    const cJSON* crc32 = cJSON_GetObjectItemCaseSensitive(item,
+                                                          NV_BLOB_KEY_CRC32);
+
+    if (cJSON_IsString(name) == false || cJSON_IsNumber(offset) == false
+        || cJSON_IsNumber(length) == false || cJSON_IsNumber(crc32) == false
+        || offset->valuedouble < 0 || length->valuedouble < 0
+        || snprintf(ref->name, sizeof(ref->name), "%s", name->valuestring)
+               >= (int)sizeof(ref->name)) {
+        nv_log("nv %s is not a blob reference\n", item->string);
+        return false;
+    }
+
+    ref->offset = offset->valuedouble;
+    ref->length = length->valuedouble;
+    ref->crc32 = crc32->valuedouble;
+    return true;
+}
+
+/**
+ * nv_blob_open, open the sidecar of a reference and check its bounds
+ * @param file nv file path
+ * @param ref  blob reference
+ * @return     file descriptor, -1 on failure
+ */
+static int nv_blob_open(const char* file, const nv_blob_ref_t* ref)
+{
+    char path[PATH_MAX];
+    if (nv_blob_path(path, file, ref->name) == false) {
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        nv_log("nv blob open %s fail, errno %d %s\n", path, errno,
+               strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ref->offset > (uint64_t)st.st_size
+        || ref->length > (uint64_t)st.st_size - ref->offset) {
+        nv_log("nv blob %s truncated\n", path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * nv_blob_generation, compaction generation of a sidecar of file
+ * @param file nv file path
+ * @param name sidecar file name
+ * @return     N of "<file>.blob.<N>", 0 for the append sidecar or another file
+ */
+uint32_t nv_blob_generation(const char* file, const char* name)
+{
+    const char* slash = strrchr(file, '/');
+    const char* base = slash ? slash + 1 : file;
+    size_t len = strlen(base);
+
+    if (strncmp(name, base, len) != 0
+        || strncmp(name + len, NV_BLOB_SUFFIX ".", sizeof(NV_BLOB_SUFFIX))
+               != 0) {
+        return 0;
+    }
+
+    const char* digits = name + len + sizeof(NV_BLOB_SUFFIX);
+    char* end = NULL;
+    unsigned long generation = strtoul(digits, &end, 10);
+    if (digits[0] < '0' || digits[0] > '9' || *end != '\0'
+        || generation > UINT32_MAX) {
+        return 0;
+    }
+
+    return generation;
+}
+
+/**
+ * nv_blob_latest, highest compaction generation on disk of file
+ * @param file nv file path
+ * @return     generation, 0 if there is none
+ */
+uint32_t nv_blob_latest(const char* file)
+{
+    char path[PATH_MAX];
+    const char* slash = strrchr(file, '/');
+    int dir_len = slash ? (int)(slash - file + 1) : 0;
+    uint32_t latest = 0;
+
+    if (snprintf(path, sizeof(path), "%.*s.", dir_len, file)
+        >= (int)sizeof(path)) {
+        return 0;
+    }
+
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        uint32_t generation = nv_blob_generation(file, entry->d_name);
+        latest = generation > latest ? generation : latest;
+    }
+    closedir(dir);
+
+    return latest;
+}
+
+/**
+ * nv_blob_sidecar_open, create the sidecar of a compaction generation
+ * @param file       nv file path
+ * @param generation compaction generation, above every one in use
+ * @param sidecar    new sidecar, finish by nv_blob_sidecar_close
+ * @return           boolean
+ */
+bool nv_blob_sidecar_open(const char* file, uint32_t generation,
+                          nv_blob_sidecar_t* sidecar)
+{
+    const char* slash = strrchr(file, '/');
+    const char* base = slash ? slash + 1 : file;
+
+    memset(sidecar, 0, sizeof(nv_blob_sidecar_t));
+    sidecar->fd = -1;
+
+    if (snprintf(sidecar->name, sizeof(sidecar->name), "%s%s.%u", base,
+                 NV_BLOB_SUFFIX, generation)
+            >= (int)sizeof(sidecar->name)
+        || nv_blob_path(sidecar->path, file, sidecar->name) == false) {
+        return false;
+    }
+
+    /* nothing references this generation yet, a leftover of a compaction
+     * that did not finish is overwritten */
+    sidecar->fd = open(sidecar->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (sidecar->fd < 0) {
+        nv_log("nv blob open %s fail, errno %d %s\n", sidecar->path, errno,
+               strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * nv_blob_sidecar_copy, copy a live blob into the new sidecar
+ * @param file    nv file path
+ * @param sidecar new sidecar
+ * @param ref     blob reference, moved to the new sidecar
+ * @return        boolean, false if the blob fails its checksum
+ */
+bool nv_blob_sidecar_copy(const char* file, nv_blob_sidecar_t* sidecar,
+                          nv_blob_ref_t* ref)
+{
+    nv_blob_t blob;
+    if (nv_blob_map(file, ref, &blob) == false) {
+        return false;
+    }
+
+    /* a damaged blob is kept where it is rather than carried over */
+    bool ret = nv_blob_crc32(blob.data, blob.size) == ref->crc32;
+    if (ret == false) {
+        nv_log("nv blob %s at %llu checksum mismatch\n", ref->name,
+               (unsigned long long)ref->offset);
+    }
+
+    if (ret && nv_blob_append(sidecar->fd, blob.data, blob.size) == false) {
+        nv_log("nv blob write %s fail, errno %d %s\n", sidecar->path, errno,
+               strerror(errno));
+        ret = false;
+    }
+    nv_blob_unmap(&blob);
+
+    if (ret) {
+        snprintf(ref->name, sizeof(ref->name), "%s", sidecar->name);
+        ref->offset = sidecar->size;
+        sidecar->size += ref->length;
+    }
+
+    return ret;
+}
+
+/**
+ * nv_blob_sidecar_close, make the new sidecar durable and close it
+ * @param sidecar new sidecar
+ * @param config  durability
+ * @return        boolean
+ */
+bool nv_blob_sidecar_close(nv_blob_sidecar_t* sidecar,
+                           const nv_config_t* config)
+{
+    if (sidecar->fd < 0) {
+        return false;
+    }
+
+    bool ret = nv_durable_fsync(sidecar->path, sidecar->fd, config);
+    close(sidecar->fd);
+    sidecar->fd = -1;
+
+    return ret && nv_durable_fsync_dir(sidecar->path, config);
+}
+
+/**
+ * nv_blob_prune, unlink every sidecar of file except keep
+ * @param file   nv file path
+ * @param keep   sidecar file name still referenced, NULL for none
+ * @param config durability
+ * @return       boolean
+ */
+bool nv_blob_prune(const char* file, const char* keep,
+                   const nv_config_t* config)
+{
+    char path[PATH_MAX];
+    const char* slash = strrchr(file, '/');
+    const char* base = slash ? slash + 1 : file;
+    int dir_len = slash ? (int)(slash - file + 1) : 0;
+
+    if (snprintf(path, sizeof(path), "%.*s.", dir_len, file)
+        >= (int)sizeof(path)) {
+        return false;
+    }
+
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        nv_log("nv blob opendir %s fail, errno %d %s\n", path, errno,
+               strerror(errno));
+        return false;
+    }
+
+    /* the append sidecar and every other generation, leftovers of a crash
+     * between the nv file rename and an earlier prune included */
+    size_t unlinked = 0;
+    bool ret = true;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char* name = entry->d_name;
+        bool append = strncmp(name, base, strlen(base)) == 0
+                      && strcmp(name + strlen(base), NV_BLOB_SUFFIX) == 0;
+
+        if ((append == false && nv_blob_generation(file, name) == 0)
+            || (keep && strcmp(name, keep) == 0)
+            || nv_blob_path(path, file, name) == false) {
+            continue;
+        }
+
+        if (unlink(path) != 0 && errno != ENOENT) {
+            nv_log("nv blob unlink %s fail, errno %d %s\n", path, errno,
+                   strerror(errno));
+            ret = false;
+            continue;
+        }
+        unlinked++;
+    }
+    closedir(dir);
+
+    return (unlinked == 0 || nv_durable_fsync_dir(file, config)) && ret;
+}
+
+/**
+ * nv_blob_read, copy a blob out of the sidecar and check its checksum
+ * @param file  nv file path
+ * @param ref   blob reference
+ * @param value data buffer
+ * @param len   data buffer length, at least the blob length
+ * @return      boolean
+ */
+bool nv_blob_read(const char* file, const nv_blob_ref_t* ref, void* value,
+                  size_t len)
+{
+    if (ref->length > len) {
+        nv_log("nv blob needs %llu bytes, buffer %zu\n",
+               (unsigned long long)ref->length, len);
+        return false;
+    }
+
+    uint64_t start = nv_stats_begin();
+    int fd = nv_blob_open(file, ref);
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t size = 0;
+    while (size < ref->length) {
+        ssize_t ret = pread(fd, (char*)value + size, ref->length - size,
+                            ref->offset + size);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        size += ret;
+    }
+    close(fd);
+
+    nv_stats_end(NV_STATS_READ, start);
+    nv_stats_add(NV_STATS_BYTES_READ, size);
+
+    if (size != ref->length || nv_blob_crc32(value, size) != ref->crc32) {
+        nv_log("nv blob %s at %llu checksum mismatch\n", ref->name,
+               (unsigned long long)ref->offset);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * nv_blob_map, map a blob of the sidecar read-only
+ * @param file nv file path
+ * @param ref  blob reference
+ * @param blob mapping, release by nv_blob_unmap
+ * @return     boolean
+ */
+bool nv_blob_map(const char* file, const nv_blob_ref_t* ref, nv_blob_t* blob)
+{
+    memset(blob, 0, sizeof(nv_blob_t));
+
+    int fd = nv_blob_open(file, ref);
+    if (fd < 0) {
+        return false;
+    }
+
+    /* an empty blob has nothing to map */
+    if (ref->length == 0) {
+        close(fd);
+        blob->data = "";
+        return true;
+    }
+
+    /* mappings start on a page, the blob starts somewhere inside it */
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t base = ref->offset / page * page;
+    size_t size = ref->offset - base + ref->length;
+
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, base);
+    close(fd);
+    if (map == MAP_FAILED) {
+        nv_log("nv blob mmap %s fail, errno %d %s\n", ref->name, errno,
+               strerror(errno));
+        return false;
+    }
+
+    blob->data = (const char*)map + (ref->offset - base);
+    blob->size = ref->length;
+    blob->map = map;
+    blob->map_size = size;
+    return true;
+}
+
+/**
+ * nv_blob_unmap, release a mapping of nv_blob_map
+ * @param blob mapping
+ */
+void nv_blob_unmap(nv_blob_t* blob)
+{
+    if (blob->map) {
+        munmap(blob->map, blob->map_size);
+    }
+
+    memset(blob, 0, sizeof(nv_blob_t));
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_BLOB_H_
+#define _NV_BLOB_H_
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cJSON.h"
+#include "nv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NV_BLOB_SUFFIX    ".blob"
+#define NV_BLOB_NAME_SIZE 256
+
+/*
+ * a blob value is appended to the sidecar "<file>.blob" and the tree only
+ * keeps {"blob":"<sidecar name>","offset":N,"length":N,"crc32":N}
+ */
+typedef struct {
+    char name[NV_BLOB_NAME_SIZE];    ///< sidecar file name, no directory
+    uint64_t offset;                 ///< first byte in the sidecar
+    uint64_t length;                 ///< blob bytes
+    uint32_t crc32;                  ///< CRC-32 of the blob bytes
+} nv_blob_ref_t;
+
+/*
+ * compaction copies the live blobs into the sidecar "<file>.blob.<N>" of the
+ * next generation, the rename of the nv file pointing at it is the swap
+ */
+typedef struct {
+    char name[NV_BLOB_NAME_SIZE];    ///< sidecar file name, no directory
+    char path[PATH_MAX];             ///< sidecar path
+    int fd;                          ///< open for writing
+    uint64_t size;                   ///< bytes written
+} nv_blob_sidecar_t;
+
+/**
+ * nv_blob_crc32, CRC-32 as in zlib
+ * @param data bytes
+ * @param size bytes
+ * @return     checksum
+ */
+uint32_t nv_blob_crc32(const void* data, size_t size);
+
+/**
+ * nv_blob_write, append a blob to the sidecar of file
+ * @param file   nv file path
+ * @param data   blob bytes
+ * @param size   blob bytes
+ * @param config append durability
+ * @param ref    reference of the appended blob
+ * @return       boolean
+ */
+bool nv_blob_write(const char* file, const void* data, size_t size,
+                   const nv_config_t* config, nv_blob_ref_t* ref);
+
+/**
+ * nv_blob_item, reference object of the tree
+ * @param ref blob reference
+ * @return    item, NULL on failure
+ */
+cJSON* nv_blob_item(const nv_blob_ref_t* ref);
+
+/**
+ * nv_blob_parse, blob reference of a tree member
+ * @param item object member
+ * @param ref  blob reference
+ * @return     boolean, false if item is not a blob reference
+ */
+bool nv_blob_parse(const cJSON* item, nv_blob_ref_t* ref);
+
+/**
+ * nv_blob_generation, compaction generation of a sidecar of file
+ * @param file nv file path
+ * @param name sidecar file name
+ * @return     N of "<file>.blob.<N>", 0 for the append sidecar or another file
+ */
+uint32_t nv_blob_generation(const char* file, const char* name);
+
+/**
+ * nv_blob_latest, highest compaction generation on disk of file
+ * @param file nv file path
+ * @return     generation, 0 if there is none
+ */
+uint32_t nv_blob_latest(const char* file);
+
+/**
+ * nv_blob_sidecar_open, create the sidecar of a compaction generation
+ * @param file       nv file path
+ * @param generation compaction generation, above every one in use
+ * @param sidecar    new sidecar, finish by nv_blob_sidecar_close
+ * @return           boolean
+ */
+bool nv_blob_sidecar_open(const char* file, uint32_t generation,
+                          nv_blob_sidecar_t* sidecar);
+
+/**
+ * nv_blob_sidecar_copy, copy a live blob into the new sidecar
+ * @param file    nv file path
+ * @param sidecar new sidecar
+ * @param ref     blob reference, moved to the new sidecar
+ * @return        boolean, false if the blob fails its checksum
+ */
+bool nv_blob_sidecar_copy(const char* file, nv_blob_sidecar_t* sidecar,
+                          nv_blob_ref_t* ref);
+
+/**
+ * nv_blob_sidecar_close, make the new sidecar durable and close it
+ * @param sidecar new sidecar
+ * @param config  durability
+ * @return        boolean
+ */
+bool nv_blob_sidecar_close(nv_blob_sidecar_t* sidecar,
+                           const nv_config_t* config);
+
+/**
+ * nv_blob_prune, unlink every sidecar of file except keep
+ * @param file   nv file path
+ * @param keep   sidecar file name still referenced, NULL for none
+ * @param config durability
+ * @return       boolean
+ */
+bool nv_blob_prune(const char* file, const char* keep,
+                   const nv_config_t* config);
+
+/**
+ * nv_blob_read, copy a blob out of the sidecar and check its checksum
+ * @param file  nv file path
+ * @param ref   blob reference
+ * @param value data buffer
+ * @param len   data buffer length, at least the blob length
+ * @return      boolean
+ */
+bool nv_blob_read(const char* file, const nv_blob_ref_t* ref, void* value,
+                  size_t len);
+
+/**
+ * nv_blob_map, map a blob of the sidecar read-only
+ * @param file nv file path
+ * @param ref  blob reference
+ * @param blob mapping, release by nv_blob_unmap
+ * @return     boolean
+ */
+bool nv_blob_map(const char* file, const nv_blob_ref_t* ref, nv_blob_t* blob);
+
+/**
+ * nv_blob_unmap, release a mapping of nv_blob_map
+ * @param blob mapping
+ */
+void nv_blob_unmap(nv_blob_t* blob);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_BLOB_H_ */
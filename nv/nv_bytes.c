@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_bytes.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef CONFIG_NV_SIMD
+#define CONFIG_NV_SIMD 0
+#endif
+
+#if CONFIG_NV_SIMD && (defined(__x86_64__) || defined(__i386__)) \
+    && defined(__GNUC__)
+#define NV_BYTES_X86 1
+#include <immintrin.h>
+#else
+#define NV_BYTES_X86 0
+#endif
+
+typedef const char* (*nv_bytes_find_t)(const char* p, const char* end,
+                                       const nv_byteset_t* set);
+
+/**
+ * nv_bytes_match
+ * @param set byte set
+ * @param c   byte
+ * @return    boolean
+ */
+static inline bool nv_bytes_match(const nv_byteset_t* set, char c)
+{
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->bytes[i] == c) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * nv_bytes_find_scalar
+ */
+static const char* nv_bytes_find_scalar(const char* p, const char* end,
+                                        const nv_byteset_t* set)
+{
+    while (p < end && nv_bytes_match(set, *p) == false) {
+        p++;
+    }
+
+    return p;
+}
+
+#if NV_BYTES_X86
+/**
+ * nv_bytes_find_sse2, 16 bytes per step, the tail one by one
+ */
+__attribute__((target("sse2"))) static const char*
+nv_bytes_find_sse2(const char* p, const char* end, const nv_byteset_t* set)
+{
+    __m128i needles[NV_BYTES_SET_MAX];
+    for (size_t i = 0; i < set->count; i++) {
+        needles[i] = _mm_set1_epi8(set->bytes[i]);
+    }
+
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i hits = _mm_setzero_si128();
+        for (size_t i = 0; i < set->count; i++) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, needles[i]));
+        }
+
+        int mask = _mm_movemask_epi8(hits);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+
+    return nv_bytes_find_scalar(p, end, set);
+}
+
+/**
+ * nv_bytes_find_avx2, 32 bytes per step, the tail by sse2
+ */
+__attribute__((target("avx2"))) static const char*
+nv_bytes_find_avx2(const char* p, const char* end, const nv_byteset_t* set)
+{
+    __m256i needles[NV_BYTES_SET_MAX];
+    for (size_t i = 0; i < set->count; i++) {
+        needles[i] = _mm256_set1_epi8(set->bytes[i]);
+    }
+
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+        __m256i hits = _mm256_setzero_si256();
+        for (size_t i = 0; i < set->count; i++) {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, needles[i]));
+        }
+
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+
+    return nv_bytes_find_sse2(p, end, set);
+}
+#endif /* NV_BYTES_X86 */
+
+/**
+ * nv_bytes_select, best implementation the CPU supports
+ */
+static nv_bytes_find_t nv_bytes_select(void)
+{
+#if NV_BYTES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return nv_bytes_find_avx2;
+    }
+
+    if (__builtin_cpu_supports("sse2")) {
+        return nv_bytes_find_sse2;
+    }
+#endif
+
+    return nv_bytes_find_scalar;
+}
+
+static const char* nv_bytes_find_init(const char* p, const char* end,
+                                      const nv_byteset_t* set);
+
+/* every thread selects the same implementation, no ordering needed */
+static _Atomic(nv_bytes_find_t) nv_bytes_impl = nv_bytes_find_init;
+
+/**
+ * nv_bytes_find_init, select on first use, then search
+ */
+static const char* nv_bytes_find_init(const char* p, const char* end,
+                                      const nv_byteset_t* set)
+{
+    nv_bytes_find_t impl = nv_bytes_select();
+    atomic_store_explicit(&nv_bytes_impl, impl, memory_order_relaxed);
+
+    return impl(p, end, set);
+}
+
+/**
+ * nv_bytes_find, first byte of text that is in the set
+ * @param p   text start
+ * @param end text end
+ * @param set byte set
+ * @return    first match, end if none
+ */
+const char* nv_bytes_find(const char* p, const char* end,
+                          const nv_byteset_t* set)
+{
+    /* short runs, like most keys, are done before a vector is loaded */
+    if (end - p < 16) {
+        return nv_bytes_find_scalar(p, end, set);
+    }
+
+    nv_bytes_find_t impl
+        = atomic_load_explicit(&nv_bytes_impl, memory_order_relaxed);
+    return impl(p, end, set);
+}
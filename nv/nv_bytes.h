@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_BYTES_H_
+#define _NV_BYTES_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NV_BYTES_SET_MAX 8    ///< bytes of one search set
+
+/*
+ * Set of byte values searched for in bulk. With CONFIG_NV_SIMD on x86 the
+ * search compares 32 (AVX2) or 16 (SSE2) bytes per step, picked once by CPU
+ * feature detection, elsewhere one byte per step.
+ */
+typedef struct {
+    size_t count;                      ///< bytes in the set
+    char bytes[NV_BYTES_SET_MAX];      ///< byte values
+} nv_byteset_t;
+
+/**
+ * nv_bytes_find, first byte of text that is in the set
+ * @param p   text start
+ * @param end text end
+ * @param set byte set
+ * @return    first match, end if none
+ */
+const char* nv_bytes_find(const char* p, const char* end,
+                          const nv_byteset_t* set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_BYTES_H_ */
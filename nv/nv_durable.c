@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_durable.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nv_stats.h"
+
+#ifndef CONFIG_NV_GROUP_COMMIT_MAX
+#define CONFIG_NV_GROUP_COMMIT_MAX 64
+#endif /* CONFIG_NV_GROUP_COMMIT_MAX */
+
+#define NV_DURABLE_TEMP_SUFFIX ".XXXXXX"
+
+typedef struct {
+    int fd;       ///< file descriptor to fsync
+    int ret;      ///< fsync result
+    int err;      ///< fsync errno
+    bool done;    ///< leader finished this waiter
+} nv_group_waiter_t;
+
+typedef struct nv_async_entry {
+    struct nv_async_entry* next;
+    char file[];
+} nv_async_entry_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    nv_group_waiter_t* waiters[CONFIG_NV_GROUP_COMMIT_MAX];
+    size_t count;
+    bool leader;
+} nv_group = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_once_t once;
+    nv_async_entry_t* head;
+    bool started;
+} nv_async = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .once = PTHREAD_ONCE_INIT,
+};
+
+/**
+ * nv_durable_dir_open, open the directory holding file
+ * @param file file path
+ * @return     directory file descriptor, -1 on failure
+ */
+static int nv_durable_dir_open(const char* file)
+{
+    const char* slash = strrchr(file, '/');
+    if (slash == NULL) {
+        return open(".", O_RDONLY);
+    }
+
+    size_t len = slash == file ? 1 : (size_t)(slash - file);
+    char* dir = malloc(len + 1);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    memcpy(dir, file, len);
+    dir[len] = '\0';
+
+    int fd = open(dir, O_RDONLY);
+    free(dir);
+
+    return fd;
+}
+
+/**
+ * nv_durable_fsync_path, fsync file and its directory by path
+ * @param file file path
+ */
+static void nv_durable_fsync_path(const char* file)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+
+    fd = nv_durable_dir_open(file);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static void* nv_async_worker(void* arg)
+{
+    (void)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&nv_async.lock);
+        while (nv_async.head == NULL) {
+            pthread_cond_wait(&nv_async.cond, &nv_async.lock);
+        }
+
+        nv_async_entry_t* entry = nv_async.head;
+        nv_async.head = NULL;
+        pthread_mutex_unlock(&nv_async.lock);
+
+        while (entry) {
+            nv_async_entry_t* next = entry->next;
+
+            nv_durable_fsync_path(entry->file);
+            free(entry);
+
+            entry = next;
+        }
+    }
+
+    return NULL;
+}
+
+static void nv_async_start(void)
+{
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, nv_async_worker, NULL) != 0) {
+        nv_log("nv async flush thread create fail\n");
+        return;
+    }
+
+    pthread_detach(thread);
+    nv_async.started = true;
+}
+
+/**
+ * nv_async_queue, hand file over to the background flush thread
+ * @param file file path
+ * @return     boolean, false if background flush is not available
+ */
+static bool nv_async_queue(const char* file)
+{
+    pthread_once(&nv_async.once, nv_async_start);
+    if (nv_async.started == false) {
+        return false;
+    }
+
+    pthread_mutex_lock(&nv_async.lock);
+
+    for (nv_async_entry_t* entry = nv_async.head; entry; entry = entry->next) {
+        if (strcmp(entry->file, file) == 0) {
+            pthread_mutex_unlock(&nv_async.lock);
+            return true;
+        }
+    }
+
+    size_t len = strlen(file) + 1;
+    nv_async_entry_t* entry = malloc(sizeof(nv_async_entry_t) + len);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&nv_async.lock);
+        return false;
+    }
+
+    memcpy(entry->file, file, len);
+    entry->next = nv_async.head;
+    nv_async.head = entry;
+
+    pthread_cond_signal(&nv_async.cond);
+    pthread_mutex_unlock(&nv_async.lock);
+
+    return true;
+}
+
+/**
+ * nv_group_fsync, the first committer becomes leader, waits for the window
+ * and fsyncs the whole group, each inode only once
+ * @param fd        file descriptor
+ * @param window_us group commit window
+ * @return          fsync result
+ */
+static int nv_group_fsync(int fd, uint32_t window_us)
+{
+    nv_group_waiter_t self = { .fd = fd };
+    nv_group_waiter_t* group[CONFIG_NV_GROUP_COMMIT_MAX];
+
+    pthread_mutex_lock(&nv_group.lock);
+
+    if (nv_group.count == CONFIG_NV_GROUP_COMMIT_MAX) {
+        pthread_mutex_unlock(&nv_group.lock);
+        return fsync(fd);
+    }
+
+    nv_group.waiters[nv_group.count++] = &self;
+
+    if (nv_group.leader) {
+        while (self.done == false) {
+            pthread_cond_wait(&nv_group.cond, &nv_group.lock);
+        }
+        pthread_mutex_unlock(&nv_group.lock);
+
+        errno = self.err;
+        return self.ret;
+    }
+
+    nv_group.leader = true;
+    pthread_mutex_unlock(&nv_group.lock);
+
+    struct timespec ts = {
+        .tv_sec = window_us / 1000000,
+        .tv_nsec = (window_us % 1000000) * 1000,
+    };
+    nanosleep(&ts, NULL);
+
+    /* later committers form the next group under a new leader */
+    pthread_mutex_lock(&nv_group.lock);
+    size_t count = nv_group.count;
+    memcpy(group, nv_group.waiters, count * sizeof(group[0]));
+    nv_group.count = 0;
+    nv_group.leader = false;
+    pthread_mutex_unlock(&nv_group.lock);
+
+    struct stat st[CONFIG_NV_GROUP_COMMIT_MAX];
+    for (size_t i = 0; i < count; i++) {
+        bool synced = false;
+
+        if (fstat(group[i]->fd, &st[i]) == 0) {
+            for (size_t j = 0; j < i; j++) {
+                if (st[j].st_dev == st[i].st_dev
+                    && st[j].st_ino == st[i].st_ino) {
+                    group[i]->ret = group[j]->ret;
+                    group[i]->err = group[j]->err;
+                    synced = true;
+                    break;
+                }
+            }
+        } else {
+            st[i].st_dev = 0;
+            st[i].st_ino = 0;
+        }
+
+        if (synced == false) {
+            group[i]->ret = fsync(group[i]->fd);
+            group[i]->err = errno;
+        }
+    }
+
+    nv_log("nv group commit, %zu committers\n", count);
+
+    pthread_mutex_lock(&nv_group.lock);
+    for (size_t i = 0; i < count; i++) {
+        group[i]->done = true;
+    }
+    pthread_cond_broadcast(&nv_group.cond);
+    pthread_mutex_unlock(&nv_group.lock);
+
+    errno = self.err;
+    return self.ret;
+}
+
+/**
+ * nv_durable_fsync, make data written through fd durable per config
+ * @param file   file path, used by background flush
+ * @param fd     file descriptor
+ * @param config durability and group commit window
+ * @return       boolean
+ */
+bool nv_durable_fsync(const char* file, int fd, const nv_config_t* config)
+{
+    int ret = 0;
+    uint64_t start = nv_stats_begin();
+
+    switch (config->durability) {
+    case NV_DURABILITY_NONE:
+        break;
+    case NV_DURABILITY_ASYNC:
+        if (nv_async_queue(file)) {
+            break;
+        }
+
+        if (fd >= 0) {
+            ret = fsync(fd);
+        } else {
+            nv_durable_fsync_path(file);
+        }
+        break;
+    case NV_DURABILITY_GROUP:
+        ret = nv_group_fsync(fd, config->group_commit_us);
+        break;
+    case NV_DURABILITY_FULL:
+    default:
+        ret = fsync(fd);
+        break;
+    }
+
+    nv_stats_end(NV_STATS_SYNC, start);
+
+    if (ret != 0) {
+        nv_log("nv fsync %s fail, errno %d %s\n", file, errno,
+               strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * nv_durable_fsync_dir, make a new or renamed file entry durable per config
+ * @param file   file path
+ * @param config durability and group commit window
+ * @return       boolean
+ */
+bool nv_durable_fsync_dir(const char* file, const nv_config_t* config)
+{
+    if (config->durability == NV_DURABILITY_NONE) {
+        return true;
+    }
+
+    /* background flush syncs the directory along with the file */
+    if (config->durability == NV_DURABILITY_ASYNC) {
+        return nv_durable_fsync(file, -1, config);
+    }
+
+    int fd = nv_durable_dir_open(file);
+    if (fd < 0) {
+        nv_log("nv directory open %s fail, errno %d %s\n", file, errno,
+               strerror(errno));
+        return false;
+    }
+
+    bool ret = nv_durable_fsync(file, fd, config);
+    close(fd);
+
+    return ret;
+}
+
+/**
+ * nv_durable_write, replace file content atomically by temp file and rename
+ * @param file   file path
+ * @param data   data buffer
+ * @param len    data buffer length
+ * @param config durability and group commit window
+ * @return       boolean
+ */
+bool nv_durable_write(const char* file, const void* data, size_t len,
+                      const nv_config_t* config)
+{
+    size_t size = strlen(file) + sizeof(NV_DURABLE_TEMP_SUFFIX);
+    char* temp = malloc(size);
+    if (temp == NULL) {
+        return false;
+    }
+
+    snprintf(temp, size, "%s%s", file, NV_DURABLE_TEMP_SUFFIX);
+
+    uint64_t start = nv_stats_begin();
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        nv_log("nv write open %s fail, errno %d %s\n", temp, errno,
+               strerror(errno));
+        free(temp);
+        return false;
+    }
+
+    struct stat st;
+    fchmod(fd, stat(file, &st) == 0 ? (st.st_mode & 0777) : 0644);
+
+    size_t off = 0;
+    while (off < len) {
+        ssize_t ret = write(fd, (const char*)data + off, len - off);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            nv_log("nv write %s fail, errno %d %s\n", temp, errno,
+                   strerror(errno));
+            goto fail;
+        }
+        off += ret;
+    }
+
+    nv_stats_end(NV_STATS_WRITE, start);
+    nv_stats_add(NV_STATS_BYTES_WRITTEN, len);
+
+    /* data must be durable before the rename makes it visible */
+    if ((config->durability == NV_DURABILITY_FULL
+         || config->durability == NV_DURABILITY_GROUP)
+        && nv_durable_fsync(temp, fd, config) == false) {
+        goto fail;
+    }
+
+    close(fd);
+    fd = -1;
+
+    if (rename(temp, file) != 0) {
+        nv_log("nv rename %s fail, errno %d %s\n", file, errno,
+               strerror(errno));
+        goto fail;
+    }
+    free(temp);
+
+    return nv_durable_fsync_dir(file, config);
+
+fail:
+    if (fd >= 0) {
+        close(fd);
+    }
+    unlink(temp);
+    free(temp);
+    return false;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_DURABLE_H_
+#define _NV_DURABLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * nv_durable_write, replace file content atomically by temp file and rename
+ * @param file   file path
+ * @param data   data buffer
+ * @param len    data buffer length
+ * @param config durability and group commit window
+ * @return       boolean
+ */
+bool nv_durable_write(const char* file, const void* data, size_t len,
+                      const nv_config_t* config);
+
+/**
+ * nv_durable_fsync, make data written through fd durable per config
+ * @param file   file path, used by background flush
+ * @param fd     file descriptor
+ * @param config durability and group commit window
+ * @return       boolean
+ */
+bool nv_durable_fsync(const char* file, int fd, const nv_config_t* config);
+
+/**
+ * nv_durable_fsync_dir, make a new or renamed file entry durable per config
+ * @param file   file path
+ * @param config durability and group commit window
+ * @return       boolean
+ */
+bool nv_durable_fsync_dir(const char* file, const nv_config_t* config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_DURABLE_H_ */
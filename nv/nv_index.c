@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_index.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NV_INDEX_MIN_CAP 16
+
+static uint64_t nv_index_hash(const char* key)
+{
+    uint64_t hash = 14695981039346656037ULL;    // FNV-1a
+
+    for (const unsigned char* p = (const unsigned char*)key; *p; p++) {
+        hash ^= (uint64_t)tolower(*p);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static bool nv_index_equal(const char* a, const char* b)
+{
+    const unsigned char* s1 = (const unsigned char*)a;
+    const unsigned char* s2 = (const unsigned char*)b;
+
+    for (; tolower(*s1) == tolower(*s2); s1++, s2++) {
+        if (*s1 == '\0') {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * nv_index_item, member a slot refers to
+ */
+static cJSON* nv_index_item(const nv_index_t* index, size_t i)
+{
+    size_t pos = index->slots[i].pos;
+    return pos ? index->items[pos - 1] : NULL;
+}
+
+/**
+ * nv_index_lookup, find the slot holding key or the empty slot ending its run
+ */
+static size_t nv_index_lookup(const nv_index_t* index, uint64_t hash,
+                              const char* key)
+{
+    size_t mask = index->cap - 1;
+    size_t i = hash & mask;
+
+    while (index->slots[i].pos) {
+        if (index->slots[i].hash == hash
+            && nv_index_equal(nv_index_item(index, i)->string, key)) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+static bool nv_index_resize(nv_index_t* index, size_t cap)
+{
+    nv_index_slot_t* slots = calloc(cap, sizeof(nv_index_slot_t));
+    if (slots == NULL) {
+        return false;
+    }
+
+    nv_index_slot_t* old = index->slots;
+    size_t old_cap = index->cap;
+
+    index->slots = slots;
+    index->cap = cap;
+
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].pos) {
+            size_t j = old[i].hash & (cap - 1);
+            while (slots[j].pos) {
+                j = (j + 1) & (cap - 1);
+            }
+            slots[j] = old[i];
+        }
+    }
+
+    free(old);
+    return true;
+}
+
+/**
+ * nv_index_reserve, make room for members
+ * @param index index
+ * @param len   members
+ * @return      boolean
+ */
+static bool nv_index_reserve(nv_index_t* index, size_t len)
+{
+    if (len <= index->items_cap) {
+        return true;
+    }
+
+    size_t cap = index->items_cap ? index->items_cap : NV_INDEX_MIN_CAP;
+    while (cap < len) {
+        cap *= 2;
+    }
+
+    cJSON** items = realloc(index->items, cap * sizeof(cJSON*));
+    if (items == NULL) {
+        return false;
+    }
+
+    index->items = items;
+    index->items_cap = cap;
+    return true;
+}
+
+/**
+ * nv_index_add, index the member at a position unless its key is taken
+ * @param index index
+ * @param pos   position of the member in the object
+ * @return      boolean
+ */
+static bool nv_index_add(nv_index_t* index, size_t pos)
+{
+    const char* key = index->items[pos]->string;
+    if (key == NULL) {
+        return true;
+    }
+
+    /* keep load factor below 3/4 */
+    if ((index->count + 1) * 4 > index->cap * 3
+        && nv_index_resize(index, index->cap * 2) == false) {
+        return false;
+    }
+
+    uint64_t hash = nv_index_hash(key);
+    size_t i = nv_index_lookup(index, hash, key);
+    if (index->slots[i].pos) {
+        index->dups++;
+        return true;
+    }
+
+    index->slots[i].hash = hash;
+    index->slots[i].pos = pos + 1;
+    index->count++;
+
+    return true;
+}
+
+/**
+ * nv_index_insert, index a member just added to the object
+ * @param index index
+ * @param item  object member
+ * @return      boolean
+ */
+bool nv_index_insert(nv_index_t* index, cJSON* item)
+{
+    if (index->slots == NULL) {
+        return true;
+    }
+
+    if (nv_index_reserve(index, index->len + 1) == false) {
+        return false;
+    }
+
+    index->items[index->len] = item;
+    return nv_index_add(index, index->len++);
+}
+
+/**
+ * nv_index_build, index all members of object
+ * @param index index
+ * @param json  object
+ * @return      boolean
+ */
+bool nv_index_build(nv_index_t* index, const cJSON* json)
+{
+    size_t count = 0;
+    cJSON* item = NULL;
+
+    nv_index_free(index);
+
+    cJSON_ArrayForEach(item, json) {
+        count++;
+    }
+
+    size_t cap = NV_INDEX_MIN_CAP;
+    while (cap * 3 < count * 4) {
+        cap *= 2;
+    }
+
+    index->slots = calloc(cap, sizeof(nv_index_slot_t));
+    if (index->slots == NULL || nv_index_reserve(index, count) == false) {
+        nv_index_free(index);
+        return false;
+    }
+    index->cap = cap;
+
+    cJSON_ArrayForEach(item, json) {
+        if (nv_index_insert(index, item) == false) {
+            nv_index_free(index);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * nv_index_clone, index a copy of an indexed object without hashing its keys
+ * again, the copy holds other nodes for the same members in the same order
+ * @param index index of the copy
+ * @param src   index of the object
+ * @param copy  copy of the object
+ * @return      boolean
+ */
+bool nv_index_clone(nv_index_t* index, const nv_index_t* src,
+                    const cJSON* copy)
+{
+    if (src->slots == NULL) {
+        return nv_index_build(index, copy);
+    }
+
+    nv_index_free(index);
+
+    index->slots = malloc(src->cap * sizeof(nv_index_slot_t));
+    if (index->slots == NULL || nv_index_reserve(index, src->len) == false) {
+        nv_index_free(index);
+        return false;
+    }
+
+    cJSON* item = NULL;
+    cJSON_ArrayForEach(item, copy) {
+        if (index->len == src->len) {
+            break;
+        }
+        index->items[index->len++] = item;
+    }
+
+    if (item || index->len != src->len) {
+        return nv_index_build(index, copy);
+    }
+
+    /* the slots refer to positions, they carry over as they are */
+    memcpy(index->slots, src->slots, src->cap * sizeof(nv_index_slot_t));
+    index->cap = src->cap;
+    index->count = src->count;
+    index->dups = src->dups;
+    return true;
+}
+
+/**
+ * nv_index_find
+ * @param index index
+ * @param key   nv key
+ * @return      object member, NULL if not exist
+ */
+cJSON* nv_index_find(const nv_index_t* index, const char* key)
+{
+    return nv_index_item(index,
+                         nv_index_lookup(index, nv_index_hash(key), key));
+}
+
+/**
+ * nv_index_remove, drop a member already detached from the object
+ * @param index index
+ * @param item  detached member
+ */
+void nv_index_remove(nv_index_t* index, const cJSON* item)
+{
+    if (index->slots == NULL) {
+        return;
+    }
+
+    size_t pos = 0;
+    while (pos < index->len && index->items[pos] != item) {
+        pos++;
+    }
+
+    if (pos == index->len) {
+        return;
+    }
+
+    size_t mask = index->cap - 1;
+    size_t i = 0;
+    bool indexed = false;
+    if (item->string) {
+        i = nv_index_lookup(index, nv_index_hash(item->string), item->string);
+        indexed = nv_index_item(index, i) == item;
+
+        /* a shadowed duplicate was never indexed */
+        if (indexed == false && index->dups) {
+            index->dups--;
+        }
+    }
+
+    /* backward shift delete keeps probe runs intact without tombstones */
+    if (indexed) {
+        size_t j = i;
+        for (;;) {
+            j = (j + 1) & mask;
+            if (index->slots[j].pos == 0) {
+                break;
+            }
+
+            size_t home = index->slots[j].hash & mask;
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                index->slots[i] = index->slots[j];
+                i = j;
+            }
+        }
+        index->slots[i].pos = 0;
+        index->count--;
+    }
+
+    /* the members after it move up one position */
+    index->len--;
+    memmove(&index->items[pos], &index->items[pos + 1],
+            (index->len - pos) * sizeof(cJSON*));
+    for (size_t k = 0; k < index->cap; k++) {
+        if (index->slots[k].pos > pos + 1) {
+            index->slots[k].pos--;
+        }
+    }
+
+    if (indexed == false || index->dups == 0) {
+        return;
+    }
+
+    /* promote the next member with the same key, as cJSON would find it */
+    for (pos = 0; pos < index->len; pos++) {
+        const char* key = index->items[pos]->string;
+        if (key && nv_index_equal(key, item->string)) {
+            index->dups--;
+            nv_index_add(index, pos);
+            break;
+        }
+    }
+}
+
+/**
+ * nv_index_free
+ * @param index index
+ */
+void nv_index_free(nv_index_t* index)
+{
+    free(index->slots);
+    free(index->items);
+    memset(index, 0, sizeof(nv_index_t));
+}
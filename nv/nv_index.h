@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_INDEX_H_
+#define _NV_INDEX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint64_t hash;    ///< case-insensitive key hash
+    size_t pos;       ///< member position plus one, 0 for empty slot
+} nv_index_slot_t;
+
+/*
+ * Open addressing hash table over the top level object members, linear
+ * probing with backward shift delete. Keys match case-insensitively and the
+ * first member wins, exactly like cJSON_GetObjectItem. The members are also
+ * kept in object order, so a copy of the object is indexed by position.
+ */
+typedef struct {
+    nv_index_slot_t* slots;    ///< table, NULL until built
+    size_t cap;                ///< slot count, power of two
+    size_t count;              ///< indexed members
+    size_t dups;               ///< members shadowed by an earlier same key
+    cJSON** items;             ///< every member in object order
+    size_t len;                ///< members
+    size_t items_cap;          ///< allocated members
+} nv_index_t;
+
+/**
+ * nv_index_build, index all members of object
+ * @param index index
+ * @param json  object
+ * @return      boolean
+ */
+bool nv_index_build(nv_index_t* index, const cJSON* json);
+
+/**
+ * nv_index_clone, index a copy of an indexed object without hashing its keys
+ * again, the copy holds other nodes for the same members in the same order
+ * @param index index of the copy
+ * @param src   index of the object
+ * @param copy  copy of the object
+ * @return      boolean
+ */
+bool nv_index_clone(nv_index_t* index, const nv_index_t* src,
+                    const cJSON* copy);
+
+/**
+ * nv_index_find
+ * @param index index
+ * @param key   nv key
+ * @return      object member, NULL if not exist
+ */
+cJSON* nv_index_find(const nv_index_t* index, const char* key);
+
+/**
+ * nv_index_insert, index a member just added to the object
+ * @param index index
+ * @param item  object member
+ * @return      boolean
+ */
+bool nv_index_insert(nv_index_t* index, cJSON* item);
+
+/**
+ * nv_index_remove, drop a member already detached from the object
+ * @param index index
+ * @param item  detached member
+ */
+void nv_index_remove(nv_index_t* index, const cJSON* item);
+
+/**
+ * nv_index_free
+ * @param index index
+ */
+void nv_index_free(nv_index_t* index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_INDEX_H_ */
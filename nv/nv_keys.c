@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "nv_keys.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NV_KEYS_MIN_CAP 16
+
+/**
+ * nv_keys_compare, case-insensitive order of keys
+ * @param a key
+ * @param b key
+ * @return  <0, 0 or >0 like strcmp
+ */
+int nv_keys_compare(const char* a, const char* b)
+{
+    const unsigned char* s1 = (const unsigned char*)a;
+    const unsigned char* s2 = (const unsigned char*)b;
+
+    for (; tolower(*s1) == tolower(*s2); s1++, s2++) {
+        if (*s1 == '\0') {
+            return 0;
+        }
+    }
+
+    return tolower(*s1) - tolower(*s2);
+}
+
+/**
+ * nv_keys_prefix, key starts with prefix, case-insensitive
+ * @param key    key
+ * @param prefix prefix
+ * @return       boolean
+ */
+bool nv_keys_prefix(const char* key, const char* prefix)
+{
+    const unsigned char* s1 = (const unsigned char*)key;
+    const unsigned char* s2 = (const unsigned char*)prefix;
+
+    for (; *s2; s1++, s2++) {
+        if (tolower(*s1) != tolower(*s2)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * nv_keys_sort, bottom-up merge sort, stable so same keys keep document order
+ */
+static bool nv_keys_sort(cJSON** items, size_t count)
+{
+    if (count < 2) {
+        return true;
+    }
+
+    cJSON** buffer = malloc(count * sizeof(cJSON*));
+    if (buffer == NULL) {
+        return false;
+    }
+
+    cJSON** src = items;
+    cJSON** dst = buffer;
+
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t lo = 0; lo < count; lo += 2 * width) {
+            size_t mid = lo + width < count ? lo + width : count;
+            size_t hi = lo + 2 * width < count ? lo + 2 * width : count;
+            size_t i = lo;
+            size_t j = mid;
+
+            for (size_t k = lo; k < hi; k++) {
+                if (i < mid
+                    && (j >= hi
+                        || nv_keys_compare(src[i]->string, src[j]->string)
+                               <= 0)) {
+                    dst[k] = src[i++];
+                } else {
+                    dst[k] = src[j++];
+                }
+            }
+        }
+
+        cJSON** swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != items) {
+        memcpy(items, src, count * sizeof(cJSON*));
+    }
+
+    free(buffer);
+    return true;
+}
+
+/**
+ * nv_keys_build, order all members of object
+ * @param keys ordered keys
+ * @param json object
+ * @return     boolean
+ */
+bool nv_keys_build(nv_keys_t* keys, const cJSON* json)
+{
+    size_t count = 0;
+
+    for (cJSON* item = json->child; item; item = item->next) {
+        count++;
+    }
+
+    size_t cap = count > NV_KEYS_MIN_CAP ? count : NV_KEYS_MIN_CAP;
+    cJSON** items = malloc(cap * sizeof(cJSON*));
+    if (items == NULL) {
+        return false;
+    }
+
+    count = 0;
+    for (cJSON* item = json->child; item; item = item->next) {
+        if (item->string) {
+            items[count++] = item;
+        }
+    }
+
+    if (nv_keys_sort(items, count) == false) {
+        free(items);
+        return false;
+    }
+
+    nv_keys_free(keys);
+    keys->items = items;
+    keys->count = count;
+    keys->cap = cap;
+
+    return true;
+}
+
+/**
+ * nv_keys_lower_bound
+ * @param keys ordered keys
+ * @param key  key
+ * @return     position of the first member not ordered before key
+ */
+size_t nv_keys_lower_bound(const nv_keys_t* keys, const char* key)
+{
+    size_t lo = 0;
+    size_t hi = keys->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (nv_keys_compare(keys->items[mid]->string, key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * nv_keys_upper_bound
+ * @param keys ordered keys
+ * @param key  key
+ * @return     position of the first member ordered after key
+ */
+size_t nv_keys_upper_bound(const nv_keys_t* keys, const char* key)
+{
+    size_t lo = 0;
+    size_t hi = keys->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (nv_keys_compare(keys->items[mid]->string, key) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * nv_keys_insert, order a member just added to the object
+ * @param keys ordered keys, nothing done if not built
+ * @param item object member
+ * @return     boolean
+ */
+bool nv_keys_insert(nv_keys_t* keys, cJSON* item)
+{
+    if (keys->items == NULL || item->string == NULL) {
+        return true;
+    }
+
+    if (keys->count == keys->cap) {
+        cJSON** items = realloc(keys->items, keys->cap * 2 * sizeof(cJSON*));
+        if (items == NULL) {
+            return false;
+        }
+
+        keys->items = items;
+        keys->cap *= 2;
+    }
+
+    /* the member was appended to the object, it goes after the same keys */
+    size_t i = nv_keys_upper_bound(keys, item->string);
+    memmove(&keys->items[i + 1], &keys->items[i],
+            (keys->count - i) * sizeof(cJSON*));
+    keys->items[i] = item;
+    keys->count++;
+
+    return true;
+}
+
+/**
+ * nv_keys_remove, drop a member detached from the object
+ * @param keys ordered keys, nothing done if not built
+ * @param item detached member
+ */
+void nv_keys_remove(nv_keys_t* keys, const cJSON* item)
+{
+    if (keys->items == NULL || item->string == NULL) {
+        return;
+    }
+
+    for (size_t i = nv_keys_lower_bound(keys, item->string); i < keys->count;
+         i++) {
+        if (keys->items[i] == item) {
+            memmove(&keys->items[i], &keys->items[i + 1],
+                    (keys->count - i - 1) * sizeof(cJSON*));
+            keys->count--;
+            return;
+        }
+
+        if (nv_keys_compare(keys->items[i]->string, item->string) != 0) {
+            return;
+        }
+    }
+}
+
+/**
+ * nv_keys_free
+ * @param keys ordered keys
+ */
+void nv_keys_free(nv_keys_t* keys)
+{
+    free(keys->items);
+    memset(keys, 0, sizeof(nv_keys_t));
+}
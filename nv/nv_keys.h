@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _NV_KEYS_H_
+#define _NV_KEYS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Top level object members ordered by case-insensitive key, members with
+ * the same key keep their document order. Keys sharing a prefix form one
+ * run, found by binary search.
+ */
+typedef struct {
+    cJSON** items;    ///< members, NULL until built
+    size_t count;     ///< ordered members
+    size_t cap;       ///< items capacity
+} nv_keys_t;
+
+/**
+ * nv_keys_compare, case-insensitive order of keys
+ * @param a key
+ * @param b key
+ * @return  <0, 0 or >0 like strcmp
+ */
+int nv_keys_compare(const char* a, const char* b);
+
+/**
+ * nv_keys_prefix, key starts with prefix, case-insensitive
+ * @param key    key
+ * @param prefix prefix
+ * @return       boolean
+ */
+bool nv_keys_prefix(const char* key, const char* prefix);
+
+/**
+ * nv_keys_build, order all members of object
+ * @param keys ordered keys
+ * @param json object
+ * @return     boolean
+ */
+bool nv_keys_build(nv_keys_t* keys, const cJSON* json);
+
+/**
+ * nv_keys_lower_bound
+ * @param keys ordered keys
+ * @param key  key
+ * @return     position of the first member not ordered before key
+ */
+size_t nv_keys_lower_bound(const nv_keys_t* keys, const char* key);
+
+/**
+ * nv_keys_upper_bound
+ * @param keys ordered keys
+ * @param key  key
+ * @return     position of the first member ordered after key
+ */
+size_t nv_keys_upper_bound(const nv_keys_t* keys, const char* key);
+
+/**
+ * nv_keys_insert, order a member just added to the object
+ * @param keys ordered keys, nothing done if not built
+ * @param item object member
+ * @return     boolean
+ */
+bool nv_keys_insert(nv_keys_t* keys, cJSON* item);
+
+/**
+ * nv_keys_remove, drop a member detached from the object
+ * @param keys ordered keys, nothing done if not built
+ * @param item detached member
+ */
+void nv_keys_remove(nv_keys_t* keys, const cJSON* item);
+
+/**
+ * nv_keys_free
+ * @param keys ordered keys
+ */
+void nv_keys_free(nv_keys_t* keys);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_KEYS_H_ */
@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_lz.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NV_LZ_MIN_MATCH    4
+#define NV_LZ_LAST_LITERAL 5        // the block ends with literals
+#define NV_LZ_MATCH_LIMIT  12       // no match starts this close to the end
+#define NV_LZ_WINDOW       65535    // largest match offset
+#define NV_LZ_HASH_BITS    15
+#define NV_LZ_CHAIN_SIZE   65536    // chain links of the last window
+
+/**
+ * nv_lz_read32
+ * @param p bytes
+ * @return  4 bytes in host order
+ */
+static inline uint32_t nv_lz_read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * nv_lz_hash, hash of the 4 bytes at p
+ * @param p bytes
+ * @return  hash table slot
+ */
+static inline uint32_t nv_lz_hash(const uint8_t* p)
+{
+    return (nv_lz_read32(p) * 2654435761u) >> (32 - NV_LZ_HASH_BITS);
+}
+
+/**
+ * nv_lz_length, write the continuation of a length beyond the nibble
+ * @param op  output
+ * @param len length minus 15
+ * @return    output after the length
+ */
+static uint8_t* nv_lz_length(uint8_t* op, size_t len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+
+    return op;
+}
+
+/**
+ * nv_lz_sequence, write literals and an optional match
+ * @param op      output
+ * @param literal literals
+ * @param lit_len literal count
+ * @param offset  match offset, 0 for the last literals only sequence
+ * @param match   match length, at least NV_LZ_MIN_MATCH if offset is set
+ * @return        output after the sequence
+ */
+static uint8_t* nv_lz_sequence(uint8_t* op, const uint8_t* literal,
+                               size_t lit_len, size_t offset, size_t match)
+{
+    uint8_t* token = op++;
+    size_t match_code = offset ? match - NV_LZ_MIN_MATCH : 0;
+
+    *token = (lit_len < 15 ? lit_len : 15) << 4;
+    if (lit_len >= 15) {
+        op = nv_lz_length(op, lit_len - 15);
+    }
+
+    memcpy(op, literal, lit_len);
+    op += lit_len;
+
+    if (offset == 0) {
+        return op;
+    }
+
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+
+    *token |= match_code < 15 ? match_code : 15;
+    if (match_code >= 15) {
+        op = nv_lz_length(op, match_code - 15);
+    }
+
+    return op;
+}
+
+/**
+ * nv_lz_match, check compressed container magic
+ * @param data file content
+ * @param len  file content length
+ * @return     boolean
+ */
+bool nv_lz_match(const char* data, size_t len)
+{
+    return len >= NV_LZ_HEADER_SIZE
+           && memcmp(data, NV_LZ_MAGIC, NV_LZ_MAGIC_LEN) == 0;
+}
+
+typedef struct {
+    const uint8_t* base;    ///< original bytes
+    size_t match_end;       ///< no match extends beyond
+    uint32_t* head;         ///< newest position + 1 of each hash, 0 for none
+    uint16_t* chain;        ///< distance to the previous position of a hash
+    size_t inserted;        ///< positions below are in head and chain
+    uint32_t depth;         ///< chain links searched
+    size_t nice;            ///< match length that ends the search
+} nv_lz_state_t;
+
+/**
+ * nv_lz_insert, link the positions up to pos into their hash chains
+ * @param state compressor state
+ * @param pos   last position to link
+ */
+static void nv_lz_insert(nv_lz_state_t* state, size_t pos)
+{
+    for (; state->inserted <= pos; state->inserted++) {
+        size_t at = state->inserted;
+        uint32_t slot = nv_lz_hash(state->base + at);
+        size_t prev = state->head[slot];
+        size_t distance = prev ? at + 1 - prev : 0;
+
+        state->chain[at & (NV_LZ_CHAIN_SIZE - 1)]
+            = distance <= NV_LZ_WINDOW ? distance : 0;
+        state->head[slot] = at + 1;
+    }
+}
+
+/**
+ * nv_lz_search, longest earlier match of the bytes at pos
+ * @param state  compressor state
+ * @param pos    position, at least NV_LZ_MATCH_LIMIT before the end
+ * @param offset match offset
+ * @return       match length, 0 if none
+ */
+static size_t nv_lz_search(nv_lz_state_t* state, size_t pos, size_t* offset)
+{
+    const uint8_t* base = state->base;
+    uint32_t value = nv_lz_read32(base + pos);
+    size_t candidate = pos;
+    size_t best = 0;
+
+    nv_lz_insert(state, pos);
+
+    for (uint32_t i = 0; i < state->depth; i++) {
+        size_t distance = state->chain[candidate & (NV_LZ_CHAIN_SIZE - 1)];
+        if (distance == 0 || pos - (candidate - distance) > NV_LZ_WINDOW) {
+            break;
+        }
+        candidate -= distance;
+
+        const uint8_t* from = base + candidate;
+        if (nv_lz_read32(from) != value || from[best] != base[pos + best]) {
+            continue;
+        }
+
+        size_t n = NV_LZ_MIN_MATCH;
+        while (pos + n < state->match_end && from[n] == base[pos + n]) {
+            n++;
+        }
+
+        if (n > best) {
+            best = n;
+            *offset = pos - candidate;
+            if (n >= state->nice) {
+                break;
+            }
+        }
+    }
+
+    return best;
+}
+
+/**
+ * nv_lz_compress, compress into a container with greedy hash chain
+ * matching
+ * @param src   original bytes
+ * @param len   original length, below 4 GiB
+ * @param level 1 fastest to NV_LZ_LEVEL_MAX smallest
+ * @param size  container length
+ * @return      container, release by free, NULL on failure
+ */
+char* nv_lz_compress(const char* src, size_t len, int level, size_t* size)
+{
+    if (len > UINT32_MAX) {
+        return NULL;
+    }
+
+    level = level < 1 ? 1 : level > NV_LZ_LEVEL_MAX ? NV_LZ_LEVEL_MAX : level;
+
+    /* incompressible input grows by one length byte per 255 literals */
+    uint8_t* out = malloc(NV_LZ_HEADER_SIZE + len + len / 255 + 16);
+    uint32_t* head = calloc(1u << NV_LZ_HASH_BITS, sizeof(uint32_t));
+    uint16_t* chain = malloc(NV_LZ_CHAIN_SIZE * sizeof(uint16_t));
+    if (out == NULL || head == NULL || chain == NULL) {
+        free(out);
+        free(head);
+        free(chain);
+        return NULL;
+    }
+
+    memcpy(out, NV_LZ_MAGIC, NV_LZ_MAGIC_LEN);
+    for (int i = 0; i < 4; i++) {
+        out[NV_LZ_MAGIC_LEN + i] = (uint64_t)len >> (i * 8);
+    }
+
+    nv_lz_state_t state = {
+        .base = (const uint8_t*)src,
+        .match_end = len > NV_LZ_LAST_LITERAL ? len - NV_LZ_LAST_LITERAL : 0,
+        .head = head,
+        .chain = chain,
+        .depth = 1u << (level - 1),
+        .nice = 16u << (level / 2),
+    };
+
+    const uint8_t* base = state.base;
+    const uint8_t* anchor = base;
+    uint8_t* op = out + NV_LZ_HEADER_SIZE;
+    size_t limit = len > NV_LZ_MATCH_LIMIT ? len - NV_LZ_MATCH_LIMIT : 0;
+
+    for (size_t pos = 0; pos < limit;) {
+        size_t offset = 0;
+        size_t match = nv_lz_search(&state, pos, &offset);
+        if (match == 0) {
+            pos++;
+            continue;
+        }
+
+        op = nv_lz_sequence(op, anchor, base + pos - anchor, offset, match);
+        pos += match;
+        anchor = base + pos;
+    }
+
+    op = nv_lz_sequence(op, anchor, base + len - anchor, 0, 0);
+
+    free(head);
+    free(chain);
+
+    *size = op - out;
+    return (char*)out;
+}
+
+/**
+ * nv_lz_length_read, read the continuation of a length
+ * @param ip  input
+ * @param end input end
+ * @param len length, the continuation is added
+ * @return    input after the length, NULL if truncated
+ */
+static const uint8_t* nv_lz_length_read(const uint8_t* ip, const uint8_t* end,
+                                        size_t* len)
+{
+    uint8_t byte;
+
+    do {
+        if (ip >= end) {
+            return NULL;
+        }
+        byte = *ip++;
+        *len += byte;
+    } while (byte == 255);
+
+    return ip;
+}
+
+/**
+ * nv_lz_decompress, restore the original bytes of a container, every
+ * length and offset is checked against the input and output bounds
+ * @param data container
+ * @param len  container length
+ * @param size original length
+ * @return     original bytes, release by free, NULL if the container is
+ *             invalid
+ */
+char* nv_lz_decompress(const char* data, size_t len, size_t* size)
+{
+    if (nv_lz_match(data, len) == false) {
+        return NULL;
+    }
+
+    const uint8_t* ip = (const uint8_t*)data + NV_LZ_MAGIC_LEN;
+    size_t total = 0;
+    for (int i = 0; i < 4; i++) {
+        total |= (size_t)ip[i] << (i * 8);
+    }
+
+    ip = (const uint8_t*)data + NV_LZ_HEADER_SIZE;
+    const uint8_t* end = (const uint8_t*)data + len;
+
+    /* one spare byte keeps malloc(0) out and lets callers nul terminate */
+    uint8_t* out = malloc(total + 1);
+    if (out == NULL) {
+        return NULL;
+    }
+
+    uint8_t* op = out;
+    uint8_t* op_end = out + total;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15) {
+            ip = nv_lz_length_read(ip, end, &lit_len);
+            if (ip == NULL) {
+                goto fail;
+            }
+        }
+
+        if (lit_len > (size_t)(end - ip) || lit_len > (size_t)(op_end - op)) {
+            goto fail;
+        }
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        /* the last sequence has literals only */
+        if (ip == end) {
+            break;
+        }
+
+        if (end - ip < 2) {
+            goto fail;
+        }
+        size_t offset = ip[0] | ip[1] << 8;
+        ip += 2;
+
+        size_t match = (token & 0x0F) + NV_LZ_MIN_MATCH;
+        if ((token & 0x0F) == 15) {
+            ip = nv_lz_length_read(ip, end, &match);
+            if (ip == NULL) {
+                goto fail;
+            }
+        }
+
+        if (offset == 0 || offset > (size_t)(op - out)
+            || match > (size_t)(op_end - op)) {
+            goto fail;
+        }
+
+        /* an offset below the length repeats the bytes just written, in
+         * steps of the offset so each copy reads finished bytes */
+        const uint8_t* from = op - offset;
+        if (offset >= 8) {
+            while (match > offset) {
+                memcpy(op, from, offset);
+                op += offset;
+                from += offset;
+                match -= offset;
+            }
+            memcpy(op, from, match);
+            op += match;
+        } else {
+            while (match--) {
+                *op++ = *from++;
+            }
+        }
+    }
+
+    if (op != op_end) {
+        goto fail;
+    }
+
+    *size = total;
+    return (char*)out;
+
+fail:
+    free(out);
+    return NULL;
+}
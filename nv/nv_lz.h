@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_LZ_H_
+#define _NV_LZ_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Compressed container of a whole nv file: the magic, the original size as
+ * 32-bit little-endian and one block of LZ4 style sequences, a token with
+ * literal and match length nibbles, 255 continued lengths, the literals and
+ * a 16-bit little-endian match offset into the last 64 KiB.
+ */
+#define NV_LZ_MAGIC       "NVZ1"
+#define NV_LZ_MAGIC_LEN   4
+#define NV_LZ_HEADER_SIZE 8
+#define NV_LZ_LEVEL_MAX   9
+
+/**
+ * nv_lz_match, check compressed container magic
+ * @param data file content
+ * @param len  file content length
+ * @return     boolean
+ */
+bool nv_lz_match(const char* data, size_t len);
+
+/**
+ * nv_lz_compress, compress into a container, the level sets how many
+ * earlier positions of the same hash are searched for a longer match
+ * @param src   original bytes
+ * @param len   original length, below 4 GiB
+ * @param level 1 fastest to NV_LZ_LEVEL_MAX smallest
+ * @param size  container length
+ * @return      container, release by free, NULL on failure
+ */
+char* nv_lz_compress(const char* src, size_t len, int level, size_t* size);
+
+/**
+ * nv_lz_decompress, restore the original bytes of a container
+ * @param data container
+ * @param len  container length
+ * @param size original length
+ * @return     original bytes, release by free, NULL if the container is
+ *             invalid
+ */
+char* nv_lz_decompress(const char* data, size_t len, size_t* size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_LZ_H_ */
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_packed.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "nv_base64.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define NV_PACKED_SWAP 1
+#else
+#define NV_PACKED_SWAP 0
+#endif
+
+/**
+ * nv_packed_swap, reverse the bytes of every element, big-endian hosts only
+ * @param data  elements
+ * @param count number of elements
+ * @param size  element bytes
+ */
+static void nv_packed_swap(uint8_t* data, size_t count, size_t size)
+{
+    for (size_t i = 0; i < count; i++, data += size) {
+        for (size_t j = 0; j < size / 2; j++) {
+            uint8_t byte = data[j];
+            data[j] = data[size - 1 - j];
+            data[size - 1 - j] = byte;
+        }
+    }
+}
+
+/**
+ * nv_packed_info, element layout of a numeric array type, packed or not
+ * @param type data type
+ * @param info element layout
+ * @return     boolean, false if the type has no packed form
+ */
+bool nv_packed_info(nv_data_type_t type, nv_packed_info_t* info)
+{
+    switch (type) {
+    case NV_DATA_INT_ARRAY:
+    case NV_DATA_PACKED_INT_ARRAY:
+        info->tag = "i32";
+        info->size = sizeof(int32_t);
+        return true;
+    case NV_DATA_FLOAT_ARRAY:
+    case NV_DATA_PACKED_FLOAT_ARRAY:
+        info->tag = "f32";
+        info->size = sizeof(float);
+        return true;
+    case NV_DATA_DOUBLE_ARRAY:
+    case NV_DATA_PACKED_DOUBLE_ARRAY:
+        info->tag = "f64";
+        info->size = sizeof(double);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * nv_packed_encode, base64 text of the elements
+ * @param value elements
+ * @param count number of elements
+ * @param size  element bytes
+ * @return      nul terminated text, release by free, NULL on failure
+ */
+char* nv_packed_encode(const void* value, uint32_t count, size_t size)
+{
+    size_t bytes = (size_t)count * size;
+    char* text = malloc(nv_base64_encoded_size(bytes) + 1);
+    if (text == NULL) {
+        return NULL;
+    }
+
+    if (NV_PACKED_SWAP) {
+        uint8_t* copy = malloc(bytes ? bytes : 1);
+        if (copy == NULL) {
+            free(text);
+            return NULL;
+        }
+
+        memcpy(copy, value, bytes);
+        nv_packed_swap(copy, count, size);
+        nv_base64_encode(text, copy, bytes);
+        free(copy);
+    } else {
+        nv_base64_encode(text, value, bytes);
+    }
+
+    return text;
+}
+
+/**
+ * nv_packed_decode, copy at most count elements out of base64 text
+ * @param text  base64 text, not nul terminated
+ * @param len   base64 characters
+ * @param value elements
+ * @param count buffer elements
+ * @param size  element bytes
+ * @return      boolean, false on invalid text
+ */
+bool nv_packed_decode(const char* text, size_t len, void* value,
+                      uint32_t count, size_t size)
+{
+    size_t bytes = 0;
+    if (nv_base64_decode(value, (size_t)count * size, text, len, &bytes)
+        == false) {
+        return false;
+    }
+
+    if (bytes % size != 0) {
+        return false;
+    }
+
+    if (NV_PACKED_SWAP) {
+        size_t elements = bytes / size;
+        nv_packed_swap(value, elements < count ? elements : count, size);
+    }
+
+    return true;
+}
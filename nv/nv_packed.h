@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_PACKED_H_
+#define _NV_PACKED_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A packed array is the object {"packed":"f32","data":"<base64>"}, the data
+ * being the raw little-endian elements. Reading it is one base64 decode
+ * straight into the caller buffer instead of a node and a strtod per element.
+ */
+#define NV_PACKED_KEY  "packed"    ///< element type tag member
+#define NV_PACKED_DATA "data"      ///< base64 elements member
+
+typedef struct {
+    const char* tag;    ///< element type tag, "i32", "f32" or "f64"
+    size_t size;        ///< element bytes
+} nv_packed_info_t;
+
+/**
+ * nv_packed_info, element layout of a numeric array type, packed or not
+ * @param type data type
+ * @param info element layout
+ * @return     boolean, false if the type has no packed form
+ */
+bool nv_packed_info(nv_data_type_t type, nv_packed_info_t* info);
+
+/**
+ * nv_packed_encode, base64 text of the elements
+ * @param value elements
+ * @param count number of elements
+ * @param size  element bytes
+ * @return      nul terminated text, release by free, NULL on failure
+ */
+char* nv_packed_encode(const void* value, uint32_t count, size_t size);
+
+/**
+ * nv_packed_decode, copy at most count elements out of base64 text
+ * @param text  base64 text, not nul terminated
+ * @param len   base64 characters
+ * @param value elements
+ * @param count buffer elements
+ * @param size  element bytes
+ * @return      boolean, false on invalid text
+ */
+bool nv_packed_decode(const char* text, size_t len, void* value,
+                      uint32_t count, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_PACKED_H_ */
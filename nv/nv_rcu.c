@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_rcu.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+static atomic_uint nv_rcu_next_shard;
+static _Thread_local uint32_t nv_rcu_shard = UINT32_MAX;
+
+/**
+ * nv_rcu_thread_shard, spread threads round robin over the shards
+ */
+static uint32_t nv_rcu_thread_shard(void)
+{
+    if (nv_rcu_shard == UINT32_MAX) {
+        nv_rcu_shard = atomic_fetch_add(&nv_rcu_next_shard, 1)
+                       % CONFIG_NV_RCU_SHARDS;
+    }
+
+    return nv_rcu_shard;
+}
+
+/**
+ * nv_rcu_create
+ * @return rcu state, NULL on failure
+ */
+nv_rcu_t* nv_rcu_create(void)
+{
+    void* rcu = NULL;
+
+    if (posix_memalign(&rcu, NV_CACHE_LINE_SIZE, sizeof(nv_rcu_t)) != 0) {
+        return NULL;
+    }
+
+    memset(rcu, 0, sizeof(nv_rcu_t));
+    return rcu;
+}
+
+/**
+ * nv_rcu_destroy
+ * @param rcu rcu state, no reader may be active
+ */
+void nv_rcu_destroy(nv_rcu_t* rcu)
+{
+    free(rcu);
+}
+
+/**
+ * nv_rcu_read_lock, enter read side critical section, never blocks
+ * @param rcu rcu state
+ * @return    token for nv_rcu_read_unlock
+ */
+uint32_t nv_rcu_read_lock(nv_rcu_t* rcu)
+{
+    uint32_t shard = nv_rcu_thread_shard();
+
+    for (;;) {
+        uint32_t phase = atomic_load(&rcu->phase);
+        atomic_fetch_add(&rcu->shards[shard].count[phase], 1);
+
+        /*
+         * registered before the phase flipped, so the flipping writer waits
+         * for us, otherwise step back and register in the new phase
+         */
+        if (atomic_load(&rcu->phase) == phase) {
+            return shard << 1 | phase;
+        }
+
+        atomic_fetch_sub(&rcu->shards[shard].count[phase], 1);
+    }
+}
+
+/**
+ * nv_rcu_read_unlock
+ * @param rcu   rcu state
+ * @param token token of nv_rcu_read_lock
+ */
+void nv_rcu_read_unlock(nv_rcu_t* rcu, uint32_t token)
+{
+    atomic_fetch_sub(&rcu->shards[token >> 1].count[token & 1], 1);
+}
+
+/**
+ * nv_rcu_synchronize, wait for readers that may see an unpublished pointer
+ * writers must be serialized by the caller
+ * @param rcu rcu state
+ */
+void nv_rcu_synchronize(nv_rcu_t* rcu)
+{
+    uint32_t phase = atomic_load(&rcu->phase);
+
+    atomic_store(&rcu->phase, phase ^ 1);
+
+    /*
+     * a reader that loaded the old pointer registered in the old phase, and
+     * one registered before an earlier flip was already waited for then
+     */
+    for (uint32_t i = 0; i < CONFIG_NV_RCU_SHARDS; i++) {
+        while (atomic_load(&rcu->shards[i].count[phase]) != 0) {
+            sched_yield();
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_RCU_H_
+#define _NV_RCU_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_NV_RCU_SHARDS
+#define CONFIG_NV_RCU_SHARDS 64
+#endif
+
+#define NV_CACHE_LINE_SIZE 64
+
+/*
+ * Reader counters for one phase pair, one cache line per shard so readers on
+ * different threads never write the same line.
+ */
+typedef struct {
+    _Alignas(NV_CACHE_LINE_SIZE) atomic_uint count[2];
+} nv_rcu_shard_t;
+
+/*
+ * Read-copy-update grace period tracking. Readers register in the shard of
+ * their thread under the current phase, the writer flips the phase and waits
+ * for the old phase to drain before freeing what it unpublished.
+ */
+typedef struct {
+    atomic_uint phase;                              ///< current phase, 0 or 1
+    nv_rcu_shard_t shards[CONFIG_NV_RCU_SHARDS];    ///< reader counters
+} nv_rcu_t;
+
+/**
+ * nv_rcu_create
+ * @return rcu state, NULL on failure
+ */
+nv_rcu_t* nv_rcu_create(void);
+
+/**
+ * nv_rcu_destroy
+ * @param rcu rcu state, no reader may be active
+ */
+void nv_rcu_destroy(nv_rcu_t* rcu);
+
+/**
+ * nv_rcu_read_lock, enter read side critical section, never blocks
+ * @param rcu rcu state
+ * @return    token for nv_rcu_read_unlock
+ */
+uint32_t nv_rcu_read_lock(nv_rcu_t* rcu);
+
+/**
+ * nv_rcu_read_unlock
+ * @param rcu   rcu state
+ * @param token token of nv_rcu_read_lock
+ */
+void nv_rcu_read_unlock(nv_rcu_t* rcu, uint32_t token);
+
+/**
+ * nv_rcu_synchronize, wait for readers that may see an unpublished pointer
+ * writers must be serialized by the caller
+ * @param rcu rcu state
+ */
+void nv_rcu_synchronize(nv_rcu_t* rcu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_RCU_H_ */
@@ -0,0 +1,1084 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_scan.h"
+
+#include "cJSON.h"
+#include "nv_bytes.h"
+#include "nv_packed.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef UNUSED
+#define UNUSED(x) ((void)(x))
+#endif /* UNUSED */
+
+#define NV_SCAN_NUMBER_SIZE 64
+#define NV_SCAN_ADDR_SIZE   72
+
+/* containers below the top level object, one less than cJSON allows */
+#define NV_SCAN_DEPTH_MAX (CJSON_NESTING_LIMIT - 1)
+
+/* bytes that end a run of string text */
+static const nv_byteset_t nv_scan_string_stops = { 2, { '"', '\\' } };
+
+typedef struct {
+    const char* p;      ///< cursor
+    const char* end;    ///< end of text
+} nv_scan_t;
+
+static void nv_scan_space(nv_scan_t* s)
+{
+    /* same as cJSON, every control character counts as white space */
+    while (s->p < s->end && (unsigned char)*s->p <= ' ') {
+        s->p++;
+    }
+}
+
+/**
+ * nv_scan_string_end, find the closing quote or the next escape
+ */
+static const char* nv_scan_string_end(const char* p, const char* end)
+{
+    return nv_bytes_find(p, end, &nv_scan_string_stops);
+}
+
+static int nv_scan_hex4(const char* p)
+{
+    int value = 0;
+
+    for (int i = 0; i < 4; i++) {
+        int c = (unsigned char)p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+
+    return value;
+}
+
+/**
+ * nv_scan_unicode, decode \uXXXX (and a trailing low surrogate) to utf-8
+ * @return bytes written to out, 0 if invalid
+ */
+static size_t nv_scan_unicode(nv_scan_t* s, char* out)
+{
+    if (s->end - s->p < 6) {
+        return 0;
+    }
+
+    int code = nv_scan_hex4(s->p + 2);
+    if (code < 0 || (code >= 0xDC00 && code <= 0xDFFF)) {
+        return 0;
+    }
+    s->p += 6;
+
+    uint32_t codepoint = code;
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        if (s->end - s->p < 6 || s->p[0] != '\\' || s->p[1] != 'u') {
+            return 0;
+        }
+
+        int low = nv_scan_hex4(s->p + 2);
+        if (low < 0xDC00 || low > 0xDFFF) {
+            return 0;
+        }
+        s->p += 6;
+
+        codepoint = 0x10000 + (((uint32_t)code & 0x3FF) << 10)
+                    + ((uint32_t)low & 0x3FF);
+    }
+
+    if (codepoint < 0x80) {
+        out[0] = codepoint;
+        return 1;
+    } else if (codepoint < 0x800) {
+        out[0] = 0xC0 | (codepoint >> 6);
+        out[1] = 0x80 | (codepoint & 0x3F);
+        return 2;
+    } else if (codepoint < 0x10000) {
+        out[0] = 0xE0 | (codepoint >> 12);
+        out[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+        out[2] = 0x80 | (codepoint & 0x3F);
+        return 3;
+    }
+
+    out[0] = 0xF0 | (codepoint >> 18);
+    out[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+    out[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+    out[3] = 0x80 | (codepoint & 0x3F);
+    return 4;
+}
+
+/**
+ * nv_scan_skip_string, cursor at the opening quote, moved past the closing
+ * escapes are checked the way cJSON decodes them
+ */
+static bool nv_scan_skip_string(nv_scan_t* s)
+{
+    const char* p = s->p + 1;
+
+    for (;;) {
+        p = nv_scan_string_end(p, s->end);
+        if (p >= s->end) {
+            return false;
+        }
+
+        if (*p == '"') {
+            s->p = p + 1;
+            return true;
+        }
+
+        if (s->end - p < 2 || strchr("\"\\/bfnrtu", p[1]) == NULL) {
+            return false;
+        }
+
+        if (p[1] == 'u') {
+            nv_scan_t unicode = { p, s->end };
+            char out[4];
+
+            if (nv_scan_unicode(&unicode, out) == 0) {
+                return false;
+            }
+            p = unicode.p;
+        } else {
+            p += 2;
+        }
+    }
+}
+
+/**
+ * nv_scan_skip_name, step over a member name and its colon
+ */
+static bool nv_scan_skip_name(nv_scan_t* s)
+{
+    if (s->p >= s->end || *s->p != '"' || nv_scan_skip_string(s) == false) {
+        return false;
+    }
+
+    nv_scan_space(s);
+    if (s->p >= s->end || *s->p != ':') {
+        return false;
+    }
+    s->p++;
+    nv_scan_space(s);
+
+    return true;
+}
+
+/**
+ * nv_scan_decimal, convert a plain decimal of up to 15 digits, both the
+ * digits and the power of ten are exact doubles, so one division rounds
+ * the way strtod does
+ * @return boolean, false if text needs strtod
+ */
+static bool nv_scan_decimal(const char* text, size_t n, double* number)
+{
+    static const double powers[] = { 1e0,  1e1,  1e2,  1e3,  1e4, 1e5,
+                                     1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15 };
+    bool negative = n && text[0] == '-';
+    bool point = false;
+    uint64_t mantissa = 0;
+    size_t digits = 0;
+    size_t scale = 0;
+
+    for (size_t i = negative; i < n; i++) {
+        if (text[i] == '.' && point == false) {
+            point = true;
+            continue;
+        }
+
+        if (text[i] < '0' || text[i] > '9' || ++digits > 15) {
+            return false;
+        }
+
+        mantissa = mantissa * 10 + (text[i] - '0');
+        scale += point;
+    }
+
+    if (digits == 0) {
+        return false;
+    }
+
+    double value = (double)mantissa / powers[scale];
+    *number = negative ? -value : value;
+    return true;
+}
+
+/**
+ * nv_scan_number, copy a number token and convert it like cJSON
+ * @param s      scanner
+ * @param text   token output, NV_SCAN_NUMBER_SIZE bytes
+ * @param number converted value
+ * @return       boolean
+ */
+static bool nv_scan_number(nv_scan_t* s, char* text, double* number)
+{
+    size_t n = 0;
+
+    while (s->p < s->end && n < NV_SCAN_NUMBER_SIZE - 1
+           && ((*s->p >= '0' && *s->p <= '9') || *s->p == '+' || *s->p == '-'
+               || *s->p == '.' || *s->p == 'e' || *s->p == 'E')) {
+        text[n++] = *s->p++;
+    }
+    text[n] = '\0';
+
+    if (nv_scan_decimal(text, n, number)) {
+        return true;
+    }
+
+    char* end = NULL;
+    *number = strtod(text, &end);
+
+    return n > 0 && end == text + n;
+}
+
+/**
+ * nv_scan_digit
+ */
+static bool nv_scan_digit(const nv_scan_t* s, const char* p)
+{
+    return p < s->end && *p >= '0' && *p <= '9';
+}
+
+/**
+ * nv_scan_skip_number, step over a number token cJSON converts whole,
+ * checked by its form alone, no conversion
+ */
+static bool nv_scan_skip_number(nv_scan_t* s)
+{
+    const char* p = s->p;
+    size_t digits = 0;
+
+    if (p < s->end && *p == '-') {
+        p++;
+    }
+
+    for (; nv_scan_digit(s, p); p++) {
+        digits++;
+    }
+
+    if (p < s->end && *p == '.') {
+        for (p++; nv_scan_digit(s, p); p++) {
+            digits++;
+        }
+    }
+
+    if (digits == 0) {
+        return false;
+    }
+
+    if (p < s->end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < s->end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+
+        if (nv_scan_digit(s, p) == false) {
+            return false;
+        }
+
+        while (nv_scan_digit(s, p)) {
+            p++;
+        }
+    }
+
+    /* cJSON converts at most 63 bytes of [0-9+-.eE], anything of that set
+     * left over after strtod stops is never valid where a value ends */
+    if (p - s->p >= NV_SCAN_NUMBER_SIZE
+        || (p < s->end && (nv_scan_digit(s, p) || *p == '+' || *p == '-'
+                           || *p == '.' || *p == 'e' || *p == 'E'))) {
+        return false;
+    }
+
+    s->p = p;
+    return true;
+}
+
+/**
+ * nv_scan_skip_scalar, step over a literal or a number token
+ */
+static bool nv_scan_skip_scalar(nv_scan_t* s)
+{
+    static const char* const literals[] = { "null", "false", "true" };
+
+    for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); i++) {
+        size_t size = strlen(literals[i]);
+
+        if ((size_t)(s->end - s->p) >= size
+            && memcmp(s->p, literals[i], size) == 0) {
+            s->p += size;
+            return true;
+        }
+    }
+
+    if (*s->p != '-' && (*s->p < '0' || *s->p > '9')) {
+        return false;
+    }
+
+    return nv_scan_skip_number(s);
+}
+
+/**
+ * nv_scan_skip_value, step over any value without decoding it, the value
+ * must be one the full parser accepts, containers have to close with their
+ * own kind of bracket
+ */
+static bool nv_scan_skip_value(nv_scan_t* s)
+{
+    char closers[NV_SCAN_DEPTH_MAX];
+    uint32_t depth = 0;
+
+    for (;;) {
+        if (s->p >= s->end) {
+            return false;
+        }
+
+        if (*s->p == '"') {
+            if (nv_scan_skip_string(s) == false) {
+                return false;
+            }
+        } else if (*s->p == '{' || *s->p == '[') {
+            if (depth == NV_SCAN_DEPTH_MAX) {
+                return false;
+            }
+            closers[depth++] = *s->p == '{' ? '}' : ']';
+            s->p++;
+            nv_scan_space(s);
+
+            if (s->p >= s->end) {
+                return false;
+            }
+
+            if (*s->p != closers[depth - 1]) {
+                if (closers[depth - 1] == '}'
+                    && nv_scan_skip_name(s) == false) {
+                    return false;
+                }
+                continue;
+            }
+            depth--;
+            s->p++;
+        } else if (nv_scan_skip_scalar(s) == false) {
+            return false;
+        }
+
+        /* close what ends here, then the next element or member */
+        for (;;) {
+            if (depth == 0) {
+                return true;
+            }
+
+            nv_scan_space(s);
+            if (s->p >= s->end) {
+                return false;
+            }
+
+            if (*s->p != closers[depth - 1]) {
+                break;
+            }
+            depth--;
+            s->p++;
+        }
+
+        if (*s->p != ',') {
+            return false;
+        }
+        s->p++;
+        nv_scan_space(s);
+
+        if (closers[depth - 1] == '}' && nv_scan_skip_name(s) == false) {
+            return false;
+        }
+    }
+}
+
+/**
+ * nv_scan_key, compare a member name with key, cursor at the opening quote
+ * @return 1 match, 0 other key, -1 not handled
+ */
+static int nv_scan_key(nv_scan_t* s, const char* key)
+{
+    const unsigned char* k = (const unsigned char*)key;
+    const char* p = s->p + 1;
+    bool match = true;
+
+    for (; p < s->end && *p != '"'; p++) {
+        /* escaped names are left to the full parser */
+        if (*p == '\\') {
+            return -1;
+        }
+
+        if (match && *k && tolower((unsigned char)*p) == tolower(*k)) {
+            k++;
+        } else {
+            match = false;
+        }
+    }
+
+    if (p >= s->end) {
+        return -1;
+    }
+
+    s->p = p + 1;
+    return match && *k == '\0';
+}
+
+/**
+ * nv_scan_string, decode a string value, cursor at the opening quote
+ * @param s    scanner
+ * @param out  nul terminated output
+ * @param size output size
+ * @return     boolean, false if invalid or longer than size
+ */
+static bool nv_scan_string(nv_scan_t* s, char* out, size_t size)
+{
+    size_t n = 0;
+
+    if (s->p >= s->end || *s->p != '"') {
+        return false;
+    }
+    s->p++;
+
+    for (;;) {
+        const char* p = nv_scan_string_end(s->p, s->end);
+        if (p >= s->end) {
+            return false;
+        }
+
+        size_t chunk = p - s->p;
+        if (chunk >= size - n) {
+            return false;
+        }
+        memcpy(out + n, s->p, chunk);
+        n += chunk;
+        s->p = p;
+
+        if (*p == '"') {
+            s->p++;
+            out[n] = '\0';
+            return true;
+        }
+
+        /* escape, the longest expansion is 4 utf-8 bytes */
+        if (s->end - p < 2 || size - n < 5) {
+            return false;
+        }
+
+        switch (p[1]) {
+        case '"':
+        case '\\':
+        case '/':
+            out[n++] = p[1];
+            break;
+        case 'b':
+            out[n++] = '\b';
+            break;
+        case 'f':
+            out[n++] = '\f';
+            break;
+        case 'n':
+            out[n++] = '\n';
+            break;
+        case 'r':
+            out[n++] = '\r';
+            break;
+        case 't':
+            out[n++] = '\t';
+            break;
+        case 'u': {
+            /* a \u0000 ends the cJSON string early, leave it to cJSON */
+            size_t bytes = nv_scan_unicode(s, out + n);
+            if (bytes == 0 || out[n] == '\0') {
+                return false;
+            }
+            n += bytes;
+            continue;
+        }
+        default:
+            return false;
+        }
+
+        s->p += 2;
+    }
+}
+
+/**
+ * nv_scan_valueint, saturate like cJSON valueint
+ */
+static int nv_scan_valueint(double number)
+{
+    if (number >= INT_MAX) {
+        return INT_MAX;
+    } else if (number <= (double)INT_MIN) {
+        return INT_MIN;
+    }
+
+    return (int)number;
+}
+
+/**
+ * nv_scan_array, decode at most len array elements in place, cursor at '['
+ * the elements beyond are still checked like the full parser does
+ */
+static nv_scan_result_t nv_scan_array(nv_scan_t* s, char* value,
+                                      uint32_t len, nv_data_type_t type)
+{
+    char text[NV_SCAN_NUMBER_SIZE];
+    double number = 0;
+
+    if (s->p >= s->end || *s->p != '[') {
+        return NV_SCAN_FALLBACK;
+    }
+    s->p++;
+    nv_scan_space(s);
+
+    if (s->p < s->end && *s->p == ']') {
+        return NV_SCAN_FOUND;
+    }
+
+    for (size_t i = 0;; i++) {
+        if (type == NV_DATA_STRING_ARRAY) {
+            if (i >= len) {
+                if (s->p >= s->end || *s->p != '"'
+                    || nv_scan_skip_string(s) == false) {
+                    return NV_SCAN_FALLBACK;
+                }
+            } else if (nv_scan_string(s, ((char**)value)[i], SIZE_MAX)
+                       == false) {
+                return NV_SCAN_FALLBACK;
+            }
+        } else {
+            if (nv_scan_number(s, text, &number) == false) {
+                return NV_SCAN_FALLBACK;
+            }
+
+            if (i < len && type == NV_DATA_INT_ARRAY) {
+                *((int32_t*)value + i) = nv_scan_valueint(number);
+            } else if (i < len && type == NV_DATA_FLOAT_ARRAY) {
+                *((float*)value + i) = number;
+            } else if (i < len) {
+                *((double*)value + i) = number;
+            }
+        }
+
+        nv_scan_space(s);
+        if (s->p >= s->end) {
+            return NV_SCAN_FALLBACK;
+        }
+
+        if (*s->p == ']') {
+            return NV_SCAN_FOUND;
+        }
+
+        if (*s->p != ',') {
+            return NV_SCAN_FALLBACK;
+        }
+        s->p++;
+        nv_scan_space(s);
+    }
+}
+
+/**
+ * nv_scan_span, unescaped string text, cursor at the opening quote and moved
+ * past the closing one
+ * @return false on an escape or an unterminated string
+ */
+static bool nv_scan_span(nv_scan_t* s, const char** text, size_t* size)
+{
+    if (s->p >= s->end || *s->p != '"') {
+        return false;
+    }
+
+    const char* start = s->p + 1;
+    const char* p = nv_scan_string_end(start, s->end);
+    if (p >= s->end || *p != '"') {
+        return false;
+    }
+
+    *text = start;
+    *size = p - start;
+    s->p = p + 1;
+    return true;
+}
+
+/**
+ * nv_scan_is, span equals the nul terminated str
+ */
+static bool nv_scan_is(const char* text, size_t size, const char* str)
+{
+    return strlen(str) == size && memcmp(text, str, size) == 0;
+}
+
+/**
+ * nv_scan_packed, decode a packed array object in place, cursor at '{'
+ * members match like cJSON_GetObjectItemCaseSensitive, the first one wins,
+ * and the base64 text is decoded straight out of the json text
+ */
+static nv_scan_result_t nv_scan_packed(nv_scan_t* s, char* value,
+                                       uint32_t len, nv_data_type_t type)
+{
+    nv_packed_info_t info;
+    const char* tag = NULL;
+    const char* data = NULL;
+    size_t tag_size = 0;
+    size_t data_size = 0;
+
+    if (nv_packed_info(type, &info) == false) {
+        return NV_SCAN_FALLBACK;
+    }
+    s->p++;
+    nv_scan_space(s);
+
+    while (s->p < s->end && *s->p != '}') {
+        const char* name = NULL;
+        size_t size = 0;
+
+        /* escaped names or values are left to the full parser */
+        if (nv_scan_span(s, &name, &size) == false) {
+            return NV_SCAN_FALLBACK;
+        }
+
+        nv_scan_space(s);
+        if (s->p >= s->end || *s->p != ':') {
+            return NV_SCAN_FALLBACK;
+        }
+        s->p++;
+        nv_scan_space(s);
+
+        bool ok;
+        if (tag == NULL && nv_scan_is(name, size, NV_PACKED_KEY)) {
+            ok = nv_scan_span(s, &tag, &tag_size);
+        } else if (data == NULL && nv_scan_is(name, size, NV_PACKED_DATA)) {
+            ok = nv_scan_span(s, &data, &data_size);
+        } else {
+            ok = nv_scan_skip_value(s);
+        }
+
+        if (ok == false) {
+            return NV_SCAN_FALLBACK;
+        }
+
+        nv_scan_space(s);
+        if (s->p < s->end && *s->p == ',') {
+            s->p++;
+            nv_scan_space(s);
+        } else if (s->p >= s->end || *s->p != '}') {
+            return NV_SCAN_FALLBACK;
+        }
+    }
+
+    if (s->p >= s->end || tag == NULL || data == NULL
+        || nv_scan_is(tag, tag_size, info.tag) == false
+        || nv_packed_decode(data, data_size, value, len, info.size) == false) {
+        return NV_SCAN_FALLBACK;
+    }
+    s->p++;
+
+    return NV_SCAN_FOUND;
+}
+
+/**
+ * nv_scan_decode, decode the value of the matched key into the typed buffer,
+ * anything nv_json_get would read differently is left to the full parser
+ */
+static nv_scan_result_t nv_scan_decode(nv_scan_t* s, char* value,
+                                       uint32_t len, nv_data_type_t type)
+{
+    char text[NV_SCAN_NUMBER_SIZE];
+    char addr[NV_SCAN_ADDR_SIZE];
+    double number = 0;
+
+    switch (type) {
+    case NV_DATA_U8:
+    case NV_DATA_S8:
+    case NV_DATA_U16:
+    case NV_DATA_S16:
+    case NV_DATA_U32:
+    case NV_DATA_S32: {
+        if (nv_scan_number(s, text, &number) == false) {
+            return NV_SCAN_FALLBACK;
+        }
+
+        int valueint = nv_scan_valueint(number);
+        if (type == NV_DATA_U8) {
+            *(uint8_t*)value = valueint;
+        } else if (type == NV_DATA_S8) {
+            *(int8_t*)value = valueint;
+        } else if (type == NV_DATA_U16) {
+            *(uint16_t*)value = valueint;
+        } else if (type == NV_DATA_S16) {
+            *(int16_t*)value = valueint;
+        } else if (type == NV_DATA_U32) {
+            *(uint32_t*)value = valueint;
+        } else {
+            *(int32_t*)value = valueint;
+        }
+        break;
+    }
+    case NV_DATA_U64:
+    case NV_DATA_S64:
+        if (nv_scan_number(s, text, &number) == false) {
+            return NV_SCAN_FALLBACK;
+        }
+
+        /* from the double like the tree, a file keeps no raw items */
+        if (type == NV_DATA_U64) {
+            *(uint64_t*)value = number;
+        } else {
+            *(int64_t*)value = number;
+        }
+        break;
+    case NV_DATA_FLOAT:
+    case NV_DATA_DOUBLE:
+        if (nv_scan_number(s, text, &number) == false) {
+            return NV_SCAN_FALLBACK;
+        }
+
+        if (type == NV_DATA_FLOAT) {
+            *(float*)value = number;
+        } else {
+            *(double*)value = number;
+        }
+        break;
+    case NV_DATA_STR:
+        /* a string longer than the buffer fails on the full parser too */
+        if (nv_scan_string(s, value, len) == false) {
+            return NV_SCAN_FALLBACK;
+        }
+        break;
+    case NV_DATA_INT_ARRAY:
+    case NV_DATA_FLOAT_ARRAY:
+    case NV_DATA_DOUBLE_ARRAY:
+    case NV_DATA_PACKED_INT_ARRAY:
+    case NV_DATA_PACKED_FLOAT_ARRAY:
+    case NV_DATA_PACKED_DOUBLE_ARRAY:
+        /* either layout reads into the same buffer, as in nv_json_get */
+        if (s->p < s->end && *s->p == '{') {
+            return nv_scan_packed(s, value, len, type);
+        }
+
+        if (type == NV_DATA_PACKED_INT_ARRAY) {
+            type = NV_DATA_INT_ARRAY;
+        } else if (type == NV_DATA_PACKED_FLOAT_ARRAY) {
+            type = NV_DATA_FLOAT_ARRAY;
+        } else if (type == NV_DATA_PACKED_DOUBLE_ARRAY) {
+            type = NV_DATA_DOUBLE_ARRAY;
+        }
+        return nv_scan_array(s, value, len, type);
+    case NV_DATA_STRING_ARRAY:
+        return nv_scan_array(s, value, len, type);
+    case NV_DATA_IP:
+    case NV_DATA_MAC: {
+        if (len < (type == NV_DATA_IP ? 4 : 6)
+            || nv_scan_string(s, addr, sizeof(addr)) == false) {
+            return NV_SCAN_FALLBACK;
+        }
+
+        int* data = (int*)value;
+        if (type == NV_DATA_IP) {
+            sscanf(addr, "%d.%d.%d.%d", &data[0], &data[1], &data[2],
+                   &data[3]);
+        } else {
+            sscanf(addr, "%d-%d-%d-%d-%d-%d", &data[0], &data[1], &data[2],
+                   &data[3], &data[4], &data[5]);
+        }
+        break;
+    }
+    default:
+        return NV_SCAN_FALLBACK;
+    }
+
+    return NV_SCAN_FOUND;
+}
+
+/**
+ * nv_scan_get, find one top level key in json text and decode its value
+ * without building a tree, keys match like cJSON_GetObjectItem, the rest of
+ * the text is still checked so a file the full parser rejects falls back
+ * @param data  json text, not nul terminated
+ * @param size  json text length
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      scan result
+ */
+nv_scan_result_t nv_scan_get(const char* data, size_t size, const char* key,
+                             char* value, uint32_t len, nv_data_type_t type)
+{
+    nv_scan_t s = { data, data + size };
+
+    if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        s.p += 3;
+    }
+
+    nv_scan_space(&s);
+    if (s.p >= s.end || *s.p != '{') {
+        return NV_SCAN_FALLBACK;
+    }
+    s.p++;
+    nv_scan_space(&s);
+
+    const char* found = NULL;
+
+    if (s.p >= s.end || *s.p != '}') {
+        for (;;) {
+            if (s.p >= s.end || *s.p != '"') {
+                return NV_SCAN_FALLBACK;
+            }
+
+            int match = nv_scan_key(&s, key);
+            if (match < 0) {
+                return NV_SCAN_FALLBACK;
+            }
+
+            nv_scan_space(&s);
+            if (s.p >= s.end || *s.p != ':') {
+                return NV_SCAN_FALLBACK;
+            }
+            s.p++;
+            nv_scan_space(&s);
+
+            /* the first member wins, as in cJSON_GetObjectItem */
+            if (match && found == NULL) {
+                found = s.p;
+            }
+
+            if (nv_scan_skip_value(&s) == false) {
+                return NV_SCAN_FALLBACK;
+            }
+
+            nv_scan_space(&s);
+            if (s.p < s.end && *s.p == '}') {
+                break;
+            }
+
+            if (s.p >= s.end || *s.p != ',') {
+                return NV_SCAN_FALLBACK;
+            }
+            s.p++;
+            nv_scan_space(&s);
+        }
+    }
+    s.p++;
+
+    /* a value is only reported once the whole text is known to parse, a
+     * broken file has to fail here the same way it fails in nv_load */
+    nv_scan_space(&s);
+    if (s.p < s.end) {
+        return NV_SCAN_FALLBACK;
+    }
+
+    if (found == NULL) {
+        return NV_SCAN_MISSING;
+    }
+    s.p = found;
+
+    return nv_scan_decode(&s, value, len, type);
+}
+
+/**
+ * nv_scan_text, decode a string into a new buffer, cursor at the opening
+ * quote, text without escapes is copied in one piece
+ * @return buffer from cJSON_malloc, NULL if invalid
+ */
+static char* nv_scan_text(nv_scan_t* s)
+{
+    const char* start = s->p + 1;
+    const char* p = nv_scan_string_end(start, s->end);
+
+    if (p < s->end && *p == '"') {
+        size_t size = p - start;
+        char* out = cJSON_malloc(size + 1);
+        if (out) {
+            memcpy(out, start, size);
+            out[size] = '\0';
+            s->p = p + 1;
+        }
+        return out;
+    }
+
+    /* escapes only shrink the text, the spare bytes let nv_scan_string
+     * take any escape up to the closing quote */
+    nv_scan_t probe = *s;
+    if (nv_scan_skip_string(&probe) == false) {
+        return NULL;
+    }
+
+    size_t size = probe.p - s->p + 4;
+    char* out = cJSON_malloc(size);
+    if (out && nv_scan_string(s, out, size) == false) {
+        cJSON_free(out);
+        return NULL;
+    }
+
+    return out;
+}
+
+/**
+ * nv_scan_parse_value, build the item of the value at the cursor the way
+ * cJSON parse_value does
+ * @param s     scanner
+ * @param depth containers around the value
+ * @return      item, NULL if invalid
+ */
+static cJSON* nv_scan_parse_value(nv_scan_t* s, uint32_t depth)
+{
+    size_t left = s->end - s->p;
+    cJSON* item = NULL;
+
+    if (left >= 4 && memcmp(s->p, "null", 4) == 0) {
+        s->p += 4;
+        return cJSON_CreateNull();
+    } else if (left >= 5 && memcmp(s->p, "false", 5) == 0) {
+        s->p += 5;
+        return cJSON_CreateFalse();
+    } else if (left >= 4 && memcmp(s->p, "true", 4) == 0) {
+        s->p += 4;
+        item = cJSON_CreateTrue();
+        if (item) {
+            item->valueint = 1;
+        }
+        return item;
+    } else if (left == 0) {
+        return NULL;
+    }
+
+    if (*s->p == '"') {
+        char* text = nv_scan_text(s);
+        item = text ? cJSON_CreateNull() : NULL;
+        if (item == NULL) {
+            cJSON_free(text);
+            return NULL;
+        }
+
+        item->type = cJSON_String;
+        item->valuestring = text;
+        return item;
+    }
+
+    if (*s->p == '-' || (*s->p >= '0' && *s->p <= '9')) {
+        char text[NV_SCAN_NUMBER_SIZE];
+        double number = 0;
+
+        return nv_scan_number(s, text, &number) ? cJSON_CreateNumber(number)
+                                                : NULL;
+    }
+
+    if ((*s->p != '{' && *s->p != '[') || depth >= CJSON_NESTING_LIMIT) {
+        return NULL;
+    }
+
+    bool object = *s->p == '{';
+    char closer = object ? '}' : ']';
+
+    item = object ? cJSON_CreateObject() : cJSON_CreateArray();
+    if (item == NULL) {
+        return NULL;
+    }
+    s->p++;
+    nv_scan_space(s);
+
+    if (s->p < s->end && *s->p == closer) {
+        s->p++;
+        return item;
+    }
+
+    for (;;) {
+        char* key = NULL;
+
+        if (object) {
+            if (s->p >= s->end || *s->p != '"'
+                || (key = nv_scan_text(s)) == NULL) {
+                break;
+            }
+
+            nv_scan_space(s);
+            if (s->p >= s->end || *s->p != ':') {
+                cJSON_free(key);
+                break;
+            }
+            s->p++;
+            nv_scan_space(s);
+        }
+
+        cJSON* child = nv_scan_parse_value(s, depth + 1);
+        if (child == NULL) {
+            cJSON_free(key);
+            break;
+        }
+
+        child->string = key;
+        cJSON_AddItemToArray(item, child);
+
+        nv_scan_space(s);
+        if (s->p < s->end && *s->p == closer) {
+            s->p++;
+            return item;
+        }
+
+        if (s->p >= s->end || *s->p != ',') {
+            break;
+        }
+        s->p++;
+        nv_scan_space(s);
+    }
+
+    cJSON_Delete(item);
+    return NULL;
+}
+
+/**
+ * nv_scan_parse, build the tree of a json object text, the tree is the one
+ * cJSON_ParseWithLength builds, strings are copied a run at a time
+ * @param data json text, not nul terminated
+ * @param size json text length
+ * @return     tree, NULL if the text is not a well formed object, cJSON then
+ *             decides, it also accepts other top level values and some
+ *             truncated text
+ */
+cJSON* nv_scan_parse(const char* data, size_t size)
+{
+    nv_scan_t s = { data, data + size };
+
+    /* cJSON only looks for the mark in text of 5 bytes or more */
+    if (size >= 5 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        s.p += 3;
+    }
+
+    nv_scan_space(&s);
+    if (s.p >= s.end || *s.p != '{') {
+        return NULL;
+    }
+
+    /* text after the object is ignored, as cJSON_ParseWithLength does */
+    return nv_scan_parse_value(&s, 0);
+}
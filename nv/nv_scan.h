@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_SCAN_H_
+#define _NV_SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cJSON.h"
+#include "nv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    NV_SCAN_FOUND = 0,    ///< value decoded into the caller buffer
+    NV_SCAN_MISSING,      ///< top level object has no such key
+    NV_SCAN_FALLBACK,     ///< not handled here, use the full parser
+} nv_scan_result_t;
+
+/**
+ * nv_scan_get, find one top level key in json text and decode its value
+ * without building a tree, keys match like cJSON_GetObjectItem, the rest of
+ * the text is still checked so a file the full parser rejects falls back
+ * @param data  json text, not nul terminated
+ * @param size  json text length
+ * @param key   nv key
+ * @param value data buffer
+ * @param len   data buffer length
+ * @param type  data type
+ * @return      scan result
+ */
+nv_scan_result_t nv_scan_get(const char* data, size_t size, const char* key,
+                             char* value, uint32_t len, nv_data_type_t type);
+
+/**
+ * nv_scan_parse, build the tree of a json object text, the tree is the one
+ * cJSON_ParseWithLength builds, strings are copied a run at a time
+ * @param data json text, not nul terminated
+ * @param size json text length
+ * @return     tree, NULL if the text is not a well formed object, cJSON then
+ *             decides, it also accepts other top level values and some
+ *             truncated text
+ */
+cJSON* nv_scan_parse(const char* data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_SCAN_H_ */
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "nv_stats.h"
+
+#include <string.h>
+#include <time.h>
+
+static nv_stats_data_t nv_stats_process;
+
+static _Thread_local nv_stats_data_t* nv_stats_current;
+
+uint64_t nv_stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * nv_stats_bucket, log2 bucket of a latency
+ */
+static unsigned nv_stats_bucket(uint64_t ns)
+{
+    unsigned bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+
+    return bucket < NV_STATS_BUCKETS ? bucket : NV_STATS_BUCKETS - 1;
+}
+
+static void nv_stats_hist_add(nv_stats_hist_data_t* hist, uint64_t ns)
+{
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->total_ns, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->buckets[nv_stats_bucket(ns)], 1,
+                              memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&hist->max_ns, memory_order_relaxed);
+    while (ns > max
+           && atomic_compare_exchange_weak_explicit(&hist->max_ns, &max, ns,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed)
+                  == false) {
+    }
+}
+
+void nv_stats_record(nv_stats_phase_t phase, uint64_t start)
+{
+    uint64_t ns = nv_stats_now() - start;
+
+    nv_stats_hist_add(&nv_stats_process.phase[phase], ns);
+    if (nv_stats_current) {
+        nv_stats_hist_add(&nv_stats_current->phase[phase], ns);
+    }
+}
+
+void nv_stats_count(nv_stats_counter_t counter, uint64_t value)
+{
+    atomic_fetch_add_explicit(&nv_stats_process.counters[counter], value,
+                              memory_order_relaxed);
+    if (nv_stats_current) {
+        atomic_fetch_add_explicit(&nv_stats_current->counters[counter], value,
+                                  memory_order_relaxed);
+    }
+}
+
+nv_stats_data_t* nv_stats_scope(nv_stats_data_t* stats)
+{
+    nv_stats_data_t* previous = nv_stats_current;
+    nv_stats_current = stats;
+
+    return previous;
+}
+
+nv_stats_data_t* nv_stats_global(void)
+{
+    return &nv_stats_process;
+}
+
+void nv_stats_snapshot(nv_stats_data_t* data, nv_stats_t* stats)
+{
+    memset(stats, 0, sizeof(nv_stats_t));
+
+    for (int i = 0; i < NV_STATS_PHASE_MAX; i++) {
+        nv_stats_hist_data_t* hist = &data->phase[i];
+
+        stats->phase[i].count = atomic_load(&hist->count);
+        stats->phase[i].total_ns = atomic_load(&hist->total_ns);
+        stats->phase[i].max_ns = atomic_load(&hist->max_ns);
+        for (int j = 0; j < NV_STATS_BUCKETS; j++) {
+            stats->phase[i].buckets[j] = atomic_load(&hist->buckets[j]);
+        }
+    }
+
+    stats->bytes_read = atomic_load(&data->counters[NV_STATS_BYTES_READ]);
+    stats->bytes_written = atomic_load(
+        &data->counters[NV_STATS_BYTES_WRITTEN]);
+    stats->cache_hits = atomic_load(&data->counters[NV_STATS_CACHE_HITS]);
+    stats->cache_misses = atomic_load(&data->counters[NV_STATS_CACHE_MISSES]);
+}
+
+void nv_stats_clear(nv_stats_data_t* data)
+{
+    for (int i = 0; i < NV_STATS_PHASE_MAX; i++) {
+        nv_stats_hist_data_t* hist = &data->phase[i];
+
+        atomic_store(&hist->count, 0);
+        atomic_store(&hist->total_ns, 0);
+        atomic_store(&hist->max_ns, 0);
+        for (int j = 0; j < NV_STATS_BUCKETS; j++) {
+            atomic_store(&hist->buckets[j], 0);
+        }
+    }
+
+    for (int i = 0; i < NV_STATS_COUNTER_MAX; i++) {
+        atomic_store(&data->counters[i], 0);
+    }
+}
+
+uint64_t nv_stats_percentile(const nv_stats_hist_t* hist, double ratio)
+{
+    uint64_t rank = (uint64_t)(hist->count * ratio);
+    uint64_t seen = 0;
+
+    for (int i = 0; i < NV_STATS_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen > rank) {
+            /* the open last bucket is bounded by the largest sample */
+            return i == 0                      ? 0
+                   : i == NV_STATS_BUCKETS - 1 ? hist->max_ns
+                                               : (1ULL << i) - 1;
+        }
+    }
+
+    return hist->max_ns;
+}
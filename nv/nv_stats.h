@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _NV_STATS_H_
+#define _NV_STATS_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "nv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_NV_STATS
+#define CONFIG_NV_STATS 0
+#endif
+
+typedef enum {
+    NV_STATS_BYTES_READ = 0,
+    NV_STATS_BYTES_WRITTEN,
+    NV_STATS_CACHE_HITS,
+    NV_STATS_CACHE_MISSES,
+    NV_STATS_COUNTER_MAX
+} nv_stats_counter_t;
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t total_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t buckets[NV_STATS_BUCKETS];
+} nv_stats_hist_data_t;
+
+/*
+ * Live counters of a store or the process, updated with relaxed atomics by
+ * any thread. Each event is recorded in the process totals and in the store
+ * entered on the calling thread, if any.
+ */
+typedef struct {
+    nv_stats_hist_data_t phase[NV_STATS_PHASE_MAX];
+    _Atomic uint64_t counters[NV_STATS_COUNTER_MAX];
+} nv_stats_data_t;
+
+/*
+ * Call sites use the lower case macros only, without CONFIG_NV_STATS they
+ * expand to nothing and leave no clock read or atomic behind.
+ */
+#if CONFIG_NV_STATS
+#define nv_stats_begin()             nv_stats_now()
+#define nv_stats_end(phase, start)   nv_stats_record(phase, start)
+#define nv_stats_add(counter, value) nv_stats_count(counter, value)
+#define nv_stats_enter(stats)        nv_stats_scope(stats)
+#define nv_stats_leave(previous)     nv_stats_scope(previous)
+#else
+#define nv_stats_begin()             ((uint64_t)0)
+#define nv_stats_end(phase, start)   ((void)(start))
+#define nv_stats_add(counter, value) ((void)0)
+#define nv_stats_enter(stats)        ((nv_stats_data_t*)NULL)
+#define nv_stats_leave(previous)     ((void)(previous))
+#endif
+
+/**
+ * nv_stats_now
+ * @return monotonic clock, ns
+ */
+uint64_t nv_stats_now(void);
+
+/**
+ * nv_stats_record, add one phase latency
+ * @param phase phase
+ * @param start nv_stats_now at phase start
+ */
+void nv_stats_record(nv_stats_phase_t phase, uint64_t start);
+
+/**
+ * nv_stats_count, add to a counter
+ * @param counter counter
+ * @param value   amount
+ */
+void nv_stats_count(nv_stats_counter_t counter, uint64_t value);
+
+/**
+ * nv_stats_scope, record the events of this thread into stats as well
+ * @param stats store counters, NULL for the process totals only
+ * @return      counters entered before, pass back to restore
+ */
+nv_stats_data_t* nv_stats_scope(nv_stats_data_t* stats);
+
+/**
+ * nv_stats_global
+ * @return process totals
+ */
+nv_stats_data_t* nv_stats_global(void);
+
+/**
+ * nv_stats_snapshot, copy live counters
+ * @param data  live counters
+ * @param stats snapshot
+ */
+void nv_stats_snapshot(nv_stats_data_t* data, nv_stats_t* stats);
+
+/**
+ * nv_stats_clear, zero live counters
+ * @param data live counters
+ */
+void nv_stats_clear(nv_stats_data_t* data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_STATS_H_ */
@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "nv_wal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nv.h"
+#include "nv_durable.h"
+#include "nv_stats.h"
+
+#define NV_WAL_OP_SET    "set"
+#define NV_WAL_OP_DELETE "delete"
+#define NV_WAL_OP_RANGE  "range"
+
+/**
+ * nv_wal_reserve
+ * @param buf  pending records
+ * @param size extra bytes needed
+ * @return     boolean
+ */
+static bool nv_wal_reserve(nv_wal_buf_t* buf, size_t size)
+{
+    if (buf->len + size <= buf->cap) {
+        return true;
+    }
+
+    size_t cap = buf->cap ? buf->cap : 256;
+    while (cap < buf->len + size) {
+        cap *= 2;
+    }
+
+    char* data = realloc(buf->data, cap);
+    if (data == NULL) {
+        return false;
+    }
+
+    buf->data = data;
+    buf->cap = cap;
+    return true;
+}
+
+/**
+ * nv_wal_queue, print a record as one line of the pending records
+ * @param buf    pending records
+ * @param record record, freed
+ * @param start  serialize phase start
+ * @return       boolean
+ */
+static bool nv_wal_queue(nv_wal_buf_t* buf, cJSON* record, uint64_t start)
+{
+    char* str = cJSON_PrintUnformatted(record);
+    cJSON_Delete(record);
+    nv_stats_end(NV_STATS_SERIALIZE, start);
+    if (str == NULL) {
+        return false;
+    }
+
+    size_t len = strlen(str);
+    bool ret = nv_wal_reserve(buf, len + 1);
+    if (ret) {
+        memcpy(buf->data + buf->len, str, len);
+        buf->data[buf->len + len] = '\n';
+        buf->len += len + 1;
+    }
+    cJSON_free(str);
+
+    return ret;
+}
+
+/**
+ * nv_wal_record, queue a set or delete record
+ * @param buf  pending records
+ * @param key  nv key
+ * @param item new value, NULL for delete
+ * @return     boolean
+ */
+bool nv_wal_record(nv_wal_buf_t* buf, const char* key, cJSON* item)
+{
+    uint64_t start = nv_stats_begin();
+    cJSON* record = cJSON_CreateObject();
+    if (record == NULL) {
+        return false;
+    }
+
+    cJSON_AddStringToObject(record, "op",
+                            item ? NV_WAL_OP_SET : NV_WAL_OP_DELETE);
+    cJSON_AddStringToObject(record, "key", key);
+    if (item) {
+        /* reference only, the value stays owned by the store tree */
+        cJSON_AddItemReferenceToObject(record, "value", item);
+    }
+
+    return nv_wal_queue(buf, record, start);
+}
+
+/**
+ * nv_wal_record_range, queue a record replacing array elements from offset
+ * @param buf    pending records
+ * @param key    nv key
+ * @param offset first replaced element
+ * @param first  first new element in the store tree
+ * @param count  number of elements
+ * @return       boolean
+ */
+bool nv_wal_record_range(nv_wal_buf_t* buf, const char* key, uint32_t offset,
+                         cJSON* first, uint32_t count)
+{
+    uint64_t start = nv_stats_begin();
+    cJSON* record = cJSON_CreateObject();
+    cJSON* value = cJSON_AddArrayToObject(record, "value");
+    if (record == NULL || value == NULL) {
+        cJSON_Delete(record);
+        return false;
+    }
+
+    cJSON_AddStringToObject(record, "op", NV_WAL_OP_RANGE);
+    cJSON_AddStringToObject(record, "key", key);
+    cJSON_AddNumberToObject(record, "offset", offset);
+
+    /* only the new elements are logged, as references into the store tree */
+    for (uint32_t i = 0; i < count && first; i++, first = first->next) {
+        cJSON_AddItemReferenceToArray(value, first);
+    }
+
+    return nv_wal_queue(buf, record, start);
+}
+
+/**
+ * nv_wal_append, append pending records to log file and clear them
+ * @param file   log file path
+ * @param buf    pending records
+ * @param config append durability
+ * @param size   log file size after append
+ * @return       boolean
+ */
+bool nv_wal_append(const char* file, nv_wal_buf_t* buf,
+                   const nv_config_t* config, size_t* size)
+{
+    uint64_t start = nv_stats_begin();
+    int fd = open(file, O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        nv_log("nv wal open %s fail, errno %d %s\n", file, errno,
+               strerror(errno));
+        return false;
+    }
+
+    /* terminate a torn tail first so it can not swallow the next record */
+    struct stat st = { 0 };
+    char last = '\n';
+    if (fstat(fd, &st) == 0 && st.st_size > 0
+        && pread(fd, &last, 1, st.st_size - 1) == 1 && last != '\n') {
+        nv_log("nv wal %s terminate torn tail\n", file);
+        if (write(fd, "\n", 1) != 1) {
+            close(fd);
+            return false;
+        }
+    }
+
+    size_t off = 0;
+    while (off < buf->len) {
+        ssize_t ret = write(fd, buf->data + off, buf->len - off);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            nv_log("nv wal write %s fail, errno %d %s\n", file, errno,
+                   strerror(errno));
+            close(fd);
+            return false;
+        }
+        off += ret;
+    }
+
+    nv_stats_end(NV_STATS_WRITE, start);
+    nv_stats_add(NV_STATS_BYTES_WRITTEN, buf->len);
+
+    if (nv_durable_fsync(file, fd, config) == false) {
+        close(fd);
+        return false;
+    }
+
+    bool created = st.st_size == 0;
+
+    if (size && fstat(fd, &st) == 0) {
+        *size = st.st_size;
+    }
+
+    close(fd);
+    buf->len = 0;
+
+    if (created) {
+        return nv_durable_fsync_dir(file, config);
+    }
+
+    return true;
+}
+
+/**
+ * nv_wal_apply_range, replace or append array elements from offset
+ * @param json   tree
+ * @param record parsed range record
+ * @param key    nv key
+ */
+static void nv_wal_apply_range(cJSON* json, cJSON* record, const char* key)
+{
+    cJSON* offset = cJSON_GetObjectItem(record, "offset");
+    cJSON* value = cJSON_GetObjectItem(record, "value");
+    if (cJSON_IsNumber(offset) == false || cJSON_IsArray(value) == false) {
+        nv_log("nv wal %s invalid range record\n", key);
+        return;
+    }
+
+    cJSON* array = cJSON_GetObjectItem(json, key);
+    if (array == NULL && offset->valueint == 0) {
+        cJSON_AddItemToObject(json, key,
+                              cJSON_DetachItemViaPointer(record, value));
+        return;
+    }
+
+    if (cJSON_IsArray(array) == false) {
+        nv_log("nv wal %s range record on non array\n", key);
+        return;
+    }
+
+    cJSON* element = array->child;
+    for (int i = 0; i < offset->valueint && element; i++) {
+        element = element->next;
+    }
+
+    while (value->child) {
+        cJSON* item = cJSON_DetachItemViaPointer(value, value->child);
+        if (element) {
+            cJSON* next = element->next;
+            cJSON_ReplaceItemViaPointer(array, element, item);
+            element = next;
+        } else {
+            cJSON_AddItemToArray(array, item);
+        }
+    }
+}
+
+/**
+ * nv_wal_apply, apply one record to the tree
+ * @param json   tree
+ * @param record parsed record
+ */
+static void nv_wal_apply(cJSON* json, cJSON* record)
+{
+    cJSON* op = cJSON_GetObjectItem(record, "op");
+    cJSON* key = cJSON_GetObjectItem(record, "key");
+    if (cJSON_IsString(op) == false || cJSON_IsString(key) == false) {
+        nv_log("nv wal invalid record\n");
+        return;
+    }
+
+    if (strcmp(op->valuestring, NV_WAL_OP_DELETE) == 0) {
+        cJSON_DeleteItemFromObject(json, key->valuestring);
+        return;
+    }
+
+    if (strcmp(op->valuestring, NV_WAL_OP_RANGE) == 0) {
+        nv_wal_apply_range(json, record, key->valuestring);
+        return;
+    }
+
+    cJSON* value = cJSON_DetachItemFromObject(record, "value");
+    if (value == NULL) {
+        nv_log("nv wal %s record without value\n", key->valuestring);
+        return;
+    }
+
+    if (cJSON_ReplaceItemInObject(json, key->valuestring, value) == false) {
+        cJSON_AddItemToObject(json, key->valuestring, value);
+    }
+}
+
+/**
+ * nv_wal_replay, apply log file records on top of the base tree
+ * @param file log file path
+ * @param json base tree
+ * @return     boolean, false if log file not exist
+ */
+bool nv_wal_replay(const char* file, cJSON* json)
+{
+    uint64_t start = nv_stats_begin();
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    char* data = malloc(st.st_size);
+    if (data == NULL) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = 0;
+    while (size < (size_t)st.st_size) {
+        ssize_t ret = read(fd, data + size, st.st_size - size);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        size += ret;
+    }
+    close(fd);
+
+    nv_stats_end(NV_STATS_READ, start);
+    nv_stats_add(NV_STATS_BYTES_READ, size);
+
+    start = nv_stats_begin();
+    char* line = data;
+    char* end = data + size;
+    while (line < end) {
+        char* eol = memchr(line, '\n', end - line);
+        if (eol == NULL) {
+            /* torn tail of an interrupted append, never acknowledged */
+            nv_log("nv wal %s drop %ld tail bytes\n", file, (long)(end - line));
+            break;
+        }
+
+        cJSON* record = cJSON_ParseWithLength(line, eol - line);
+        if (record) {
+            nv_wal_apply(json, record);
+            cJSON_Delete(record);
+        } else {
+            nv_log("nv wal %s parse fail %s\n", file, cJSON_GetErrorPtr());
+        }
+
+        line = eol + 1;
+    }
+
+    nv_stats_end(NV_STATS_PARSE, start);
+    free(data);
+    return true;
+}
+
+/**
+ * nv_wal_free, release pending records
+ * @param buf pending records
+ */
+void nv_wal_free(nv_wal_buf_t* buf)
+{
+    free(buf->data);
+    memset(buf, 0, sizeof(nv_wal_buf_t));
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _NV_WAL_H_
+#define _NV_WAL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cJSON.h"
+#include "nv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NV_WAL_SUFFIX ".wal"
+
+typedef struct {
+    char* data;     ///< pending records, one json object per line
+    size_t len;     ///< used bytes
+    size_t cap;     ///< allocated bytes
+} nv_wal_buf_t;
+
+/**
+ * nv_wal_record, queue a set or delete record
+ * @param buf  pending records
+ * @param key  nv key
+ * @param item new value, NULL for delete
+ * @return     boolean
+ */
+bool nv_wal_record(nv_wal_buf_t* buf, const char* key, cJSON* item);
+
+/**
+ * nv_wal_record_range, queue a record replacing array elements from offset
+ * @param buf    pending records
+ * @param key    nv key
+ * @param offset first replaced element
+ * @param first  first new element in the store tree
+ * @param count  number of elements
+ * @return       boolean
+ */
+bool nv_wal_record_range(nv_wal_buf_t* buf, const char* key, uint32_t offset,
+                         cJSON* first, uint32_t count);
+
+/**
+ * nv_wal_append, append pending records to log file and clear them
+ * @param file   log file path
+ * @param buf    pending records
+ * @param config append durability
+ * @param size   log file size after append
+ * @return       boolean
+ */
+bool nv_wal_append(const char* file, nv_wal_buf_t* buf,
+                   const nv_config_t* config, size_t* size);
+
+/**
+ * nv_wal_replay, apply log file records on top of the base tree
+ * @param file log file path
+ * @param json base tree
+ * @return     boolean, false if log file not exist
+ */
+bool nv_wal_replay(const char* file, cJSON* json);
+
+/**
+ * nv_wal_free, release pending records
+ * @param buf pending records
+ */
+void nv_wal_free(nv_wal_buf_t* buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NV_WAL_H_ */
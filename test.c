@@ -54,6 +54,15 @@ typedef struct {
     uint8_t height;
 } nv_t;
 
+/* clang-format off */
+#define NV_FIELDS(X)                              \
+    X(nv_t, name,   NV_KEY_NAME,   NV_DATA_STR)   \
+    X(nv_t, age,    NV_KEY_AGE,    NV_DATA_U8)    \
+    X(nv_t, height, NV_KEY_HEIGHT, NV_DATA_U8)
+/* clang-format on */
+
+NV_SCHEMA(nv_schema, NV_FIELDS);
+
 static nv_t nv = { 0 };
 
 __attribute__((unused)) static void cjson_create_item(void)
@@ -240,42 +249,11 @@ int main(void)
     // 释放内存
     cJSON_Delete(json);
 #endif
-    uint8_t nv_buffer[512] = { 0 };
-    nv_init(CONFIG_NV_PATH, nv_buffer);
-
 #if CONFIG_NV_DEBUG_MOCK_DATA
-    cJSON* json = NULL;
-
-    if (access(CONFIG_NV_PATH, F_OK) == 0) {
-        json = cJSON_Parse((const char*)nv_buffer);
-        if (!json) {
-            nv_log("cJSON Parse fail %s\n", cJSON_GetErrorPtr());
-        }
-    }
-
-    cJSON* tmp = cJSON_GetObjectItem(json, NV_KEY_NAME);
-    if (tmp && tmp->valuestring) {
-         memcpy(nv.name, tmp->valuestring, strlen(tmp->valuestring));
-    } else {
-        nv_log("%s not found\n", NV_KEY_NAME);
-    }
-
-    tmp = cJSON_GetObjectItem(json, NV_KEY_AGE);
-    if (tmp && tmp->valueint) {
-         nv.age = tmp->valueint;
-    } else {
-        nv_log("%s not found\n", NV_KEY_AGE);
+    if (nv_load_struct(CONFIG_NV_PATH, &nv_schema, &nv) == false) {
+        nv_log("nv %s not fully loaded\n", CONFIG_NV_PATH);
     }
 
-    tmp = cJSON_GetObjectItem(json, NV_KEY_HEIGHT);
-    if (tmp && tmp->valueint) {
-         nv.height = tmp->valueint;
-    } else {
-        nv_log("%s not found\n", NV_KEY_HEIGHT);
-    }
-
-    cJSON_Delete(json);
-
     uint8_t age = 30;
     uint16_t height = 175;
     uint32_t high = 140;
@@ -292,25 +270,36 @@ int main(void)
     float score_float[] = { 1.1, 1.2 };
     double score_double[] = { 2.1, 2.2 };
 
+    nv_txn_t* txn = nv_txn_begin(CONFIG_NV_PATH);
+    if (txn == NULL) {
+        nv_log("nv txn begin %s fail\n", CONFIG_NV_PATH);
+        return -1;
+    }
+
     /* clang-format off */
-    nv_sync(CONFIG_NV_PATH, NV_KEY_AGE,    (char *)&age,    sizeof(age),    NV_DATA_U8);
-    nv_sync(CONFIG_NV_PATH, NV_KEY_HEIGHT, (char *)&height, sizeof(height), NV_DATA_U16);
-    nv_sync(CONFIG_NV_PATH, NV_KEY_HIGH,   (char *)&high,   sizeof(high),   NV_DATA_U32);
-    nv_sync(CONFIG_NV_PATH, NV_KEY_ID,     (char *)&id,     sizeof(id),     NV_DATA_U64);
-    nv_sync(CONFIG_NV_PATH, NV_KEY_NAME,   (char *)name,    strlen(name),   NV_DATA_STR);
-
-    nv_sync(CONFIG_NV_PATH, NV_KEY_TEMP_FLOAT,  (char *)&temp_float,  sizeof(temp_float),  NV_DATA_FLOAT);
-    nv_sync(CONFIG_NV_PATH, NV_KEY_TEMP_DOUBLE, (char *)&temp_double, sizeof(temp_double), NV_DATA_DOUBLE);
-
-    nv_sync(CONFIG_NV_PATH, NV_KEY_SCORE_STR,    (char *)score_str,    ARRAY_SIZE(score_str),    NV_DATA_STRING_ARRAY);
-    nv_sync(CONFIG_NV_PATH, NV_KEY_SCORE_INT,    (char *)score_int,    ARRAY_SIZE(score_int),    NV_DATA_INT_ARRAY);
-    nv_sync(CONFIG_NV_PATH, NV_KEY_SCORE_FLOAT,  (char *)score_float,  ARRAY_SIZE(score_float),  NV_DATA_FLOAT_ARRAY);
-    nv_sync(CONFIG_NV_PATH, NV_KEY_SCORE_DOUBLE, (char *)score_double, ARRAY_SIZE(score_double), NV_DATA_DOUBLE_ARRAY);
-
-    nv_sync(CONFIG_NV_PATH, NV_KEY_IP,  (char *)ip,  ARRAY_SIZE(ip),  NV_DATA_IP);
-    nv_sync(CONFIG_NV_PATH, NV_KEY_MAC, (char *)mac, ARRAY_SIZE(mac), NV_DATA_MAC);
+    nv_txn_sync(txn, NV_KEY_AGE,    (char *)&age,    sizeof(age),    NV_DATA_U8);
+    nv_txn_sync(txn, NV_KEY_HEIGHT, (char *)&height, sizeof(height), NV_DATA_U16);
+    nv_txn_sync(txn, NV_KEY_HIGH,   (char *)&high,   sizeof(high),   NV_DATA_U32);
+    nv_txn_sync(txn, NV_KEY_ID,     (char *)&id,     sizeof(id),     NV_DATA_U64);
+    nv_txn_sync(txn, NV_KEY_NAME,   (char *)name,    strlen(name),   NV_DATA_STR);
+
+    nv_txn_sync(txn, NV_KEY_TEMP_FLOAT,  (char *)&temp_float,  sizeof(temp_float),  NV_DATA_FLOAT);
+    nv_txn_sync(txn, NV_KEY_TEMP_DOUBLE, (char *)&temp_double, sizeof(temp_double), NV_DATA_DOUBLE);
+
+    nv_txn_sync(txn, NV_KEY_SCORE_STR,    (char *)score_str,    ARRAY_SIZE(score_str),    NV_DATA_STRING_ARRAY);
+    nv_txn_sync(txn, NV_KEY_SCORE_INT,    (char *)score_int,    ARRAY_SIZE(score_int),    NV_DATA_INT_ARRAY);
+    nv_txn_sync(txn, NV_KEY_SCORE_FLOAT,  (char *)score_float,  ARRAY_SIZE(score_float),  NV_DATA_FLOAT_ARRAY);
+    nv_txn_sync(txn, NV_KEY_SCORE_DOUBLE, (char *)score_double, ARRAY_SIZE(score_double), NV_DATA_DOUBLE_ARRAY);
+
+    nv_txn_sync(txn, NV_KEY_IP,  (char *)ip,  ARRAY_SIZE(ip),  NV_DATA_IP);
+    nv_txn_sync(txn, NV_KEY_MAC, (char *)mac, ARRAY_SIZE(mac), NV_DATA_MAC);
     /* clang-format on */
 
+    if (nv_txn_commit(txn) == false) {
+        nv_log("nv txn commit %s fail\n", CONFIG_NV_PATH);
+        nv_txn_abort(txn);
+    }
+
 //    nv_delete(CONFIG_NV_PATH, NV_KEY_NAME);
 
     memset(score_str, 0, sizeof(score_str));
@@ -318,17 +307,44 @@ int main(void)
     memset(score_float, 0, sizeof(score_float));
     memset(score_double, 0, sizeof(score_double));
 
+    char* score_buf[16] = {0};
+    for (size_t i = 0; i < ARRAY_SIZE(score_buf); i++) {
+        score_buf[i] = calloc(1, ARRAY_SIZE(score_buf) * sizeof(char));
+    }
+
+    memset(ip,  0, sizeof(ip));
+    memset(mac, 0, sizeof(mac));
+
     /* clang-format off */
-    nv_get(CONFIG_NV_PATH, NV_KEY_AGE,    (char*)&age,    sizeof(age),    NV_DATA_U8);
-    nv_get(CONFIG_NV_PATH, NV_KEY_HEIGHT, (char*)&height, sizeof(height), NV_DATA_U16);
-    nv_get(CONFIG_NV_PATH, NV_KEY_HIGH,   (char*)&high,   sizeof(high),   NV_DATA_U32);
-    nv_get(CONFIG_NV_PATH, NV_KEY_ID,     (char*)&id,     sizeof(id),     NV_DATA_U64);
-    nv_get(CONFIG_NV_PATH, NV_KEY_NAME,   (char*)name,    strlen(name),   NV_DATA_STR);
-
-    nv_get(CONFIG_NV_PATH, NV_KEY_TEMP_FLOAT,  (char *)&temp_float,  sizeof(temp_float),  NV_DATA_FLOAT);
-    nv_get(CONFIG_NV_PATH, NV_KEY_TEMP_DOUBLE, (char *)&temp_double, sizeof(temp_double), NV_DATA_DOUBLE);
+    nv_entry_t entries[] = {
+        { NV_KEY_AGE,    NV_DATA_U8,  &age,    sizeof(age),    NV_STATUS_OK },
+        { NV_KEY_HEIGHT, NV_DATA_U16, &height, sizeof(height), NV_STATUS_OK },
+        { NV_KEY_HIGH,   NV_DATA_U32, &high,   sizeof(high),   NV_STATUS_OK },
+        { NV_KEY_ID,     NV_DATA_U64, &id,     sizeof(id),     NV_STATUS_OK },
+        { NV_KEY_NAME,   NV_DATA_STR, name,    sizeof(name),   NV_STATUS_OK },
+
+        { NV_KEY_TEMP_FLOAT,  NV_DATA_FLOAT,  &temp_float,  sizeof(temp_float),  NV_STATUS_OK },
+        { NV_KEY_TEMP_DOUBLE, NV_DATA_DOUBLE, &temp_double, sizeof(temp_double), NV_STATUS_OK },
+
+        { NV_KEY_SCORE_STR,    NV_DATA_STRING_ARRAY, score_buf,    ARRAY_SIZE(score_buf),    NV_STATUS_OK },
+        { NV_KEY_SCORE_INT,    NV_DATA_INT_ARRAY,    score_int,    ARRAY_SIZE(score_int),    NV_STATUS_OK },
+        { NV_KEY_SCORE_FLOAT,  NV_DATA_FLOAT_ARRAY,  score_float,  ARRAY_SIZE(score_float),  NV_STATUS_OK },
+        { NV_KEY_SCORE_DOUBLE, NV_DATA_DOUBLE_ARRAY, score_double, ARRAY_SIZE(score_double), NV_STATUS_OK },
+
+        { NV_KEY_IP,  NV_DATA_IP,  ip,  ARRAY_SIZE(ip),  NV_STATUS_OK },
+        { NV_KEY_MAC, NV_DATA_MAC, mac, ARRAY_SIZE(mac), NV_STATUS_OK },
+    };
     /* clang-format on */
 
+    /* one read and one parse of the file for every key */
+    if (nv_get_many(CONFIG_NV_PATH, entries, ARRAY_SIZE(entries)) == false) {
+        for (size_t i = 0; i < ARRAY_SIZE(entries); i++) {
+            if (entries[i].status != NV_STATUS_OK) {
+                nv_log("%s not found\n", entries[i].key);
+            }
+        }
+    }
+
     nv_log("age         = %d\n", age);
     nv_log("height      = %d\n", height);
     nv_log("high        = %" PRIu32 "\n", high);
@@ -337,18 +353,6 @@ int main(void)
     nv_log("temp_float  = %f\n", temp_float);
     nv_log("temp_double = %f\n", temp_double);
 
-    char* score_buf[16] = {0};
-    for (size_t i = 0; i < ARRAY_SIZE(score_buf); i++) {
-        score_buf[i] = calloc(1, ARRAY_SIZE(score_buf) * sizeof(char));
-    }
-
-    /* clang-format off */
-    nv_get(CONFIG_NV_PATH, NV_KEY_SCORE_STR,    (char*)score_buf,    ARRAY_SIZE(score_buf),    NV_DATA_STRING_ARRAY);
-    nv_get(CONFIG_NV_PATH, NV_KEY_SCORE_INT,    (char*)score_int,    ARRAY_SIZE(score_int),    NV_DATA_INT_ARRAY);
-    nv_get(CONFIG_NV_PATH, NV_KEY_SCORE_FLOAT,  (char*)score_float,  ARRAY_SIZE(score_float),  NV_DATA_FLOAT_ARRAY);
-    nv_get(CONFIG_NV_PATH, NV_KEY_SCORE_DOUBLE, (char*)score_double, ARRAY_SIZE(score_double), NV_DATA_DOUBLE_ARRAY);
-    /* clang-format on */
-
     nv_log("score buf    \"%s\" \"%s\"\n", score_buf[0], score_buf[1]);
     nv_log("score int    %d %d\n", score_int[0], score_int[1]);
     nv_log("score float  %f %f\n", score_float[0], score_float[1]);
@@ -360,14 +364,6 @@ int main(void)
         }
     }
 
-    memset(ip,  0, sizeof(ip));
-    memset(mac, 0, sizeof(mac));
-
-    /* clang-format off */
-    nv_get(CONFIG_NV_PATH, NV_KEY_IP,  (char*)ip,  ARRAY_SIZE(ip),  NV_DATA_IP);
-    nv_get(CONFIG_NV_PATH, NV_KEY_MAC, (char*)mac, ARRAY_SIZE(mac), NV_DATA_MAC);
-    /* clang-format on */
-
     nv_log("ip : %d.%d.%d.%d\n", ip[0], ip[1], ip[2], ip[3]);
     nv_log("mac: %d-%d-%d-%d-%d-%d\n", mac[0], mac[1], mac[2], mac[3], mac[4],
            mac[5]);
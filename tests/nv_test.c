@@ -0,0 +1,1592 @@
+/*
+ * Copyright (C) 2023 Junbo Zheng. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nv.h"
+#include "nv_arena.h"
+#include "nv_base64.h"
+#include "nv_blob.h"
+#include "nv_index.h"
+#include "nv_lz.h"
+#include "nv_scan.h"
+#include "nv_wal.h"
+
+#define NV_TEST_KEYS     64
+#define NV_TEST_KEY_SIZE 32
+#define NV_TEST_BUF_SIZE 65536
+#define NV_TEST_ITEMS    8
+#define NV_TEST_STR_SIZE 512
+
+#define NV_TEST_CHECK(cond)                                             \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: %s fail\n", __FILE__, __LINE__,     \
+                    #cond);                                             \
+            return false;                                               \
+        }                                                               \
+    } while (0)
+
+typedef bool (*nv_test_fn_t)(void);
+
+static uint32_t nv_test_seed = 1;
+
+/**
+ * nv_test_random, xorshift so every run checks the same inputs
+ */
+static uint32_t nv_test_random(void)
+{
+    nv_test_seed ^= nv_test_seed << 13;
+    nv_test_seed ^= nv_test_seed >> 17;
+    nv_test_seed ^= nv_test_seed << 5;
+    return nv_test_seed;
+}
+
+/**
+ * nv_test_fill, bytes of the given kind
+ * @param buf  output
+ * @param size output bytes
+ * @param kind 0 random, 1 json text, 2 one repeated byte
+ */
+static void nv_test_fill(char* buf, size_t size, int kind)
+{
+    size_t i = 0;
+
+    while (i < size) {
+        if (kind == 0) {
+            buf[i++] = (char)nv_test_random();
+        } else if (kind == 1) {
+            char member[64];
+            uint32_t key = nv_test_random() % 100;
+            uint32_t value = nv_test_random() % 7;
+            int len = snprintf(member, sizeof(member),
+                               "\t\"key%" PRIu32 "\":\t\"value%" PRIu32 "\",\n",
+                               key, value);
+            for (int j = 0; j < len && i < size; j++) {
+                buf[i++] = member[j];
+            }
+        } else {
+            buf[i++] = 'a';
+        }
+    }
+}
+
+static bool nv_test_lz_round_trip(void)
+{
+    static const size_t sizes[] = { 0,   1,    15,
+                                    16,  300,  4096,
+                                    NV_TEST_BUF_SIZE };
+    char* src = malloc(NV_TEST_BUF_SIZE);
+    NV_TEST_CHECK(src);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int kind = 0; kind < 3; kind++) {
+            for (int level = 1; level <= NV_LZ_LEVEL_MAX; level += 4) {
+                size_t len = 0;
+                size_t size = 0;
+
+                nv_test_fill(src, sizes[s], kind);
+
+                char* data = nv_lz_compress(src, sizes[s], level, &len);
+                NV_TEST_CHECK(data);
+                NV_TEST_CHECK(nv_lz_match(data, len));
+
+                char* out = nv_lz_decompress(data, len, &size);
+                NV_TEST_CHECK(out);
+                NV_TEST_CHECK(size == sizes[s]);
+                NV_TEST_CHECK(memcmp(out, src, size) == 0);
+
+                free(out);
+                free(data);
+            }
+        }
+    }
+
+    free(src);
+    return true;
+}
+
+static bool nv_test_lz_corrupt(void)
+{
+    char src[4096];
+    size_t len = 0;
+    size_t size = 0;
+
+    nv_test_fill(src, sizeof(src), 1);
+
+    char* data = nv_lz_compress(src, sizeof(src), NV_LZ_LEVEL_MAX, &len);
+    NV_TEST_CHECK(data);
+
+    /* every truncation is short of the original length */
+    for (size_t i = 0; i < len; i++) {
+        NV_TEST_CHECK(nv_lz_decompress(data, i, &size) == NULL);
+    }
+
+    /* flipped bytes are rejected or decode to the recorded length, the
+     * sanitizers catch any access outside the buffers */
+    for (size_t i = NV_LZ_HEADER_SIZE; i < len; i++) {
+        char saved = data[i];
+        data[i] ^= (char)(1 + nv_test_random() % 255);
+
+        char* out = nv_lz_decompress(data, len, &size);
+        if (out) {
+            NV_TEST_CHECK(size == sizeof(src));
+            free(out);
+        }
+
+        data[i] = saved;
+    }
+
+    data[0] ^= 1;
+    NV_TEST_CHECK(nv_lz_match(data, len) == false);
+    NV_TEST_CHECK(nv_lz_decompress(data, len, &size) == NULL);
+
+    free(data);
+    return true;
+}
+
+static bool nv_test_base64_round_trip(void)
+{
+    uint8_t src[256];
+    uint8_t out[256 + 1];
+    char text[512];
+
+    for (size_t len = 0; len <= sizeof(src); len++) {
+        size_t size = 0;
+
+        nv_test_fill((char*)src, len, 0);
+        nv_base64_encode(text, src, len);
+        NV_TEST_CHECK(strlen(text) == nv_base64_encoded_size(len));
+
+        /* the byte past the data stays untouched */
+        memset(out, 0x5A, sizeof(out));
+        NV_TEST_CHECK(
+            nv_base64_decode(out, len, text, strlen(text), &size));
+        NV_TEST_CHECK(size == len);
+        NV_TEST_CHECK(memcmp(out, src, len) == 0);
+        NV_TEST_CHECK(out[len] == 0x5A);
+
+        /* a short output keeps the prefix and reports the whole size */
+        if (len > 1) {
+            memset(out, 0x5A, sizeof(out));
+            NV_TEST_CHECK(
+                nv_base64_decode(out, len / 2, text, strlen(text), &size));
+            NV_TEST_CHECK(size == len);
+            NV_TEST_CHECK(memcmp(out, src, len / 2) == 0);
+            NV_TEST_CHECK(out[len / 2] == 0x5A);
+        }
+    }
+
+    return true;
+}
+
+static bool nv_test_base64_corrupt(void)
+{
+    static const char* const invalid[] = { "A", "AB", "ABC", "ABCDE",
+                                           "A===", "=AAA", "A=AA", "AA=A",
+                                           "AB=C", "AAAA====" };
+    uint8_t src[48];
+    uint8_t out[64];
+    char text[128];
+    size_t size = 0;
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        NV_TEST_CHECK(nv_base64_decode(out, sizeof(out), invalid[i],
+                                       strlen(invalid[i]), &size)
+                      == false);
+    }
+
+    /* an invalid character anywhere, the vector path included */
+    nv_test_fill((char*)src, sizeof(src), 0);
+    nv_base64_encode(text, src, sizeof(src));
+
+    size_t len = strlen(text);
+    for (size_t i = 0; i < len; i++) {
+        char saved = text[i];
+        text[i] = '*';
+        NV_TEST_CHECK(nv_base64_decode(out, sizeof(out), text, len, &size)
+                      == false);
+        text[i] = saved;
+    }
+
+    return true;
+}
+
+/**
+ * nv_test_dir_remove, drop a scratch dir and the files a store leaves in it
+ * @param dir scratch dir holding nv.json
+ */
+static void nv_test_dir_remove(const char* dir)
+{
+    static const char* const names[] = { "nv.json", "nv.json.wal",
+                                         "nv.json.lock" };
+    char file[PATH_MAX];
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        snprintf(file, sizeof(file), "%s/%s", dir, names[i]);
+        unlink(file);
+    }
+    rmdir(dir);
+}
+
+/**
+ * nv_test_wal_check, every key of the store holds its expected value
+ * @param file   nv file path
+ * @param config store config
+ * @param round  value generation of the keys
+ * @return       boolean
+ */
+static bool nv_test_wal_check(const char* file, const nv_config_t* config,
+                              uint32_t round)
+{
+    nv_store_t* store = nv_open_config(file, config);
+    NV_TEST_CHECK(store);
+
+    for (uint32_t i = 0; i < NV_TEST_KEYS; i++) {
+        char key[NV_TEST_KEY_SIZE];
+        uint32_t value = 0;
+
+        snprintf(key, sizeof(key), "key%" PRIu32, i);
+        NV_TEST_CHECK(nv_store_get(store, key, (char*)&value, sizeof(value),
+                                   NV_DATA_U32));
+        NV_TEST_CHECK(value == i * round);
+    }
+
+    NV_TEST_CHECK(nv_close(store));
+    return true;
+}
+
+static bool nv_test_wal_replay(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    char wal_file[PATH_MAX];
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+    snprintf(wal_file, sizeof(wal_file), "%s/nv.json%s", dir, NV_WAL_SUFFIX);
+
+    nv_config_t config;
+    nv_config_init(&config);
+    config.wal = true;
+    config.wal_compact_size = UINT32_MAX;
+
+    /* every round appends to the log, reopening replays it */
+    for (uint32_t round = 1; round <= 3; round++) {
+        nv_store_t* store = nv_open_config(file, &config);
+        NV_TEST_CHECK(store);
+
+        for (uint32_t i = 0; i < NV_TEST_KEYS; i++) {
+            char key[NV_TEST_KEY_SIZE];
+            uint32_t value = i * round;
+
+            snprintf(key, sizeof(key), "key%" PRIu32, i);
+            NV_TEST_CHECK(nv_store_sync(store, key, &value, sizeof(value),
+                                        NV_DATA_U32));
+        }
+
+        NV_TEST_CHECK(nv_close(store));
+        NV_TEST_CHECK(access(wal_file, F_OK) == 0);
+        NV_TEST_CHECK(nv_test_wal_check(file, &config, round));
+    }
+
+    /* compaction folds the log into the file and drops it */
+    nv_store_t* store = nv_open_config(file, &config);
+    NV_TEST_CHECK(store);
+    NV_TEST_CHECK(nv_store_compact(store));
+    NV_TEST_CHECK(nv_close(store));
+    NV_TEST_CHECK(access(wal_file, F_OK) != 0);
+    NV_TEST_CHECK(nv_test_wal_check(file, &config, 3));
+
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+/** value buffer big enough for any type of a test document */
+typedef struct {
+    union {
+        uint8_t bytes[NV_TEST_STR_SIZE];
+        double doubles[NV_TEST_ITEMS];
+    } data;
+    char strings[NV_TEST_ITEMS][NV_TEST_STR_SIZE];
+    char* pointers[NV_TEST_ITEMS];
+} nv_test_value_t;
+
+/**
+ * nv_test_value_reset, fill the buffer with a marker byte
+ * @param value value buffer
+ * @param mark  marker byte
+ * @param type  data type
+ * @return      buffer to pass for the type
+ */
+static char* nv_test_value_reset(nv_test_value_t* value, int mark,
+                                 nv_data_type_t type)
+{
+    memset(value, mark, sizeof(*value));
+    for (int i = 0; i < NV_TEST_ITEMS; i++) {
+        value->pointers[i] = value->strings[i];
+    }
+    return type == NV_DATA_STRING_ARRAY ? (char*)value->pointers
+                                        : (char*)value->data.bytes;
+}
+
+/**
+ * nv_test_value_same, two buffers hold the same bytes, pointers aside
+ */
+static bool nv_test_value_same(const nv_test_value_t* a,
+                               const nv_test_value_t* b)
+{
+    return memcmp(&a->data, &b->data, sizeof(a->data)) == 0
+           && memcmp(a->strings, b->strings, sizeof(a->strings)) == 0;
+}
+
+/**
+ * nv_test_file_write, replace a file with the given bytes
+ */
+static bool nv_test_file_write(const char* file, const char* data,
+                               size_t size)
+{
+    FILE* fp = fopen(file, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    bool ret = fwrite(data, 1, size, fp) == size;
+    return fclose(fp) == 0 && ret;
+}
+
+static bool nv_test_str_same(const char* a, const char* b)
+{
+    return (a == NULL && b == NULL) || (a && b && strcmp(a, b) == 0);
+}
+
+/**
+ * nv_test_tree_same, two trees hold the same items, numbers bit for bit
+ */
+static bool nv_test_tree_same(const cJSON* a, const cJSON* b)
+{
+    for (; a && b; a = a->next, b = b->next) {
+        if ((a->type & 0xFF) != (b->type & 0xFF)
+            || a->valueint != b->valueint
+            || memcmp(&a->valuedouble, &b->valuedouble, sizeof(double)) != 0
+            || nv_test_str_same(a->string, b->string) == false
+            || nv_test_str_same(a->valuestring, b->valuestring) == false
+            || nv_test_tree_same(a->child, b->child) == false) {
+            return false;
+        }
+    }
+
+    return a == NULL && b == NULL;
+}
+
+/**
+ * nv_test_scan_read, a value the scanner decodes is the one the store reads
+ * @param store store loaded from the text
+ * @param data  json text
+ * @param size  json text length
+ * @param key   nv key
+ * @param len   data buffer length
+ * @param type  data type
+ * @param ret   scan result
+ * @return      boolean
+ */
+static bool nv_test_scan_read(nv_store_t* store, const char* data,
+                              size_t size, const char* key, uint32_t len,
+                              nv_data_type_t type, nv_scan_result_t* ret)
+{
+    nv_test_value_t expect;
+    nv_test_value_t value;
+
+    char* out = nv_test_value_reset(&value, 0xA5, type);
+    *ret = nv_scan_get(data, size, key, out, len, type);
+    if (*ret == NV_SCAN_FALLBACK) {
+        return true;
+    }
+
+    out = nv_test_value_reset(&expect, 0xA5, type);
+    bool found = nv_store_get(store, key, out, len, type);
+    if (*ret == NV_SCAN_MISSING) {
+        NV_TEST_CHECK(found == false);
+    } else {
+        NV_TEST_CHECK(found);
+        NV_TEST_CHECK(nv_test_value_same(&value, &expect));
+    }
+
+    return true;
+}
+
+/**
+ * nv_test_scan_same, the scanner agrees with cJSON on one text: a tree it
+ * builds is the cJSON tree, a value it decodes is the one the store reads
+ * @param file scratch nv file path
+ * @param data json text
+ * @param size json text length
+ * @return     boolean
+ */
+static bool nv_test_scan_same(const char* file, const char* data, size_t size)
+{
+    static const nv_data_type_t types[] = {
+        NV_DATA_U8,           NV_DATA_S32,        NV_DATA_U64,
+        NV_DATA_S64,          NV_DATA_DOUBLE,     NV_DATA_STR,
+        NV_DATA_STRING_ARRAY, NV_DATA_INT_ARRAY,  NV_DATA_DOUBLE_ARRAY,
+    };
+    const char* keys[NV_TEST_ITEMS * 2] = { "missing" };
+    int count = 1;
+
+    cJSON* tree = cJSON_ParseWithLength(data, size);
+    cJSON* scan = nv_scan_parse(data, size);
+    if (scan) {
+        NV_TEST_CHECK(tree);
+        NV_TEST_CHECK(nv_test_tree_same(scan, tree));
+        cJSON_Delete(scan);
+    }
+
+    for (cJSON* item = cJSON_IsObject(tree) ? tree->child : NULL;
+         item && count < NV_TEST_ITEMS * 2; item = item->next) {
+        keys[count++] = item->string;
+    }
+
+    NV_TEST_CHECK(nv_test_file_write(file, data, size));
+    nv_store_t* store = nv_open(file);
+    NV_TEST_CHECK(store);
+
+    for (int k = 0; k < count; k++) {
+        for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+            uint32_t len = types[t] == NV_DATA_STR    ? NV_TEST_STR_SIZE
+                           : types[t] == NV_DATA_U64  ? sizeof(uint64_t)
+                           : types[t] == NV_DATA_S64  ? sizeof(int64_t)
+                           : types[t] < NV_DATA_STR   ? sizeof(double)
+                                                      : NV_TEST_ITEMS;
+            nv_scan_result_t ret;
+
+            NV_TEST_CHECK(nv_test_scan_read(store, data, size, keys[k], len,
+                                            types[t], &ret));
+        }
+    }
+
+    NV_TEST_CHECK(nv_close(store));
+    cJSON_Delete(tree);
+    return true;
+}
+
+static bool nv_test_scan_differential(void)
+{
+    static const char* const docs[] = {
+        /* well formed, the scanner builds these itself */
+        "{}",
+        " \t\r\n{ \"a\" : 1 , \"b\" : [ 1, 2, { \"c\" : null } ] ,"
+        " \"d\" : true, \"e\" : false }",
+        "{\"esc\":\"\\\"\\\\\\/\\b\\f\\n\\r\\t\",\"uni\":\"\\u00e9\\u4E2D\"}",
+        "{\"pair\":\"\\ud83d\\ude00\",\"bmp\":\"\\uffff\\u0080\"}",
+        "{\"exp\":[1e5,1E-5,-2.5e+3,0.1,-0,0e0,1e308,4.9e-324,2.2e-308],"
+        "\"big\":1e309}",
+        "{\"digits\":[123456789012345,1234567890123456,12345678901234567,"
+        "0.1234567890123456789,-98765432109876543210]}",
+        "{\"u64\":9007199254740993,\"s64\":-9007199254740993,"
+        "\"max\":18446744073709551615,\"min\":-9223372036854775808,"
+        "\"over\":18446744073709551616,\"frac\":9007199254740993.5}",
+        "{\"Dup\":1,\"dup\":2,\"\\u0064up\":3,\"DUP\":\"x\"}",
+        "{\"names\":[\"a\",\"\",\"\\u00e9\",\"\\n\"],\"nest\":[[[{\"a\":[]}]]],"
+        "\"empty\":\"\"}",
+        "{\"\\u0061b\":1,\"a\\\"b\":2,\"ab\":3}",
+        /* the scanner may leave these to cJSON */
+        "{\"lone\":\"\\ud83d\",\"low\":\"\\ude00x\","
+        "\"bad\":\"\\ud83d\\u0041\"}",
+        "{\"nul\":\"a\\u0000b\",\"names\":[\"c\\u0000d\"]}",
+        "\xEF\xBB\xBF{\"bom\":1}",
+        "{\"a\":1} trailing",
+        "[1,2]",
+        "\"text\"",
+        "{\"a\":01}",
+        "{\"a\":1.}",
+        "{\"a\":.5}",
+        "{\"a\":+1}",
+        "{\"a\":-}",
+        "{\"a\":1e}",
+        "{\"a\":\"\\x\"}",
+        "{\"a\":\"\\u12\"}",
+        "{\"a\":tru}",
+        "{\"a\":1,}",
+        "{,}",
+        "{\"a\" 1}",
+        "{\"a\":\"ctl\x01\"}",
+        "{\"a\":[1,2}",
+    };
+    static const char mutations[] = "{}[]\",:\\0123456789eE+-.tfnu \x01\x80";
+    const size_t well_formed = 10;
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    char buf[NV_TEST_STR_SIZE];
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+
+    for (size_t d = 0; d < sizeof(docs) / sizeof(docs[0]); d++) {
+        size_t size = strlen(docs[d]);
+
+        if (d < well_formed) {
+            cJSON* scan = nv_scan_parse(docs[d], size);
+            NV_TEST_CHECK(scan);
+            cJSON_Delete(scan);
+        }
+
+        /* every truncation */
+        for (size_t i = 0; i <= size; i++) {
+            NV_TEST_CHECK(nv_test_scan_same(file, docs[d], i));
+        }
+
+        /* single byte mutations at every offset */
+        for (size_t i = 0; i < size; i++) {
+            memcpy(buf, docs[d], size);
+            buf[i] = mutations[nv_test_random() % (sizeof(mutations) - 1)];
+            NV_TEST_CHECK(nv_test_scan_same(file, buf, size));
+        }
+    }
+
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+/**
+ * nv_test_file_read, whole file into a buffer
+ * @param file nv file path
+ * @param data output buffer
+ * @param size buffer length
+ * @return     bytes read, 0 on failure
+ */
+static size_t nv_test_file_read(const char* file, char* data, size_t size)
+{
+    FILE* fp = fopen(file, "rb");
+    if (fp == NULL) {
+        return 0;
+    }
+
+    size_t len = fread(data, 1, size, fp);
+    fclose(fp);
+    return len < size ? len : 0;
+}
+
+static bool nv_test_scan_types(void)
+{
+    static const nv_data_type_t types[] = {
+        NV_DATA_U8,
+        NV_DATA_S8,
+        NV_DATA_U16,
+        NV_DATA_S16,
+        NV_DATA_U32,
+        NV_DATA_S32,
+        NV_DATA_U64,
+        NV_DATA_S64,
+        NV_DATA_FLOAT,
+        NV_DATA_DOUBLE,
+        NV_DATA_STR,
+        NV_DATA_STRING_ARRAY,
+        NV_DATA_INT_ARRAY,
+        NV_DATA_FLOAT_ARRAY,
+        NV_DATA_DOUBLE_ARRAY,
+        NV_DATA_IP,
+        NV_DATA_MAC,
+        NV_DATA_PACKED_INT_ARRAY,
+        NV_DATA_PACKED_FLOAT_ARRAY,
+        NV_DATA_PACKED_DOUBLE_ARRAY,
+    };
+    uint8_t u8 = 200;
+    int8_t s8 = -100;
+    uint16_t u16 = 65535;
+    int16_t s16 = -32768;
+    uint32_t u32 = 4000000000u;
+    int32_t s32 = INT32_MIN;
+    uint64_t u64 = UINT64_MAX - 1;
+    int64_t s64 = INT64_MIN + 1;
+    float f = -1.5f;
+    double d = 1e-300;
+    char str[] = "abcd";
+    char* strs[] = { "a", "", "bcd\t\"", "\xc3\xa9" };
+    int32_t ints[] = { 1, -2, INT32_MAX, INT32_MIN, 0 };
+    float floats[] = { 0.1f, -2.5f, 1e30f };
+    double doubles[] = { 0.1, -0.0, 1e308, 4.9e-324, 3.0, 7.5, 9.25 };
+    uint32_t ip[] = { 192, 168, 0, 1 };
+    uint32_t mac[] = { 1, 2, 0x3a, 4, 5, 255 };
+    nv_entry_t entries[] = {
+        { "u8", NV_DATA_U8, &u8, sizeof(u8), NV_STATUS_OK },
+        { "s8", NV_DATA_S8, &s8, sizeof(s8), NV_STATUS_OK },
+        { "u16", NV_DATA_U16, &u16, sizeof(u16), NV_STATUS_OK },
+        { "s16", NV_DATA_S16, &s16, sizeof(s16), NV_STATUS_OK },
+        { "u32", NV_DATA_U32, &u32, sizeof(u32), NV_STATUS_OK },
+        { "s32", NV_DATA_S32, &s32, sizeof(s32), NV_STATUS_OK },
+        { "u64", NV_DATA_U64, &u64, sizeof(u64), NV_STATUS_OK },
+        { "s64", NV_DATA_S64, &s64, sizeof(s64), NV_STATUS_OK },
+        { "float", NV_DATA_FLOAT, &f, sizeof(f), NV_STATUS_OK },
+        { "double", NV_DATA_DOUBLE, &d, sizeof(d), NV_STATUS_OK },
+        { "str", NV_DATA_STR, str, sizeof(str) - 1, NV_STATUS_OK },
+        { "strs", NV_DATA_STRING_ARRAY, strs, 4, NV_STATUS_OK },
+        { "ints", NV_DATA_INT_ARRAY, ints, 5, NV_STATUS_OK },
+        { "floats", NV_DATA_FLOAT_ARRAY, floats, 3, NV_STATUS_OK },
+        { "doubles", NV_DATA_DOUBLE_ARRAY, doubles, 7, NV_STATUS_OK },
+        { "ip", NV_DATA_IP, ip, 4, NV_STATUS_OK },
+        { "mac", NV_DATA_MAC, mac, 6, NV_STATUS_OK },
+        { "packed_ints", NV_DATA_PACKED_INT_ARRAY, ints, 5, NV_STATUS_OK },
+        { "packed_floats", NV_DATA_PACKED_FLOAT_ARRAY, floats, 3,
+          NV_STATUS_OK },
+        { "packed_doubles", NV_DATA_PACKED_DOUBLE_ARRAY, doubles, 7,
+          NV_STATUS_OK },
+    };
+    const size_t count = sizeof(entries) / sizeof(entries[0]);
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    nv_config_t config;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+
+    nv_config_init(&config);
+    config.format = NV_FORMAT_JSON;
+    config.wal = false;
+    config.compress = 0;
+
+    nv_store_t* store = nv_open_config(file, &config);
+    NV_TEST_CHECK(store);
+    NV_TEST_CHECK(nv_store_sync_many(store, entries, count));
+    NV_TEST_CHECK(nv_close(store));
+
+    char* data = malloc(NV_TEST_BUF_SIZE);
+    NV_TEST_CHECK(data);
+    size_t size = nv_test_file_read(file, data, NV_TEST_BUF_SIZE);
+    NV_TEST_CHECK(size);
+
+    store = nv_open_config(file, &config);
+    NV_TEST_CHECK(store);
+
+    /* every key read as every type, with buffers too short, exact and
+     * larger, the key's own type is decoded by the scanner itself */
+    for (size_t k = 0; k <= count; k++) {
+        const char* key = k < count ? entries[k].key : "missing";
+
+        for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+            for (uint32_t len = 0; len <= NV_TEST_ITEMS + 1; len++) {
+                uint32_t size_len = len > NV_TEST_ITEMS ? NV_TEST_STR_SIZE
+                                    : types[t] == NV_DATA_STR ? len
+                                    : len > 0 && types[t] < NV_DATA_STR
+                                        ? sizeof(double)
+                                        : len;
+                nv_scan_result_t ret;
+
+                if (len > NV_TEST_ITEMS && types[t] != NV_DATA_STR) {
+                    continue;
+                }
+
+                NV_TEST_CHECK(nv_test_scan_read(store, data, size, key,
+                                                size_len, types[t], &ret));
+                if (k == count) {
+                    NV_TEST_CHECK(ret == NV_SCAN_MISSING);
+                } else if (types[t] == entries[k].type
+                           && len >= (types[t] == NV_DATA_STR
+                                          ? NV_TEST_ITEMS + 1
+                                          : NV_TEST_ITEMS)) {
+                    NV_TEST_CHECK(ret == NV_SCAN_FOUND);
+                }
+            }
+        }
+    }
+
+    NV_TEST_CHECK(nv_close(store));
+    free(data);
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+static bool nv_test_scan_fallback(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    char wal_file[PATH_MAX];
+    char data[NV_TEST_STR_SIZE];
+    uint32_t value = 0;
+    nv_config_t config;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+    snprintf(wal_file, sizeof(wal_file), "%s/nv.json%s", dir, NV_WAL_SUFFIX);
+
+    /* escaped member names only match after decoding */
+    static const char escaped[] = "{\"\\u0061b\":1,\"c\\\"d\":2}";
+    NV_TEST_CHECK(nv_test_file_write(file, escaped, sizeof(escaped) - 1));
+    NV_TEST_CHECK(nv_scan_get(escaped, sizeof(escaped) - 1, "ab",
+                              (char*)&value, sizeof(value), NV_DATA_U32)
+                  == NV_SCAN_FALLBACK);
+    NV_TEST_CHECK(nv_get(file, "ab", (char*)&value, sizeof(value),
+                         NV_DATA_U32));
+    NV_TEST_CHECK(value == 1);
+    NV_TEST_CHECK(nv_get(file, "c\"d", (char*)&value, sizeof(value),
+                         NV_DATA_U32));
+    NV_TEST_CHECK(value == 2);
+    unlink(file);
+
+    /* a log newer than the file text wins */
+    nv_config_init(&config);
+    config.format = NV_FORMAT_JSON;
+    config.wal = true;
+    config.wal_compact_size = UINT32_MAX;
+
+    nv_store_t* store = nv_open_config(file, &config);
+    NV_TEST_CHECK(store);
+    value = 1;
+    NV_TEST_CHECK(nv_store_sync(store, "a", &value, sizeof(value),
+                                NV_DATA_U32));
+    NV_TEST_CHECK(nv_store_compact(store));
+    value = 2;
+    NV_TEST_CHECK(nv_store_sync(store, "a", &value, sizeof(value),
+                                NV_DATA_U32));
+    NV_TEST_CHECK(nv_close(store));
+    NV_TEST_CHECK(access(wal_file, F_OK) == 0);
+
+    size_t size = nv_test_file_read(file, data, sizeof(data));
+    NV_TEST_CHECK(size);
+    NV_TEST_CHECK(nv_scan_get(data, size, "a", (char*)&value, sizeof(value),
+                              NV_DATA_U32)
+                  == NV_SCAN_FOUND);
+    NV_TEST_CHECK(value == 1);
+    NV_TEST_CHECK(nv_get(file, "a", (char*)&value, sizeof(value),
+                         NV_DATA_U32));
+    NV_TEST_CHECK(value == 2);
+    unlink(wal_file);
+    unlink(file);
+
+    /* binary files are never scanned as text */
+    uint64_t u64 = UINT64_MAX - 1;
+    uint64_t out = 0;
+    config.format = NV_FORMAT_BINARY;
+    config.wal = false;
+
+    store = nv_open_config(file, &config);
+    NV_TEST_CHECK(store);
+    NV_TEST_CHECK(nv_store_sync(store, "a", &u64, sizeof(u64), NV_DATA_U64));
+    NV_TEST_CHECK(nv_close(store));
+
+    size = nv_test_file_read(file, data, sizeof(data));
+    NV_TEST_CHECK(size);
+    NV_TEST_CHECK(nv_scan_get(data, size, "a", (char*)&out, sizeof(out),
+                              NV_DATA_U64)
+                  == NV_SCAN_FALLBACK);
+    NV_TEST_CHECK(nv_get(file, "a", (char*)&out, sizeof(out), NV_DATA_U64));
+    NV_TEST_CHECK(out == u64);
+
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+static bool nv_test_flusher_merge(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    char key[NV_TEST_KEY_SIZE];
+    uint32_t value = 0;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+
+    /* another writer between the async update and its write keeps its key */
+    value = 1;
+    snprintf(key, sizeof(key), "async1");
+    NV_TEST_CHECK(nv_sync_async(file, key, &value, sizeof(value),
+                                NV_DATA_U32));
+
+    nv_store_t* store = nv_open(file);
+    NV_TEST_CHECK(store);
+    value = 2;
+    NV_TEST_CHECK(nv_store_sync(store, "other", &value, sizeof(value),
+                                NV_DATA_U32));
+    NV_TEST_CHECK(nv_close(store));
+
+    value = 3;
+    snprintf(key, sizeof(key), "async2");
+    NV_TEST_CHECK(nv_sync_async(file, key, &value, sizeof(value),
+                                NV_DATA_U32));
+
+    snprintf(key, sizeof(key), "other");
+    NV_TEST_CHECK(nv_get(file, key, (char*)&value, sizeof(value),
+                         NV_DATA_U32));
+    NV_TEST_CHECK(value == 2);
+    NV_TEST_CHECK(nv_flush_wait());
+
+    store = nv_open(file);
+    NV_TEST_CHECK(store);
+    NV_TEST_CHECK(nv_store_get(store, "async1", (char*)&value, sizeof(value),
+                               NV_DATA_U32));
+    NV_TEST_CHECK(value == 1);
+    NV_TEST_CHECK(nv_store_get(store, "other", (char*)&value, sizeof(value),
+                               NV_DATA_U32));
+    NV_TEST_CHECK(value == 2);
+    NV_TEST_CHECK(nv_store_get(store, "async2", (char*)&value, sizeof(value),
+                               NV_DATA_U32));
+    NV_TEST_CHECK(value == 3);
+    NV_TEST_CHECK(nv_close(store));
+
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+static bool nv_test_snapshot_pin(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    uint32_t value = 0;
+    nv_config_t config;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+
+    /* a store not opened thread safe still serves its snapshots from the
+     * versions its later writes leave behind */
+    nv_config_init(&config);
+    config.thread_safe = false;
+    config.shared = false;
+
+    nv_store_t* store = nv_open_config(file, &config);
+    NV_TEST_CHECK(store);
+
+    for (uint32_t i = 0; i < NV_TEST_KEYS; i++) {
+        char key[NV_TEST_KEY_SIZE];
+
+        snprintf(key, sizeof(key), "key%" PRIu32, i);
+        NV_TEST_CHECK(nv_store_sync(store, key, &i, sizeof(i), NV_DATA_U32));
+    }
+
+    nv_snapshot_t* first = nv_snapshot(store);
+    NV_TEST_CHECK(first);
+
+    value = 100;
+    NV_TEST_CHECK(nv_store_sync(store, "key1", &value, sizeof(value),
+                                NV_DATA_U32));
+    NV_TEST_CHECK(nv_store_delete(store, "key2"));
+
+    nv_snapshot_t* second = nv_snapshot(store);
+    NV_TEST_CHECK(second);
+
+    value = 200;
+    NV_TEST_CHECK(nv_store_sync(store, "key1", &value, sizeof(value),
+                                NV_DATA_U32));
+
+    NV_TEST_CHECK(nv_snapshot_get(first, "key1", (char*)&value,
+                                  sizeof(value), NV_DATA_U32));
+    NV_TEST_CHECK(value == 1);
+    NV_TEST_CHECK(nv_snapshot_get(first, "key2", (char*)&value,
+                                  sizeof(value), NV_DATA_U32));
+    NV_TEST_CHECK(value == 2);
+    NV_TEST_CHECK(nv_snapshot_get(second, "key1", (char*)&value,
+                                  sizeof(value), NV_DATA_U32));
+    NV_TEST_CHECK(value == 100);
+    NV_TEST_CHECK(nv_snapshot_get(second, "key2", (char*)&value,
+                                  sizeof(value), NV_DATA_U32)
+                  == false);
+    NV_TEST_CHECK(nv_store_get(store, "key1", (char*)&value, sizeof(value),
+                               NV_DATA_U32));
+    NV_TEST_CHECK(value == 200);
+
+    nv_snapshot_release(first);
+    NV_TEST_CHECK(nv_snapshot_get(second, "key3", (char*)&value,
+                                  sizeof(value), NV_DATA_U32));
+    NV_TEST_CHECK(value == 3);
+    nv_snapshot_release(second);
+
+    NV_TEST_CHECK(nv_close(store));
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+static bool nv_test_registry_flush(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[NV_TEST_ITEMS][PATH_MAX];
+    char key[NV_TEST_KEY_SIZE] = "key";
+    uint32_t value = 0;
+    nv_config_t config;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+
+    nv_config_init(&config);
+    config.wal = false;
+    config.shared = false;
+
+    nv_registry_t* registry = nv_registry_create(&config, SIZE_MAX);
+    NV_TEST_CHECK(registry);
+
+    /* dirty stores, open or not, are written by one flush */
+    for (uint32_t i = 0; i < NV_TEST_ITEMS; i++) {
+        snprintf(file[i], sizeof(file[i]), "%s/nv%" PRIu32 ".json", dir, i);
+        nv_store_t* store = nv_registry_open(registry, file[i]);
+        NV_TEST_CHECK(store);
+        NV_TEST_CHECK(nv_store_sync(store, key, &i, sizeof(i), NV_DATA_U32));
+        if (i % 2) {
+            nv_registry_close(registry, store);
+        }
+    }
+
+    NV_TEST_CHECK(nv_registry_flush(registry));
+
+    for (uint32_t i = 0; i < NV_TEST_ITEMS; i++) {
+        NV_TEST_CHECK(nv_get(file[i], key, (char*)&value, sizeof(value),
+                             NV_DATA_U32));
+        NV_TEST_CHECK(value == i);
+
+        if (i % 2 == 0) {
+            nv_store_t* store = nv_registry_open(registry, file[i]);
+            NV_TEST_CHECK(store);
+            nv_registry_close(registry, store);
+            nv_registry_close(registry, store);
+        }
+    }
+
+    NV_TEST_CHECK(nv_registry_destroy(registry));
+
+    for (uint32_t i = 0; i < NV_TEST_ITEMS; i++) {
+        unlink(file[i]);
+    }
+    rmdir(dir);
+    return true;
+}
+
+/** patches a watch callback received */
+typedef struct {
+    int count;
+    char patch[NV_TEST_STR_SIZE];
+} nv_test_watch_t;
+
+static void nv_test_watch_cb(nv_store_t* store, const char* patch, void* arg)
+{
+    nv_test_watch_t* watch = arg;
+
+    (void)store;
+    watch->count++;
+    snprintf(watch->patch, sizeof(watch->patch), "%s", patch);
+}
+
+static bool nv_test_watch_reload(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    nv_test_watch_t watch = { 0 };
+    uint32_t value = 1;
+    nv_config_t config;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+
+    nv_config_init(&config);
+    config.wal = false;
+    config.shared = false;
+
+    nv_store_t* store = nv_open_config(file, &config);
+    NV_TEST_CHECK(store);
+    NV_TEST_CHECK(nv_watch(store, "key", nv_test_watch_cb, &watch));
+
+    /* the store's own write is no change of the file for the watch */
+    NV_TEST_CHECK(nv_store_sync(store, "key", &value, sizeof(value),
+                                NV_DATA_U32));
+    NV_TEST_CHECK(nv_store_flush(store));
+    NV_TEST_CHECK(watch.count == 1);
+    NV_TEST_CHECK(nv_watch_dispatch(store));
+    NV_TEST_CHECK(watch.count == 1);
+
+    /* a second handle rewrites the file */
+    nv_store_t* other = nv_open_config(file, &config);
+    NV_TEST_CHECK(other);
+    value = 2;
+    NV_TEST_CHECK(nv_store_sync(other, "key", &value, sizeof(value),
+                                NV_DATA_U32));
+    NV_TEST_CHECK(nv_close(other));
+
+    NV_TEST_CHECK(nv_watch_dispatch(store));
+    NV_TEST_CHECK(watch.count == 2);
+    NV_TEST_CHECK(strstr(watch.patch, "\"/key\""));
+    NV_TEST_CHECK(strstr(watch.patch, "\"replace\""));
+    NV_TEST_CHECK(nv_store_get(store, "key", (char*)&value, sizeof(value),
+                               NV_DATA_U32));
+    NV_TEST_CHECK(value == 2);
+
+    NV_TEST_CHECK(nv_close(store));
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+static bool nv_test_arena_nested(void)
+{
+    nv_arena_t arena = { 0 };
+
+    /* memory of an outer arena is freed by cJSON inside an inner scope */
+    nv_arena_t* previous = nv_arena_enter(&arena);
+    cJSON* outer = cJSON_CreateString("outer");
+    NV_TEST_CHECK(outer);
+
+    nv_arena_t* thread = nv_arena_enter(NULL);
+    cJSON* inner = cJSON_CreateString("inner");
+    NV_TEST_CHECK(inner);
+    cJSON_Delete(outer);
+
+    /* a nested scope of the thread arena keeps the memory of the outer one */
+    nv_arena_t* nested = nv_arena_enter(NULL);
+    cJSON* item = cJSON_CreateString("nested");
+    NV_TEST_CHECK(item);
+    nv_arena_leave(nested);
+
+    for (int i = 0; i < NV_TEST_KEYS; i++) {
+        NV_TEST_CHECK(cJSON_CreateString("reuse"));
+    }
+    NV_TEST_CHECK(strcmp(inner->valuestring, "inner") == 0);
+    NV_TEST_CHECK(strcmp(item->valuestring, "nested") == 0);
+    cJSON_Delete(item);
+    cJSON_Delete(inner);
+
+    nv_arena_leave(thread);
+    nv_arena_leave(previous);
+    nv_arena_free(&arena);
+
+    /* heap memory is still freed while an arena is entered */
+    cJSON* heap = cJSON_CreateString("heap");
+    NV_TEST_CHECK(heap);
+    previous = nv_arena_enter(NULL);
+    cJSON_Delete(heap);
+    nv_arena_leave(previous);
+    return true;
+}
+
+/**
+ * nv_test_index_same, the index finds every key as cJSON does
+ */
+static bool nv_test_index_same(const nv_index_t* index, const cJSON* json)
+{
+    char key[NV_TEST_KEY_SIZE];
+
+    for (int i = 0; i < NV_TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "Key%d", i % (NV_TEST_KEYS / 2));
+        if (nv_index_find(index, key) != cJSON_GetObjectItem(json, key)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool nv_test_index_clone(void)
+{
+    char key[NV_TEST_KEY_SIZE];
+    nv_index_t index = { 0 };
+    nv_index_t clone = { 0 };
+
+    /* every key twice in different case, the first member wins */
+    cJSON* json = cJSON_CreateObject();
+    NV_TEST_CHECK(json);
+    for (int i = 0; i < NV_TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), i < NV_TEST_KEYS / 2 ? "key%d" : "KEY%d",
+                 i % (NV_TEST_KEYS / 2));
+        cJSON_AddNumberToObject(json, key, i);
+    }
+    NV_TEST_CHECK(nv_index_build(&index, json));
+
+    /* a copy is indexed by position, then changes on its own */
+    cJSON* copy = cJSON_Duplicate(json, true);
+    NV_TEST_CHECK(copy);
+    NV_TEST_CHECK(nv_index_clone(&clone, &index, copy));
+    NV_TEST_CHECK(nv_test_index_same(&clone, copy));
+
+    for (int i = 0; i < NV_TEST_KEYS; i += 3) {
+        cJSON* item = nv_test_random() % 2 ? copy->child : copy->child->next;
+        cJSON_DetachItemViaPointer(copy, item);
+        nv_index_remove(&clone, item);
+        cJSON_Delete(item);
+        NV_TEST_CHECK(nv_test_index_same(&clone, copy));
+
+        snprintf(key, sizeof(key), "key%d", i);
+        cJSON* added = cJSON_CreateNumber(i);
+        NV_TEST_CHECK(added);
+        cJSON_AddItemToObject(copy, key, added);
+        NV_TEST_CHECK(nv_index_insert(&clone, added));
+        NV_TEST_CHECK(nv_test_index_same(&clone, copy));
+    }
+    NV_TEST_CHECK(nv_test_index_same(&index, json));
+
+    /* a copy that lost a member is indexed from scratch */
+    cJSON_Delete(copy);
+    copy = cJSON_Duplicate(json, true);
+    NV_TEST_CHECK(copy);
+    cJSON_Delete(cJSON_DetachItemViaPointer(copy, copy->child));
+    NV_TEST_CHECK(nv_index_clone(&clone, &index, copy));
+    NV_TEST_CHECK(nv_test_index_same(&clone, copy));
+
+    nv_index_free(&clone);
+    nv_index_free(&index);
+    cJSON_Delete(copy);
+    cJSON_Delete(json);
+    return true;
+}
+
+static bool nv_test_version_reclaim(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    char key[NV_TEST_KEY_SIZE];
+    uint32_t value = 0;
+    nv_config_t config;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+
+    nv_config_init(&config);
+    config.thread_safe = true;
+    config.shared = false;
+    config.durability = NV_DURABILITY_NONE;
+
+    nv_store_t* store = nv_open_config(file, &config);
+    NV_TEST_CHECK(store);
+    for (uint32_t i = 0; i < NV_TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%" PRIu32, i);
+        NV_TEST_CHECK(nv_store_sync(store, key, &i, sizeof(i), NV_DATA_U32));
+    }
+
+    /* the pinned version outlives the grace periods of many writes, the
+     * writes update in place, delete and add keys */
+    nv_snapshot_t* snapshot = nv_snapshot(store);
+    NV_TEST_CHECK(snapshot);
+
+    for (uint32_t i = 0; i < NV_TEST_KEYS * 4; i++) {
+        uint32_t n = i % NV_TEST_KEYS;
+
+        snprintf(key, sizeof(key), "key%" PRIu32, n);
+        value = i + NV_TEST_KEYS;
+        if (i % 5 == 4) {
+            NV_TEST_CHECK(nv_store_delete(store, key));
+            NV_TEST_CHECK(nv_store_get(store, key, (char*)&value,
+                                       sizeof(value), NV_DATA_U32)
+                          == false);
+            value = n;
+        }
+        NV_TEST_CHECK(nv_store_sync(store, key, &value, sizeof(value),
+                                    NV_DATA_U32));
+
+        uint32_t out = 0;
+        NV_TEST_CHECK(nv_store_get(store, key, (char*)&out, sizeof(out),
+                                   NV_DATA_U32));
+        NV_TEST_CHECK(out == value);
+    }
+
+    for (uint32_t i = 0; i < NV_TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%" PRIu32, i);
+        NV_TEST_CHECK(nv_snapshot_get(snapshot, key, (char*)&value,
+                                      sizeof(value), NV_DATA_U32));
+        NV_TEST_CHECK(value == i);
+    }
+    nv_snapshot_release(snapshot);
+
+    NV_TEST_CHECK(nv_close(store));
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+/* clang-format off */
+#define NV_TEST_WIDE_GROUP(X, n)                                             \
+    X(nv_test_wide_t, u8_##n,     "u8_" #n,     NV_DATA_U8)                  \
+    X(nv_test_wide_t, s16_##n,    "s16_" #n,    NV_DATA_S16)                 \
+    X(nv_test_wide_t, u32_##n,    "u32_" #n,    NV_DATA_U32)                 \
+    X(nv_test_wide_t, s64_##n,    "s64_" #n,    NV_DATA_S64)                 \
+    X(nv_test_wide_t, d_##n,      "d_" #n,      NV_DATA_DOUBLE)              \
+    X(nv_test_wide_t, str_##n,    "str_" #n,    NV_DATA_STR)                 \
+    X(nv_test_wide_t, ints_##n,   "ints_" #n,   NV_DATA_INT_ARRAY)           \
+    X(nv_test_wide_t, ip_##n,     "ip_" #n,     NV_DATA_IP)                  \
+    X(nv_test_wide_t, packed_##n, "packed_" #n, NV_DATA_PACKED_FLOAT_ARRAY)  \
+    X(nv_test_wide_t, blob_##n,   "blob_" #n,   NV_DATA_BLOB)
+
+#define NV_TEST_WIDE_MEMBERS(X, n)                                           \
+    uint8_t u8_##n;                                                          \
+    int16_t s16_##n;                                                         \
+    uint32_t u32_##n;                                                        \
+    int64_t s64_##n;                                                         \
+    double d_##n;                                                            \
+    char str_##n[16];                                                        \
+    int32_t ints_##n[4];                                                     \
+    uint32_t ip_##n[4];                                                      \
+    float packed_##n[3];                                                     \
+    uint8_t blob_##n[8];
+
+#define NV_TEST_WIDE_GROUPS(G, X)                                            \
+    G(X, 0)  G(X, 1)  G(X, 2)  G(X, 3)  G(X, 4)                              \
+    G(X, 5)  G(X, 6)  G(X, 7)  G(X, 8)  G(X, 9)                              \
+    G(X, 10) G(X, 11) G(X, 12) G(X, 13) G(X, 14)
+
+#define NV_TEST_WIDE_FIELDS(X) NV_TEST_WIDE_GROUPS(NV_TEST_WIDE_GROUP, X)
+/* clang-format on */
+
+typedef struct {
+    NV_TEST_WIDE_GROUPS(NV_TEST_WIDE_MEMBERS, _)
+} nv_test_wide_t;
+
+NV_SCHEMA(nv_test_wide_schema, NV_TEST_WIDE_FIELDS);
+
+/**
+ * nv_test_wide_fill, deterministic values every type keeps exactly
+ */
+static void nv_test_wide_fill(nv_test_wide_t* wide, int mark)
+{
+    memset(wide, 0, sizeof(nv_test_wide_t));
+
+    for (size_t i = 0; i < nv_test_wide_schema.count; i++) {
+        const nv_field_t* field = &nv_test_wide_schema.fields[i];
+        char* value = (char*)wide + field->offset;
+        int seed = mark + (int)i;
+
+        switch (field->type) {
+        case NV_DATA_U8:
+            *(uint8_t*)value = (uint8_t)seed;
+            break;
+        case NV_DATA_S16:
+            *(int16_t*)value = (int16_t)-seed;
+            break;
+        case NV_DATA_U32:
+            *(uint32_t*)value = (uint32_t)seed * 1000u;
+            break;
+        case NV_DATA_S64:
+            *(int64_t*)value = -(int64_t)seed * 1000000;
+            break;
+        case NV_DATA_DOUBLE:
+            *(double*)value = seed * 0.25;
+            break;
+        case NV_DATA_STR:
+            snprintf(value, field->len, "str%d", seed);
+            break;
+        case NV_DATA_INT_ARRAY:
+        case NV_DATA_IP:
+            for (uint32_t j = 0; j < field->len; j++) {
+                ((int32_t*)value)[j] = (seed + (int)j) & 0xff;
+            }
+            break;
+        case NV_DATA_PACKED_FLOAT_ARRAY:
+            for (uint32_t j = 0; j < field->len; j++) {
+                ((float*)value)[j] = (float)(seed + (int)j) * 0.5f;
+            }
+            break;
+        default:
+            for (uint32_t j = 0; j < field->len; j++) {
+                value[j] = (char)(seed * 7 + (int)j);
+            }
+            break;
+        }
+    }
+}
+
+static bool nv_test_schema_wide(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    char text[PATH_MAX];
+    static char data[NV_TEST_BUF_SIZE];
+    static nv_test_wide_t expected;
+    static nv_test_wide_t actual;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+    snprintf(text, sizeof(text), "%s/text.json", dir);
+    NV_TEST_CHECK(nv_test_wide_schema.count == 150);
+
+    /* members in schema order are each decoded at the cursor */
+    nv_test_wide_fill(&expected, 1);
+    NV_TEST_CHECK(nv_store_struct(file, &nv_test_wide_schema, &expected));
+    memset(&actual, 0, sizeof(actual));
+    NV_TEST_CHECK(nv_load_struct(file, &nv_test_wide_schema, &actual));
+    NV_TEST_CHECK(memcmp(&actual, &expected, sizeof(expected)) == 0);
+
+    /* members in reverse order among other keys, the first of a key wins
+     * whatever its case */
+    NV_TEST_CHECK(nv_convert(file, text, NV_FORMAT_JSON));
+    size_t size = nv_test_file_read(text, data, sizeof(data) - 1);
+    NV_TEST_CHECK(size);
+    data[size] = '\0';
+    cJSON* json = cJSON_Parse(data);
+    NV_TEST_CHECK(json);
+
+    cJSON* reversed = cJSON_CreateObject();
+    NV_TEST_CHECK(reversed);
+    cJSON_AddNumberToObject(reversed, "other", 1);
+    while (json->child) {
+        cJSON* item = json->child;
+        while (item->next) {
+            item = item->next;
+        }
+        cJSON_AddItemToObject(reversed, item->string,
+                              cJSON_DetachItemViaPointer(json, item));
+        cJSON_AddStringToObject(reversed, "other", "x");
+    }
+    cJSON_AddNumberToObject(reversed, "U8_0", 0);
+    cJSON_Delete(json);
+
+    char* printed = cJSON_PrintUnformatted(reversed);
+    cJSON_Delete(reversed);
+    NV_TEST_CHECK(printed);
+    NV_TEST_CHECK(nv_test_file_write(file, printed, strlen(printed)));
+    cJSON_free(printed);
+
+    memset(&actual, 0, sizeof(actual));
+    NV_TEST_CHECK(nv_load_struct(file, &nv_test_wide_schema, &actual));
+    NV_TEST_CHECK(memcmp(&actual, &expected, sizeof(expected)) == 0);
+
+    /* a missing member keeps its value and fails the load */
+    char key[] = "d_7";
+    NV_TEST_CHECK(nv_delete(file, key));
+    nv_test_wide_fill(&actual, 2);
+    NV_TEST_CHECK(nv_load_struct(file, &nv_test_wide_schema, &actual)
+                  == false);
+    NV_TEST_CHECK(actual.d_7 == expected.d_7 + 0.25);
+    actual.d_7 = expected.d_7;
+    NV_TEST_CHECK(memcmp(&actual, &expected, sizeof(expected)) == 0);
+
+    char blob_file[PATH_MAX];
+    snprintf(blob_file, sizeof(blob_file), "%s%s", file, NV_BLOB_SUFFIX);
+    unlink(blob_file);
+    unlink(text);
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+/**
+ * nv_test_scan_blob_visit, read a visited blob and check its bytes
+ * @param key  nv key, "blob<i>"
+ * @param item visited value
+ * @param arg  visited key count
+ * @return     boolean, false on a mismatch
+ */
+static bool nv_test_scan_blob_visit(const char* key, const nv_item_t* item,
+                                    void* arg)
+{
+    char expected[NV_TEST_STR_SIZE];
+    char value[NV_TEST_STR_SIZE];
+    uint32_t i = (uint32_t)strtoul(key + strlen("blob"), NULL, 10);
+
+    memset(expected, 'a' + (int)(i % 26), sizeof(expected));
+    memset(value, 0, sizeof(value));
+    if (nv_item_get(item, value, sizeof(value), NV_DATA_BLOB) == false
+        || memcmp(value, expected, sizeof(value)) != 0) {
+        return false;
+    }
+
+    (*(uint32_t*)arg)++;
+    return true;
+}
+
+static bool nv_test_scan_blob(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    char blob_file[PATH_MAX];
+    char value[NV_TEST_STR_SIZE];
+    nv_config_t config;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+    snprintf(blob_file, sizeof(blob_file), "%s%s", file, NV_BLOB_SUFFIX);
+
+    /* blobs live in the sidecar of the store file, a visit finds them there
+     * in both the plain and the thread safe layout */
+    for (int thread_safe = 0; thread_safe < 2; thread_safe++) {
+        nv_config_init(&config);
+        config.thread_safe = thread_safe;
+        config.shared = false;
+
+        nv_store_t* store = nv_open_config(file, &config);
+        NV_TEST_CHECK(store);
+
+        for (uint32_t i = 0; i < NV_TEST_ITEMS; i++) {
+            char key[NV_TEST_KEY_SIZE];
+
+            snprintf(key, sizeof(key), "blob%" PRIu32, i);
+            memset(value, 'a' + (int)(i % 26), sizeof(value));
+            NV_TEST_CHECK(nv_store_sync(store, key, value, sizeof(value),
+                                        NV_DATA_BLOB));
+        }
+
+        uint32_t count = 0;
+        NV_TEST_CHECK(nv_foreach(store, NULL, nv_test_scan_blob_visit,
+                                 &count));
+        NV_TEST_CHECK(count == NV_TEST_ITEMS);
+
+        count = 0;
+        NV_TEST_CHECK(nv_scan_prefix(store, "blob", NULL,
+                                     nv_test_scan_blob_visit, &count));
+        NV_TEST_CHECK(count == NV_TEST_ITEMS);
+
+        NV_TEST_CHECK(nv_close(store));
+        unlink(blob_file);
+        unlink(file);
+    }
+
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+static bool nv_test_range_layout(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    int32_t ints[NV_TEST_ITEMS];
+    char strings[NV_TEST_ITEMS][NV_TEST_KEY_SIZE];
+    char* names[NV_TEST_ITEMS];
+    uint32_t length = 0;
+    nv_config_t config;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+
+    nv_config_init(&config);
+    config.thread_safe = false;
+    config.shared = false;
+
+    nv_store_t* store = nv_open_config(file, &config);
+    NV_TEST_CHECK(store);
+
+    for (uint32_t i = 0; i < NV_TEST_ITEMS; i++) {
+        ints[i] = (int32_t)i;
+        snprintf(strings[i], sizeof(strings[i]), "name%" PRIu32, i);
+        names[i] = strings[i];
+    }
+
+    /* a packed array is one encoded string, ranged access is refused */
+    NV_TEST_CHECK(nv_store_sync(store, "packed", ints, NV_TEST_ITEMS,
+                                NV_DATA_PACKED_INT_ARRAY));
+    errno = 0;
+    NV_TEST_CHECK(nv_store_append(store, "packed", ints, 1,
+                                  NV_DATA_INT_ARRAY, &length)
+                  == false);
+    NV_TEST_CHECK(errno == ENOTSUP);
+    errno = 0;
+    NV_TEST_CHECK(nv_store_get_range(store, "packed", 0, ints, 1,
+                                     NV_DATA_INT_ARRAY, &length)
+                  == false);
+    NV_TEST_CHECK(errno == ENOTSUP);
+    errno = 0;
+    NV_TEST_CHECK(nv_store_set_range(store, "plain", 0, ints, NV_TEST_ITEMS,
+                                     NV_DATA_PACKED_INT_ARRAY, &length)
+                  == false);
+    NV_TEST_CHECK(errno == ENOTSUP);
+
+    /* elements of another type leave the array as it was */
+    NV_TEST_CHECK(nv_store_sync(store, "names", names, NV_TEST_ITEMS,
+                                NV_DATA_STRING_ARRAY));
+    errno = 0;
+    NV_TEST_CHECK(nv_store_append(store, "names", ints, 1, NV_DATA_INT_ARRAY,
+                                  &length)
+                  == false);
+    NV_TEST_CHECK(errno == EINVAL);
+    NV_TEST_CHECK(nv_store_append(store, "names", names, 1,
+                                  NV_DATA_STRING_ARRAY, &length));
+    NV_TEST_CHECK(length == NV_TEST_ITEMS + 1);
+
+    NV_TEST_CHECK(nv_store_set_range(store, "ints", 0, ints, NV_TEST_ITEMS,
+                                     NV_DATA_INT_ARRAY, &length));
+    errno = 0;
+    NV_TEST_CHECK(nv_store_set_range(store, "ints", 1, names, 1,
+                                     NV_DATA_STRING_ARRAY, &length)
+                  == false);
+    NV_TEST_CHECK(errno == EINVAL);
+    NV_TEST_CHECK(nv_store_get_range(store, "ints", 0, ints, NV_TEST_ITEMS,
+                                     NV_DATA_INT_ARRAY, &length));
+    NV_TEST_CHECK(length == NV_TEST_ITEMS && ints[1] == 1);
+
+    NV_TEST_CHECK(nv_close(store));
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+static bool nv_test_txn_retry(void)
+{
+    char dir[] = "/tmp/nv_test.XXXXXX";
+    char file[PATH_MAX];
+    uint32_t value = 0;
+
+    NV_TEST_CHECK(mkdtemp(dir));
+    snprintf(file, sizeof(file), "%s/nv.json", dir);
+
+    nv_txn_t* txn = nv_txn_begin(file);
+    NV_TEST_CHECK(txn);
+    for (uint32_t i = 0; i < NV_TEST_KEYS; i++) {
+        char key[NV_TEST_KEY_SIZE];
+
+        snprintf(key, sizeof(key), "key%" PRIu32, i);
+        NV_TEST_CHECK(nv_txn_sync(txn, key, &i, sizeof(i), NV_DATA_U32));
+    }
+
+    /* the file can not be written while its dir is gone, the batch stays
+     * in the transaction until the commit is retried */
+    nv_test_dir_remove(dir);
+    NV_TEST_CHECK(nv_txn_commit(txn) == false);
+    NV_TEST_CHECK(mkdir(dir, 0700) == 0);
+    NV_TEST_CHECK(nv_txn_commit(txn));
+
+    for (uint32_t i = 0; i < NV_TEST_KEYS; i++) {
+        char key[NV_TEST_KEY_SIZE];
+
+        snprintf(key, sizeof(key), "key%" PRIu32, i);
+        NV_TEST_CHECK(nv_get(file, key, (char*)&value, sizeof(value),
+                             NV_DATA_U32));
+        NV_TEST_CHECK(value == i);
+    }
+
+    nv_test_dir_remove(dir);
+    return true;
+}
+
+int main(void)
+{
+    static const struct {
+        const char* name;
+        nv_test_fn_t fn;
+    } tests[] = {
+        { "lz_round_trip", nv_test_lz_round_trip },
+        { "lz_corrupt", nv_test_lz_corrupt },
+        { "base64_round_trip", nv_test_base64_round_trip },
+        { "base64_corrupt", nv_test_base64_corrupt },
+        { "wal_replay", nv_test_wal_replay },
+        { "scan_differential", nv_test_scan_differential },
+        { "scan_types", nv_test_scan_types },
+        { "scan_fallback", nv_test_scan_fallback },
+        { "flusher_merge", nv_test_flusher_merge },
+        { "snapshot_pin", nv_test_snapshot_pin },
+        { "registry_flush", nv_test_registry_flush },
+        { "watch_reload", nv_test_watch_reload },
+        { "arena_nested", nv_test_arena_nested },
+        { "schema_wide", nv_test_schema_wide },
+        { "index_clone", nv_test_index_clone },
+        { "version_reclaim", nv_test_version_reclaim },
+        { "scan_blob", nv_test_scan_blob },
+        { "range_layout", nv_test_range_layout },
+        { "txn_retry", nv_test_txn_retry },
+    };
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        bool ret = tests[i].fn();
+        printf("%s %s\n", ret ? "pass" : "FAIL", tests[i].name);
+        if (ret == false) {
+            failed++;
+        }
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}